@@ -0,0 +1,118 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Chunks are always aligned to at least this so the first allocation in a chunk never needs padding.
+#define ARENA_CHUNK_ALIGNMENT 64
+
+static arena_chunk_t* create_chunk(size_t capacity) {
+    // aligned_alloc requires the size to be a multiple of the alignment.
+    capacity = (capacity + ARENA_CHUNK_ALIGNMENT - 1) & ~(size_t)(ARENA_CHUNK_ALIGNMENT - 1);
+
+    arena_chunk_t* chunk = malloc(sizeof(arena_chunk_t));
+    chunk->data = aligned_alloc(ARENA_CHUNK_ALIGNMENT, capacity);
+    if(chunk->data == NULL) {
+        printf("Failed to allocate a %zu byte arena chunk.\n", capacity);
+        exit(-1);
+    }
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    chunk->next = NULL;
+    return chunk;
+}
+
+static int is_power_of_two(size_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+void init_arena(arena_t* arena, size_t chunk_size, size_t alignment) {
+    if(!is_power_of_two(alignment)) {
+        printf("Arena alignment must be a power of two, got %zu.\n", alignment);
+        exit(-1);
+    }
+
+    arena->chunk_size = chunk_size;
+    arena->alignment = alignment;
+    arena->first_chunk = create_chunk(chunk_size);
+    arena->current_chunk = arena->first_chunk;
+
+    arena->bytes_used = 0;
+    arena->bytes_reserved = arena->first_chunk->capacity;
+    arena->high_water_mark = 0;
+    arena->num_allocations = 0;
+    arena->num_chunks = 1;
+}
+
+void free_arena(arena_t* arena) {
+    arena_chunk_t* chunk = arena->first_chunk;
+    while(chunk != NULL) {
+        arena_chunk_t* next = chunk->next;
+        free(chunk->data);
+        free(chunk);
+        chunk = next;
+    }
+    arena->first_chunk = NULL;
+    arena->current_chunk = NULL;
+    arena->bytes_used = 0;
+    arena->bytes_reserved = 0;
+    arena->num_chunks = 0;
+}
+
+void reset_arena(arena_t* arena) {
+    for(arena_chunk_t* chunk = arena->first_chunk; chunk != NULL; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+    arena->current_chunk = arena->first_chunk;
+    arena->bytes_used = 0;
+    arena->num_allocations = 0;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    return arena_alloc_aligned(arena, size, arena->alignment);
+}
+
+void* arena_alloc_aligned(arena_t* arena, size_t size, size_t alignment) {
+    if(!is_power_of_two(alignment)) {
+        printf("Arena alignment must be a power of two, got %zu.\n", alignment);
+        exit(-1);
+    }
+
+    /**
+     * Look for room in the current chunk, and then any chunks after it that were kept from before the last
+     * reset. Only once those are all full do we reserve a new chunk.
+     */
+    arena_chunk_t* chunk = arena->current_chunk;
+    while(1) {
+        uintptr_t start = (uintptr_t)chunk->data + chunk->used;
+        size_t padding = (alignment - (start & (alignment - 1))) & (alignment - 1);
+        if(chunk->used + padding + size <= chunk->capacity) {
+            chunk->used += padding + size;
+            arena->current_chunk = chunk;
+
+            arena->bytes_used += padding + size;
+            arena->num_allocations++;
+            if(arena->bytes_used > arena->high_water_mark) {
+                arena->high_water_mark = arena->bytes_used;
+            }
+            return (void*)(start + padding);
+        }
+
+        if(chunk->next == NULL) {
+            size_t capacity = size + alignment > arena->chunk_size ? size + alignment : arena->chunk_size;
+            chunk->next = create_chunk(capacity);
+            arena->bytes_reserved += chunk->next->capacity;
+            arena->num_chunks++;
+        }
+        chunk = chunk->next;
+    }
+}
+
+void print_arena_stats(arena_t* arena, const char* name) {
+    printf(
+            "%s arena: %zu bytes used in %zu allocations, %zu bytes high water mark, %zu bytes reserved in %d chunks.\n",
+            name, arena->bytes_used, arena->num_allocations, arena->high_water_mark,
+            arena->bytes_reserved, arena->num_chunks
+    );
+}
@@ -0,0 +1,47 @@
+#ifndef INC_3D_ARENA_H
+#define INC_3D_ARENA_H
+
+#include <stddef.h>
+
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    size_t capacity;
+    size_t used;
+    unsigned char* data;
+} arena_chunk_t;
+
+/**
+ * Hands out memory by bumping an offset through large chunks, so lots of small allocations cost a pointer bump
+ * rather than a malloc each. When a chunk fills up a new one is chained on rather than moving anything, so
+ * pointers stay valid until the arena is reset. Resetting rewinds every chunk without giving the memory back,
+ * which lets per-frame or per-scene data reuse the same chunks over and over.
+ */
+typedef struct {
+    arena_chunk_t* first_chunk;
+    arena_chunk_t* current_chunk;
+
+    size_t chunk_size;
+    size_t alignment;
+
+    // Statistics, bytes_used includes any padding added for alignment.
+    size_t bytes_used;
+    size_t bytes_reserved;
+    size_t high_water_mark;
+    size_t num_allocations;
+    int num_chunks;
+} arena_t;
+
+/**
+ * chunk_size is how much memory to reserve each time the arena grows, allocations larger than that get a chunk
+ * of their own. alignment is the default for arena_alloc() and must be a power of two.
+ */
+void init_arena(arena_t* arena, size_t chunk_size, size_t alignment);
+void free_arena(arena_t* arena);
+void reset_arena(arena_t* arena);
+
+void* arena_alloc(arena_t* arena, size_t size);
+void* arena_alloc_aligned(arena_t* arena, size_t size, size_t alignment);
+
+void print_arena_stats(arena_t* arena, const char* name);
+
+#endif //INC_3D_ARENA_H
@@ -0,0 +1,228 @@
+#include "asset_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../gltf/gltf.h"
+#include "../lod/lod.h"
+#include "../mesh_optimizer/mesh_optimizer.h"
+#include "../profiler/profiler.h"
+#include "../stb/stb_image.h"
+#include "../texture/texture.h"
+
+static double get_time_ms() {
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (double)tp.tv_sec * 1000.0 + (double)tp.tv_nsec / 1000000.0;
+}
+
+// Decode an image into an RGBA8 mip chain, which needs to be freed by the caller.
+static byte* decode_texture_image(
+        byte* texture_image_data, size_t texture_image_size, int* width_out, int* height_out
+) {
+    // TODO: Use our own memory instead of STBI stuff.
+    int image_width, image_height, num_channels;
+    byte* image_data = stbi_load_from_memory(
+            texture_image_data, texture_image_size, &image_width, &image_height, &num_channels, STBI_rgb_alpha
+    );
+    if(image_data == NULL) {
+        const char* error = stbi_failure_reason();
+        printf("Failed to load image: %s\n", error);
+        exit(-1);
+    }
+    printf("Loaded %dx%d image with %d num_channels.\n", image_width, image_height, num_channels);
+
+    // Objects far enough away to cover fewer pixels than the texture has would alias without smaller levels.
+    byte* mip_chain = generate_mip_chain(image_data, image_width, image_height);
+    stbi_image_free(image_data);
+
+    *width_out = image_width;
+    *height_out = image_height;
+    return mip_chain;
+}
+
+// A cooked asset already has everything decoded, so the mesh and mip chain are used straight from the mapping.
+static void use_cooked_asset(asset_load_t* load) {
+    cooked_asset_header_t* header = load->cooked_asset.header;
+    load->mesh.vertex_format = load->vertex_format;
+    load->mesh.vertex_stride = (int)header->vertex_stride;
+    load->mesh.vertices = load->cooked_asset.vertices;
+    load->mesh.index_type = (index_type_t)header->index_type;
+    load->mesh.indices = load->cooked_asset.indices;
+    load->mesh.num_vertices = (int)header->num_vertices;
+    load->mesh.num_indices = (int)header->num_indices;
+    memcpy(load->mesh.lods, header->lods, sizeof(load->mesh.lods));
+    load->mesh.num_lods = (int)header->num_lods;
+    compute_object_bounds(&load->mesh);
+    load->mip_chain = load->cooked_asset.mip_chain;
+    load->texture_width = (int)header->texture_width;
+    load->texture_height = (int)header->texture_height;
+    load->mesh_hash = header->mesh_hash;
+    load->texture_hash = header->texture_hash;
+    load->texture_image_size = header->texture_image_size;
+}
+
+// Runs on a worker thread, so it can't touch the render backend, the resource cache or the object.
+static void decode_asset_job(void* data) {
+    asset_load_t* load = data;
+    double start_time = get_time_ms();
+    if(open_cooked_asset(load->file_path, load->vertex_format, &load->cooked_asset)) {
+        use_cooked_asset(load);
+        printf("Loaded %s from its cooked asset in %.2fms.\n", load->file_path, get_time_ms() - start_time);
+        return;
+    }
+
+    gltf_t gltf;
+    open_gltf(load->file_path, &gltf);
+    load_gltf_meshes(&gltf, load->vertex_format, &load->arena, &load->mesh);
+    /**
+     * Exporters repeat vertices and leave triangles in whatever order they were modelled in, neither of which the GPU
+     * likes. Welding first also gives the simplifier fewer vertices to work through.
+     */
+    optimize_object_mesh(&load->mesh, &load->arena);
+    // Simplifying is the slowest part of loading a big mesh, so it's worth doing here and keeping in the cooked asset.
+    generate_object_lods(&load->mesh, &load->arena);
+
+    size_t texture_data_size;
+    byte* texture_data = get_gltf_texture_image(&gltf, &texture_data_size);
+    if(texture_data == NULL) {
+        printf("Model %s has no texture.\n", load->file_path);
+        exit(-1);
+    }
+
+    // The image is decoded even if an identical one is already loaded, as the cooked asset needs its pixels.
+    load->mip_chain = decode_texture_image(
+            texture_data, texture_data_size, &load->texture_width, &load->texture_height
+    );
+    load->mesh_hash = hash_mesh(&load->mesh);
+    load->texture_hash = hash_resource(texture_data, texture_data_size);
+    load->texture_image_size = texture_data_size;
+    char** source_uris = malloc((gltf.num_buffers + gltf.num_images) * sizeof(char*));
+    int num_source_uris = get_gltf_external_uris(&gltf, source_uris);
+    save_cooked_asset(
+            load->file_path, source_uris, num_source_uris, &load->mesh, load->mesh_hash, load->texture_hash,
+            texture_data_size, load->mip_chain, load->texture_width, load->texture_height
+    );
+    free(source_uris);
+
+    close_gltf(&gltf);
+    printf("Loaded %s in %.2fms.\n", load->file_path, get_time_ms() - start_time);
+}
+
+void init_asset_loader(
+        asset_loader_t* loader, int num_threads, resource_cache_t* resource_cache, render_backend_t* backend
+) {
+    loader->pool = create_thread_pool(num_threads);
+    loader->resource_cache = resource_cache;
+    loader->backend = backend;
+    loader->loads = NULL;
+    loader->num_loads = 0;
+}
+
+static void free_asset_load(asset_load_t* load) {
+    if(load->cooked_asset.file.data != NULL) {
+        close_cooked_asset(&load->cooked_asset);
+    } else {
+        free(load->mip_chain);
+    }
+    free_arena(&load->arena);
+    free(load->file_path);
+    free(load);
+}
+
+void free_asset_loader(asset_loader_t* loader) {
+    // Workers finish everything that's queued before they exit.
+    destroy_thread_pool(loader->pool);
+    for(int i = 0; i < loader->num_loads; i++) {
+        free_asset_load(loader->loads[i]);
+    }
+    free(loader->loads);
+    loader->loads = NULL;
+    loader->num_loads = 0;
+}
+
+// Swap an object's mesh and texture for new ones, releasing whatever it held before.
+static void replace_object_resources(resource_cache_t* cache, object_t* object, object_t* mesh, GLuint texture_id) {
+    release_object_resources(cache, object);
+    object->vertex_format = mesh->vertex_format;
+    object->vertex_stride = mesh->vertex_stride;
+    object->vertices = mesh->vertices;
+    object->index_type = mesh->index_type;
+    object->indices = mesh->indices;
+    object->num_vertices = mesh->num_vertices;
+    object->num_indices = mesh->num_indices;
+    memcpy(object->lods, mesh->lods, sizeof(object->lods));
+    object->num_lods = mesh->num_lods;
+    object->bounds = mesh->bounds;
+    object->texture_id = texture_id;
+}
+
+void load_object_async(
+        asset_loader_t* loader, const char* file_path, vertex_format_t vertex_format, object_t* object
+) {
+    object_t shared;
+    if(acquire_cached_file(loader->resource_cache, file_path, vertex_format, &shared)) {
+        replace_object_resources(loader->resource_cache, object, &shared, shared.texture_id);
+        return;
+    }
+
+    asset_load_t* load = calloc(1, sizeof(asset_load_t));
+    load->file_path = strdup(file_path);
+    load->vertex_format = vertex_format;
+    load->object = object;
+    // Meshes go in the same alignment as the mesh arena, only a small chunk is reserved as most come from one file.
+    init_arena(&load->arena, 1024 * 1024, 64);
+    init_job_group(&load->group);
+
+    loader->loads = realloc(loader->loads, (loader->num_loads + 1) * sizeof(asset_load_t*));
+    loader->loads[loader->num_loads++] = load;
+    submit_job(loader->pool, &load->group, decode_asset_job, load);
+}
+
+// Runs on the main thread once the load's job is done, which is the only place the backend and cache are touched.
+static void finish_asset_load(asset_loader_t* loader, asset_load_t* load) {
+    PROFILE_SCOPE("finish_asset_load");
+    resource_cache_t* cache = loader->resource_cache;
+
+    // Identical meshes and images are only kept and uploaded once, however many models use them.
+    share_cached_mesh(cache, &load->mesh, load->mesh_hash);
+    GLuint texture_id;
+    if(!acquire_cached_texture(cache, load->texture_hash, load->texture_image_size, &texture_id)) {
+        texture_id = loader->backend->create_texture(
+                loader->backend, load->mip_chain, load->texture_width, load->texture_height
+        );
+        add_cached_texture(cache, load->texture_hash, load->texture_image_size, texture_id);
+    }
+
+    replace_object_resources(cache, load->object, &load->mesh, texture_id);
+    add_cached_file(cache, load->file_path, load->object);
+}
+
+int finish_asset_loads(asset_loader_t* loader) {
+    int num_finished = 0;
+    for(int i = 0; i < loader->num_loads;) {
+        asset_load_t* load = loader->loads[i];
+        if(!is_job_group_finished(loader->pool, &load->group)) {
+            i++;
+            continue;
+        }
+        finish_asset_load(loader, load);
+        free_asset_load(load);
+
+        // Keep the rest in the order they were requested, so they finish in that order when several are done.
+        memmove(&loader->loads[i], &loader->loads[i + 1], (loader->num_loads - i - 1) * sizeof(asset_load_t*));
+        loader->num_loads--;
+        num_finished++;
+    }
+    return num_finished;
+}
+
+int wait_for_asset_loads(asset_loader_t* loader) {
+    PROFILE_SCOPE("wait_for_asset_loads");
+    for(int i = 0; i < loader->num_loads; i++) {
+        wait_for_job_group(loader->pool, &loader->loads[i]->group);
+    }
+    return finish_asset_loads(loader);
+}
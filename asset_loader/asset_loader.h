@@ -0,0 +1,88 @@
+#ifndef INC_3D_ASSET_LOADER_H
+#define INC_3D_ASSET_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../arena/arena.h"
+#include "../cooked_asset/cooked_asset.h"
+#include "../object/object.h"
+#include "../render/render.h"
+#include "../resource_cache/resource_cache.h"
+#include "../thread_pool/thread_pool.h"
+
+/**
+ * Loads models on worker threads so the main thread can keep drawing while they load. Everything that doesn't
+ * touch the render backend or the resource cache, reading files, parsing JSON, base64 and PNG decoding and
+ * expanding vertices, happens in a job per model, so separate models load in parallel. Once a job is done the main
+ * thread finishes the load by sharing the mesh and uploading the texture, which is the only part that has to happen
+ * where the OpenGL context is.
+ *
+ * Until its load finishes an object keeps whatever it had before, so objects can be drawn as placeholders while
+ * the real models stream in.
+ */
+typedef struct {
+    char* file_path;
+    vertex_format_t vertex_format;
+    // The object the model is loaded into, only the main thread touches it.
+    object_t* object;
+
+    /**
+     * Everything below is filled in by the job. The mesh is the decoded vertices and indices, either in the load's
+     * own arena or pointing into its cooked asset.
+     */
+    arena_t arena;
+    object_t mesh;
+    cooked_asset_t cooked_asset;
+    byte* mip_chain;
+    int texture_width;
+    int texture_height;
+    uint64_t mesh_hash;
+    uint64_t texture_hash;
+    size_t texture_image_size;
+
+    job_group_t group;
+} asset_load_t;
+
+typedef struct {
+    // A pool of its own, so waiting on other work, like the CPU rasterizer's, never ends up running a whole load.
+    thread_pool_t* pool;
+
+    resource_cache_t* resource_cache;
+    render_backend_t* backend;
+
+    // Loads that haven't been finished on the main thread yet.
+    asset_load_t** loads;
+    int num_loads;
+} asset_loader_t;
+
+/**
+ * Start a loader with the given number of worker threads, or one per CPU core if num_threads is 0. Textures are
+ * created with backend and shared through resource_cache.
+ */
+void init_asset_loader(
+        asset_loader_t* loader, int num_threads, resource_cache_t* resource_cache, render_backend_t* backend
+);
+
+// Wait for any loads still running and free the loader. Loads that haven't been finished are thrown away.
+void free_asset_loader(asset_loader_t* loader);
+
+/**
+ * Start loading a .gltf or .glb file, or its cooked asset if it has an up to date one, into an object. The object's
+ * mesh and texture are only replaced once the load is finished by finish_asset_loads(), its position and model
+ * matrix are left alone. A file that's already loaded and hasn't changed is shared straight away.
+ */
+void load_object_async(
+        asset_loader_t* loader, const char* file_path, vertex_format_t vertex_format, object_t* object
+);
+
+/**
+ * Finish every load whose job is done, on the main thread. Returns how many objects changed, if any did the scene
+ * needs setting again for backends to pick up their new meshes.
+ */
+int finish_asset_loads(asset_loader_t* loader);
+
+// Block until every load has been finished. Returns how many objects changed, the same as finish_asset_loads().
+int wait_for_asset_loads(asset_loader_t* loader);
+
+#endif //INC_3D_ASSET_LOADER_H
@@ -9,11 +9,39 @@
 #include "base64.h"
 
 #include <stdlib.h>
-#include <libc.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BASE64_HAS_X86 1
+#include <immintrin.h>
+#endif
 
 static const unsigned char base64_table[65] =
         "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+/*
+ * Reverse of base64_table, 0x80 marks characters that aren't part of the
+ * encoding and are skipped. '=' decodes to 0 and is handled as padding.
+ */
+static const unsigned char base64_dtable[256] = {
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x3e, 0x80, 0x80, 0x80, 0x3f,
+        0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x80, 0x80, 0x80, 0x00, 0x80, 0x80,
+        0x80, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+        0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+};
+
 /**
  * base64_encode - Base64 encode
  * @src: Data to be encoded
@@ -84,6 +112,265 @@ unsigned char * base64_encode(const unsigned char *src, size_t len,
 }
 
 
+/*
+ * Decode the input from in until it reaches padding or the end, skipping any
+ * characters not in the table. Blocks are only written out once all four
+ * characters have been seen so the vector loops can hand over at any block.
+ */
+static int base64_decode_scalar(const unsigned char *in,
+                                const unsigned char *end,
+                                unsigned char *out, unsigned char *pos,
+                                unsigned char *out_end, size_t *out_len)
+{
+    unsigned char block[4], tmp;
+    size_t count = 0, olen;
+    int pad = 0;
+
+    for (; in < end; in++) {
+        tmp = base64_dtable[*in];
+        if (tmp == 0x80)
+            continue;
+
+        if (*in == '=')
+            pad++;
+        block[count] = tmp;
+        count++;
+        if (count == 4) {
+            if (pad > 2)
+                return -1; /* Invalid padding */
+            olen = 3 - pad;
+            if ((size_t) (out_end - pos) < olen)
+                return -1; /* Output buffer too small */
+            pos[0] = (block[0] << 2) | (block[1] >> 4);
+            if (olen > 1)
+                pos[1] = (block[1] << 4) | (block[2] >> 2);
+            if (olen > 2)
+                pos[2] = (block[2] << 6) | block[3];
+            pos += olen;
+            count = 0;
+            if (pad)
+                break;
+        }
+    }
+
+    if (count || pos == out)
+        return -1; /* Incomplete block or nothing to decode */
+
+    *out_len = pos - out;
+    return 0;
+}
+
+#ifdef BASE64_HAS_X86
+/*
+ * Vector decoding based on the approach by Wojciech Mula and Daniel Lemire.
+ * Each character is classified by looking up its low and high nibbles, a
+ * character is valid if the two lookups share no bits. The high nibble (and
+ * whether the character is '/') then picks the offset that maps it to its
+ * 6 bit value, and multiply-adds pack four 6 bit values into three bytes.
+ *
+ * Anything that isn't in the alphabet, including '=' and line breaks, stops
+ * the loop and leaves the rest of the input to the scalar decoder.
+ */
+__attribute__((target("ssse3")))
+static void base64_decode_ssse3(const unsigned char **in_pos,
+                                const unsigned char *end,
+                                unsigned char **out_pos,
+                                unsigned char *out_end)
+{
+    const __m128i lut_lo = _mm_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i shuffle = _mm_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+    const __m128i slash = _mm_set1_epi8(0x2f);
+    const __m128i zero = _mm_setzero_si128();
+    const unsigned char *in = *in_pos;
+    unsigned char *pos = *out_pos;
+
+    /* Each step writes 16 bytes, of which 12 are output */
+    while (end - in >= 16 && out_end - pos >= 16) {
+        __m128i str = _mm_loadu_si128((const __m128i *) in);
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4),
+                                           nibble_mask);
+        __m128i lo_nibbles = _mm_and_si128(str, nibble_mask);
+        __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        __m128i valid = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero);
+        if (_mm_movemask_epi8(valid) != 0xffff)
+            break;
+
+        __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(
+                _mm_cmpeq_epi8(str, slash), hi_nibbles));
+        __m128i values = _mm_add_epi8(str, roll);
+        __m128i merged = _mm_maddubs_epi16(values,
+                                           _mm_set1_epi32(0x01400140));
+        __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i *) pos, _mm_shuffle_epi8(packed, shuffle));
+
+        in += 16;
+        pos += 12;
+    }
+
+    *in_pos = in;
+    *out_pos = pos;
+}
+
+/*
+ * Same as the SSSE3 version with 32 characters at a time. The byte shuffle
+ * can't cross 128 bit lanes so a dword permute gathers the 24 output bytes.
+ */
+__attribute__((target("avx2")))
+static void base64_decode_avx2(const unsigned char **in_pos,
+                               const unsigned char *end,
+                               unsigned char **out_pos,
+                               unsigned char *out_end)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lut_hi = _mm256_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i shuffle = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+    const __m256i slash = _mm256_set1_epi8(0x2f);
+    const unsigned char *in = *in_pos;
+    unsigned char *pos = *out_pos;
+
+    /* Each step writes 32 bytes, of which 24 are output */
+    while (end - in >= 32 && out_end - pos >= 32) {
+        __m256i str = _mm256_loadu_si256((const __m256i *) in);
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4),
+                                              nibble_mask);
+        __m256i lo_nibbles = _mm256_and_si256(str, nibble_mask);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm256_testz_si256(lo, hi))
+            break;
+
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(
+                _mm256_cmpeq_epi8(str, slash), hi_nibbles));
+        __m256i values = _mm256_add_epi8(str, roll);
+        __m256i merged = _mm256_maddubs_epi16(values,
+                                              _mm256_set1_epi32(0x01400140));
+        __m256i packed = _mm256_madd_epi16(merged,
+                                           _mm256_set1_epi32(0x00011000));
+        packed = _mm256_shuffle_epi8(packed, shuffle);
+        packed = _mm256_permutevar8x32_epi32(packed, permute);
+        _mm256_storeu_si256((__m256i *) pos, packed);
+
+        in += 32;
+        pos += 24;
+    }
+
+    *in_pos = in;
+    *out_pos = pos;
+}
+#endif
+
+int base64_kernel_supported(base64_kernel_t kernel)
+{
+    switch (kernel) {
+    case BASE64_KERNEL_SCALAR:
+        return 1;
+#ifdef BASE64_HAS_X86
+    case BASE64_KERNEL_SSSE3:
+        return __builtin_cpu_supports("ssse3");
+    case BASE64_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+base64_kernel_t base64_best_kernel(void)
+{
+    /* Cheap enough to check every call, and safe from any thread */
+    if (base64_kernel_supported(BASE64_KERNEL_AVX2))
+        return BASE64_KERNEL_AVX2;
+    if (base64_kernel_supported(BASE64_KERNEL_SSSE3))
+        return BASE64_KERNEL_SSSE3;
+    return BASE64_KERNEL_SCALAR;
+}
+
+const char * base64_kernel_name(base64_kernel_t kernel)
+{
+    switch (kernel) {
+    case BASE64_KERNEL_SCALAR: return "scalar";
+    case BASE64_KERNEL_SSSE3:  return "ssse3";
+    case BASE64_KERNEL_AVX2:   return "avx2";
+    default:                   return "unknown";
+    }
+}
+
+/**
+ * base64_decode_into_with_kernel - Base64 decode with a specific kernel
+ * @kernel: Which vector kernel to use before finishing with the scalar loop
+ * @src: Data to be decoded
+ * @len: Length of the data to be decoded
+ * @out: Buffer to decode into
+ * @out_size: Size of the output buffer
+ * @out_len: Pointer to output length variable
+ * Returns: 0 on success, -1 on failure or if the output doesn't fit
+ */
+int base64_decode_into_with_kernel(base64_kernel_t kernel,
+                                   const unsigned char *src, size_t len,
+                                   unsigned char *out, size_t out_size,
+                                   size_t *out_len)
+{
+    const unsigned char *in = src, *end = src + len;
+    unsigned char *pos = out, *out_end = out + out_size;
+
+    if (!base64_kernel_supported(kernel))
+        return -1;
+
+#ifdef BASE64_HAS_X86
+    /* AVX2 leaves up to 31 characters which SSSE3 can make a start on */
+    if (kernel == BASE64_KERNEL_AVX2)
+        base64_decode_avx2(&in, end, &pos, out_end);
+    if (kernel == BASE64_KERNEL_AVX2 || kernel == BASE64_KERNEL_SSSE3)
+        base64_decode_ssse3(&in, end, &pos, out_end);
+#endif
+
+    return base64_decode_scalar(in, end, out, pos, out_end, out_len);
+}
+
+/**
+ * base64_decode_into - Base64 decode into a caller provided buffer
+ * @src: Data to be decoded
+ * @len: Length of the data to be decoded
+ * @out: Buffer to decode into
+ * @out_size: Size of the output buffer
+ * @out_len: Pointer to output length variable
+ * Returns: 0 on success, -1 on failure or if the output doesn't fit
+ *
+ * Useful when the decoded size is known up front, such as from a glTF
+ * buffer's byteLength, as the input only needs to be read once.
+ */
+int base64_decode_into(const unsigned char *src, size_t len,
+                       unsigned char *out, size_t out_size, size_t *out_len)
+{
+    return base64_decode_into_with_kernel(base64_best_kernel(), src, len,
+                                          out, out_size, out_len);
+}
+
 /**
  * base64_decode - Base64 decode
  * @src: Data to be decoded
@@ -97,59 +384,23 @@ unsigned char * base64_encode(const unsigned char *src, size_t len,
 unsigned char * base64_decode(const unsigned char *src, size_t len,
                               size_t *out_len)
 {
-    unsigned char dtable[256], *out, *pos, block[4], tmp;
-    size_t i, count, olen;
-    int pad = 0;
-
-    memset(dtable, 0x80, 256);
-    for (i = 0; i < sizeof(base64_table) - 1; i++)
-        dtable[base64_table[i]] = (unsigned char) i;
-    dtable['='] = 0;
-
-    count = 0;
-    for (i = 0; i < len; i++) {
-        if (dtable[src[i]] != 0x80)
-            count++;
-    }
+    unsigned char *out;
+    size_t olen;
 
-    if (count == 0 || count % 4)
+    /*
+     * Every 4 input characters decode to at most 3 bytes, so rather than
+     * counting the valid characters first allocate for the worst case.
+     */
+    olen = len / 4 * 3;
+    if (olen == 0)
         return NULL;
-
-    olen = count / 4 * 3;
-    pos = out = malloc(olen);
+    out = malloc(olen);
     if (out == NULL)
         return NULL;
 
-    count = 0;
-    for (i = 0; i < len; i++) {
-        tmp = dtable[src[i]];
-        if (tmp == 0x80)
-            continue;
-
-        if (src[i] == '=')
-            pad++;
-        block[count] = tmp;
-        count++;
-        if (count == 4) {
-            *pos++ = (block[0] << 2) | (block[1] >> 4);
-            *pos++ = (block[1] << 4) | (block[2] >> 2);
-            *pos++ = (block[2] << 6) | block[3];
-            count = 0;
-            if (pad) {
-                if (pad == 1)
-                    pos--;
-                else if (pad == 2)
-                    pos -= 2;
-                else {
-                    /* Invalid padding */
-                    free(out);
-                    return NULL;
-                }
-                break;
-            }
-        }
+    if (base64_decode_into(src, len, out, olen, out_len) < 0) {
+        free(out);
+        return NULL;
     }
-
-    *out_len = pos - out;
     return out;
-}
\ No newline at end of file
+}
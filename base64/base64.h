@@ -15,5 +15,27 @@ unsigned char * base64_encode(const unsigned char *src, size_t len,
                               size_t *out_len);
 unsigned char * base64_decode(const unsigned char *src, size_t len,
                               size_t *out_len);
+int base64_decode_into(const unsigned char *src, size_t len,
+                       unsigned char *out, size_t out_size, size_t *out_len);
+
+/*
+ * The decoder works through as much of the input as it can 16 or 32
+ * characters at a time and finishes off with the scalar loop. The kernel is
+ * picked at runtime, but can be chosen explicitly to compare them.
+ */
+typedef enum {
+    BASE64_KERNEL_SCALAR,
+    BASE64_KERNEL_SSSE3,
+    BASE64_KERNEL_AVX2,
+    NUM_BASE64_KERNELS
+} base64_kernel_t;
+
+int base64_kernel_supported(base64_kernel_t kernel);
+base64_kernel_t base64_best_kernel(void);
+const char * base64_kernel_name(base64_kernel_t kernel);
+int base64_decode_into_with_kernel(base64_kernel_t kernel,
+                                   const unsigned char *src, size_t len,
+                                   unsigned char *out, size_t out_size,
+                                   size_t *out_len);
 
 #endif /* BASE64_H */
\ No newline at end of file
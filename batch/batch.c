@@ -0,0 +1,245 @@
+#include "batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../profiler/profiler.h"
+#include "../transform/transform.h"
+
+/**
+ * Order objects by texture so that every object sharing a texture ends up in the same run of the buffers.
+ * Insertion sort keeps objects with the same texture in the order they were given.
+ */
+static void sort_objects_by_texture(object_t** objects, int num_objects) {
+    for(int i = 1; i < num_objects; i++) {
+        object_t* object = objects[i];
+        int j = i - 1;
+        while(j >= 0 && objects[j]->texture_id > object->texture_id) {
+            objects[j + 1] = objects[j];
+            j--;
+        }
+        objects[j + 1] = object;
+    }
+}
+
+void build_batch(batch_t* batch, object_t** objects, int num_objects, int is_quantized) {
+    PROFILE_SCOPE("build_batch");
+    batch->num_objects = num_objects;
+    batch->objects = malloc(num_objects * sizeof(object_t*));
+    memcpy(batch->objects, objects, num_objects * sizeof(object_t*));
+    sort_objects_by_texture(batch->objects, num_objects);
+
+    batch->vertex_format = num_objects > 0 ? batch->objects[0]->vertex_format : VERTEX_FORMAT_POSITION_UV;
+    batch->vertex_stride = get_vertex_stride(batch->vertex_format);
+
+    int total_vertices = 0;
+    int total_indices = 0;
+    for(int i = 0; i < num_objects; i++) {
+        if(batch->objects[i]->vertex_format != batch->vertex_format) {
+            printf("Can't batch objects with different vertex formats.\n");
+            exit(-1);
+        }
+        total_vertices += batch->objects[i]->num_vertices;
+        total_indices += get_object_total_indices(batch->objects[i]) * 3;
+    }
+
+    int vertex_stride = batch->vertex_stride;
+    batch->is_quantized = is_quantized;
+    size_t vertex_size = is_quantized ? sizeof(quantized_vertex_t) : vertex_stride * sizeof(GLfloat);
+    byte* vertices = malloc(total_vertices * vertex_size);
+    batch->dequantize_matrices = is_quantized ? malloc(num_objects * sizeof(float[4][4])) : NULL;
+    // The indices are written through an object so they can be stored at whichever width the batch needs.
+    object_t batch_indices = {
+            .index_type  = get_index_type(total_vertices),
+            .num_indices = total_indices / 3,
+    };
+    batch->index_type = batch_indices.index_type;
+    size_t indices_size = get_object_indices_size(&batch_indices);
+    batch_indices.indices = malloc(indices_size);
+
+    batch->object_first_indices = malloc((num_objects + 1) * sizeof(GLsizei));
+
+    // There is at most one draw per object so this is always enough.
+    batch->draws = malloc(num_objects * sizeof(batch_draw_t));
+    batch->num_draws = 0;
+
+    int vertex_offset = 0;
+    int index_offset = 0;
+    batch_draw_t* draw = NULL;
+    for(int i = 0; i < num_objects; i++) {
+        object_t* object = batch->objects[i];
+
+        // Start a new draw whenever the texture changes or we run out of room for model matrices.
+        if(draw == NULL || draw->texture_id != object->texture_id || draw->num_objects == MAX_BATCH_OBJECTS) {
+            draw = &batch->draws[batch->num_draws++];
+            draw->texture_id   = object->texture_id;
+            draw->first_object = i;
+            draw->num_objects  = 0;
+            draw->first_index  = index_offset;
+            draw->num_indices  = 0;
+        }
+
+        batch->object_first_indices[i] = index_offset;
+        if(is_quantized) {
+            quantized_vertex_t* object_vertices = (quantized_vertex_t*)&vertices[vertex_offset * vertex_size];
+            quantize_object_vertices(object, object_vertices, batch->dequantize_matrices[i]);
+            for(int vertex_idx = 0; vertex_idx < object->num_vertices; vertex_idx++) {
+                object_vertices[vertex_idx].position[3] = (GLshort)draw->num_objects;
+            }
+        } else {
+            GLfloat* object_vertices = (GLfloat*)&vertices[vertex_offset * vertex_size];
+            memcpy(object_vertices, object->vertices, object->num_vertices * vertex_size);
+            for(int vertex_idx = 0; vertex_idx < object->num_vertices; vertex_idx++) {
+                object_vertices[vertex_idx * vertex_stride + vertex_stride - 1] = (GLfloat)draw->num_objects;
+            }
+        }
+
+        /**
+         * Object indices are relative to their own vertices so they need to be moved to where those now are. Every
+         * level of detail is uploaded, so switching between them is only a different range.
+         */
+        int num_object_indices = get_object_total_indices(object) * 3;
+        for(int index_idx = 0; index_idx < num_object_indices; index_idx++) {
+            set_object_index(
+                    &batch_indices, index_offset + index_idx, get_object_index(object, index_idx) + vertex_offset
+            );
+        }
+
+        draw->num_objects++;
+        draw->num_indices += num_object_indices;
+        vertex_offset += object->num_vertices;
+        index_offset += num_object_indices;
+    }
+    batch->object_first_indices[num_objects] = index_offset;
+
+    {
+        PROFILE_SCOPE("upload_batch_buffers");
+        glGenBuffers(1, &batch->vertex_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, batch->vertex_buffer);
+        glBufferData(GL_ARRAY_BUFFER, total_vertices * vertex_size, vertices, GL_STATIC_DRAW);
+
+        glGenBuffers(1, &batch->index_buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->index_buffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size, batch_indices.indices, GL_STATIC_DRAW);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    printf(
+            "Batched %d objects (%d vertices at %d bytes, %d triangles, %d bit indices) into %d draw calls.\n",
+            num_objects, total_vertices, (int)vertex_size, total_indices / 3,
+            (int)get_index_size(batch->index_type) * 8, batch->num_draws
+    );
+
+    free(vertices);
+    free(batch_indices.indices);
+}
+
+void free_batch(batch_t* batch) {
+    glDeleteBuffers(1, &batch->vertex_buffer);
+    glDeleteBuffers(1, &batch->index_buffer);
+
+    free(batch->objects);
+    free(batch->object_first_indices);
+    free(batch->draws);
+    free(batch->dequantize_matrices);
+    batch->objects = NULL;
+    batch->dequantize_matrices = NULL;
+    batch->object_first_indices = NULL;
+    batch->draws = NULL;
+    batch->num_objects = 0;
+    batch->num_draws = 0;
+}
+
+void draw_batch(
+        batch_t* batch, const byte* is_object_visible, const byte* object_lods, GLint position_attribute,
+        GLint texture_uv_attribute, GLint object_index_attribute, GLint model_matrices_uniform
+) {
+    glBindBuffer(GL_ARRAY_BUFFER, batch->vertex_buffer);
+    if(batch->is_quantized) {
+        // Positions are read as plain integers, the dequantize matrix scales them, and w defaults to 1.
+        GLsizei stride = sizeof(quantized_vertex_t);
+        glVertexAttribPointer(
+                position_attribute, 3, GL_SHORT, GL_FALSE, stride, (void*)offsetof(quantized_vertex_t, position)
+        );
+        glVertexAttribPointer(
+                texture_uv_attribute, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                (void*)offsetof(quantized_vertex_t, texture_uv)
+        );
+        glVertexAttribPointer(
+                object_index_attribute, 1, GL_SHORT, GL_FALSE, stride,
+                (void*)(offsetof(quantized_vertex_t, position) + 3 * sizeof(GLshort))
+        );
+    } else {
+        GLsizei stride = batch->vertex_stride * sizeof(GLfloat);
+        glVertexAttribPointer(
+                position_attribute, 4, GL_FLOAT, GL_FALSE, stride, (void*)(VERTEX_POSITION_OFFSET * sizeof(GLfloat))
+        );
+        glVertexAttribPointer(
+                texture_uv_attribute, 2, GL_FLOAT, GL_FALSE, stride,
+                (void*)(VERTEX_TEXTURE_UV_OFFSET * sizeof(GLfloat))
+        );
+        glVertexAttribPointer(
+                object_index_attribute, 1, GL_FLOAT, GL_FALSE, stride,
+                (void*)((batch->vertex_stride - 1) * sizeof(GLfloat))
+        );
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->index_buffer);
+    GLenum index_type = get_gl_index_type(batch->index_type);
+    size_t index_size = get_index_size(batch->index_type);
+
+    PROFILE_GPU_SCOPE("gpu_draw_batch");
+    float model_matrices[MAX_BATCH_OBJECTS][4][4];
+    GLsizei run_counts[MAX_BATCH_OBJECTS];
+    const void* run_offsets[MAX_BATCH_OBJECTS];
+    for(int draw_idx = 0; draw_idx < batch->num_draws; draw_idx++) {
+        batch_draw_t* draw = &batch->draws[draw_idx];
+
+        // Ranges that carry straight on from the one before are drawn as one, like neighbouring full detail objects.
+        int num_runs = 0;
+        GLsizei run_end = -1;
+        for(int i = draw->first_object; i < draw->first_object + draw->num_objects; i++) {
+            if(!is_object_visible[i]) {
+                continue;
+            }
+            object_lod_t lod = get_object_lod(batch->objects[i], object_lods[i]);
+            GLsizei first_index = batch->object_first_indices[i] + lod.first_index * 3;
+            GLsizei num_indices = lod.num_indices * 3;
+            if(first_index == run_end) {
+                run_counts[num_runs - 1] += num_indices;
+            } else {
+                run_counts[num_runs] = num_indices;
+                run_offsets[num_runs++] = (void*)(first_index * index_size);
+            }
+            run_end = first_index + num_indices;
+        }
+        if(num_runs == 0) {
+            continue;
+        }
+
+        {
+            PROFILE_SCOPE("upload_model_matrices");
+            for(int i = 0; i < draw->num_objects; i++) {
+                object_t* object = batch->objects[draw->first_object + i];
+                if(batch->is_quantized) {
+                    multiply_matrices(
+                            model_matrices[i], object->model_matrix, batch->dequantize_matrices[draw->first_object + i]
+                    );
+                } else {
+                    memcpy(model_matrices[i], object->model_matrix, sizeof(model_matrices[i]));
+                }
+            }
+            // The matrices are stored row major so OpenGL needs to transpose them.
+            glUniformMatrix4fv(model_matrices_uniform, draw->num_objects, GL_TRUE, &model_matrices[0][0][0]);
+        }
+
+        PROFILE_SCOPE("draw_elements");
+        glBindTexture(GL_TEXTURE_2D, draw->texture_id);
+        glMultiDrawElements(GL_TRIANGLES, run_counts, index_type, run_offsets, num_runs);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
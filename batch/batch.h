@@ -0,0 +1,87 @@
+#ifndef INC_3D_BATCH_H
+#define INC_3D_BATCH_H
+
+#include "../object/object.h"
+
+/**
+ * The most objects a single draw can cover. Each object in a draw has its model matrix in a uniform array, and
+ * 32 mat4s is as many as the smallest uniform limit OpenGL 2 allows for a vertex shader.
+ */
+#define MAX_BATCH_OBJECTS 32
+
+/**
+ * A run of objects that share a texture and can be drawn with a single call. The objects indices are contiguous
+ * in the index buffer so one draw call covers all of them, or whichever of them are in view.
+ */
+typedef struct {
+    GLuint texture_id;
+
+    // Offset into the batches object list, the object index attribute is relative to this.
+    int first_object;
+    int num_objects;
+
+    // Offset and length in the index buffer.
+    GLsizei first_index;
+    GLsizei num_indices;
+} batch_draw_t;
+
+/**
+ * Every objects vertex data packed into shared GPU buffers at load time. Objects keep moving through their model
+ * matrices so the buffers never need to be updated, and the number of draw calls only grows with the number of
+ * textures rather than the number of objects.
+ */
+typedef struct {
+    /**
+     * Interleaved vertices in the objects vertex format, or quantized_vertex_t when is_quantized is set. The last
+     * float of each vertex, which is padding in the object, or the fourth position component of quantized vertices,
+     * says which entry in the draws model matrix array the vertex should be transformed by.
+     */
+    GLuint vertex_buffer;
+    GLuint index_buffer;
+    // 16 bit if every batched vertex fits, whatever the objects themselves use.
+    index_type_t index_type;
+
+    vertex_format_t vertex_format;
+    int vertex_stride;
+
+    /**
+     * Quantized positions are relative to each objects bounds, so each object has a matrix that takes them back to
+     * model space, which is folded into its model matrix before uploading. There's no room for more uniforms, 32
+     * model matrices already fill the smallest limit.
+     */
+    int is_quantized;
+    float (*dequantize_matrices)[4][4];
+
+    object_t** objects;
+    int num_objects;
+    /**
+     * Where each objects indices start in the index buffer, with one more at the end for where the last one ends.
+     * Every level of detail's indices are included, after the full detail ones.
+     */
+    GLsizei* object_first_indices;
+
+    batch_draw_t* draws;
+    int num_draws;
+} batch_t;
+
+/**
+ * Upload the objects into a new set of shared buffers. All of the objects need to use the same vertex format. The
+ * batch holds on to the object pointers so that it can read their model matrices each frame. The objects are
+ * sorted by texture, batch->objects has them in the order they're drawn. With is_quantized set only positions and
+ * UVs are uploaded, as quantized_vertex_t, which takes less than half the memory.
+ */
+void build_batch(batch_t* batch, object_t** objects, int num_objects, int is_quantized);
+void free_batch(batch_t* batch);
+
+/**
+ * Draw every object in the batch that's visible, going by is_object_visible which is in the same order as
+ * batch->objects. Each draw only issues the runs of its objects that are visible, and draws with none visible are
+ * skipped entirely along with uploading their model matrices. Each visible object is drawn at the level of detail
+ * in object_lods, in the same order again.
+ */
+void draw_batch(
+        batch_t* batch, const byte* is_object_visible, const byte* object_lods, GLint position_attribute,
+        GLint texture_uv_attribute, GLint object_index_attribute, GLint model_matrices_uniform
+);
+
+#endif //INC_3D_BATCH_H
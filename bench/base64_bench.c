@@ -0,0 +1,183 @@
+/**
+ * Checks each base64 decoding kernel against the original decoder and measures how many MB of base64 text per
+ * second each one can decode. Embedded glTF buffers are one long line with no line breaks, so that's what's timed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "../base64/base64.h"
+
+#define NUM_BYTES (32 * 1024 * 1024)
+#define NUM_ITERATIONS 10
+#define MAX_CHECK_BYTES 300
+
+// The decoder as it originally was in base64.c, used as the source of truth.
+unsigned char* reference_base64_decode(const unsigned char* src, size_t len, size_t* out_len) {
+    static const unsigned char base64_table[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    unsigned char dtable[256], *out, *pos, block[4], tmp;
+    size_t i, count, olen;
+    int pad = 0;
+
+    memset(dtable, 0x80, 256);
+    for(i = 0; i < sizeof(base64_table) - 1; i++) {
+        dtable[base64_table[i]] = (unsigned char)i;
+    }
+    dtable['='] = 0;
+
+    count = 0;
+    for(i = 0; i < len; i++) {
+        if(dtable[src[i]] != 0x80) {
+            count++;
+        }
+    }
+
+    if(count == 0 || count % 4) {
+        return NULL;
+    }
+
+    olen = count / 4 * 3;
+    pos = out = malloc(olen);
+    if(out == NULL) {
+        return NULL;
+    }
+
+    count = 0;
+    for(i = 0; i < len; i++) {
+        tmp = dtable[src[i]];
+        if(tmp == 0x80) {
+            continue;
+        }
+
+        if(src[i] == '=') {
+            pad++;
+        }
+        block[count] = tmp;
+        count++;
+        if(count == 4) {
+            *pos++ = (block[0] << 2) | (block[1] >> 4);
+            *pos++ = (block[1] << 4) | (block[2] >> 2);
+            *pos++ = (block[2] << 6) | block[3];
+            count = 0;
+            if(pad) {
+                if(pad == 1) {
+                    pos--;
+                } else if(pad == 2) {
+                    pos -= 2;
+                } else {
+                    free(out);
+                    return NULL;
+                }
+                break;
+            }
+        }
+    }
+
+    *out_len = pos - out;
+    return out;
+}
+
+/**
+ * Decode every length up to MAX_CHECK_BYTES, with and without line breaks, into a buffer of exactly the right size
+ * and make sure it matches what went in and what the original decoder gives.
+ */
+int check_kernel(base64_kernel_t kernel) {
+    unsigned char bytes[MAX_CHECK_BYTES];
+    unsigned char decoded[MAX_CHECK_BYTES];
+    fill_bytes(bytes, MAX_CHECK_BYTES);
+
+    for(size_t num_bytes = 1; num_bytes <= MAX_CHECK_BYTES; num_bytes++) {
+        for(int has_line_breaks = 0; has_line_breaks < 2; has_line_breaks++) {
+            size_t text_length;
+            unsigned char* text = base64_encode(bytes, num_bytes, &text_length);
+            if(!has_line_breaks) {
+                text_length = remove_line_breaks(text, text_length);
+            }
+
+            size_t reference_length;
+            unsigned char* reference = reference_base64_decode(text, text_length, &reference_length);
+
+            size_t decoded_length = 0;
+            int result = base64_decode_into_with_kernel(kernel, text, text_length, decoded, num_bytes, &decoded_length);
+            int is_correct = result == 0 && decoded_length == num_bytes && reference_length == num_bytes &&
+                             memcmp(decoded, bytes, num_bytes) == 0 && memcmp(reference, bytes, num_bytes) == 0;
+
+            // Anything that doesn't fit in the buffer should be rejected rather than written past the end.
+            is_correct &= base64_decode_into_with_kernel(
+                    kernel, text, text_length, decoded, num_bytes - 1, &decoded_length
+            ) < 0;
+
+            free(text);
+            free(reference);
+            if(!is_correct) {
+                printf(
+                        "%s kernel mismatch decoding %zu bytes%s\n",
+                        base64_kernel_name(kernel), num_bytes, has_line_breaks ? " with line breaks" : ""
+                );
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int main() {
+    unsigned char* bytes = malloc(NUM_BYTES);
+    unsigned char* decoded = malloc(NUM_BYTES);
+    fill_bytes(bytes, NUM_BYTES);
+
+    size_t text_length;
+    unsigned char* text = base64_encode(bytes, NUM_BYTES, &text_length);
+    text_length = remove_line_breaks(text, text_length);
+    double text_mb = (double)text_length * NUM_ITERATIONS / (1024.0 * 1024.0);
+    int all_correct = 1;
+
+    printf("best kernel: %s\n", base64_kernel_name(base64_best_kernel()));
+
+    double start_time = get_current_time();
+    for(int i = 0; i < NUM_ITERATIONS; i++) {
+        size_t decoded_length;
+        free(reference_base64_decode(text, text_length, &decoded_length));
+    }
+    double reference_rate = text_mb / ((get_current_time() - start_time) / 1000.0);
+    printf("%-10s %8.1f MB/s\n", "reference", reference_rate);
+
+    for(int kernel = 0; kernel < NUM_BASE64_KERNELS; kernel++) {
+        if(!base64_kernel_supported(kernel)) {
+            printf("%-10s not supported\n", base64_kernel_name(kernel));
+            continue;
+        }
+        if(!check_kernel(kernel)) {
+            all_correct = 0;
+            continue;
+        }
+
+        size_t decoded_length = 0;
+        start_time = get_current_time();
+        for(int i = 0; i < NUM_ITERATIONS; i++) {
+            base64_decode_into_with_kernel(kernel, text, text_length, decoded, NUM_BYTES, &decoded_length);
+        }
+        double rate = text_mb / ((get_current_time() - start_time) / 1000.0);
+        if(decoded_length != NUM_BYTES || memcmp(decoded, bytes, NUM_BYTES) != 0) {
+            printf("%s kernel decoded the benchmark data incorrectly\n", base64_kernel_name(kernel));
+            all_correct = 0;
+            continue;
+        }
+        printf("%-10s %8.1f MB/s (%.2fx reference)\n", base64_kernel_name(kernel), rate, rate / reference_rate);
+    }
+
+    // The allocating version is what gets used for images, where the size isn't known up front.
+    start_time = get_current_time();
+    for(int i = 0; i < NUM_ITERATIONS; i++) {
+        size_t decoded_length;
+        free(base64_decode(text, text_length, &decoded_length));
+    }
+    double rate = text_mb / ((get_current_time() - start_time) / 1000.0);
+    printf("%-10s %8.1f MB/s (%.2fx reference)\n", "allocating", rate, rate / reference_rate);
+
+    free(text);
+    free(bytes);
+    free(decoded);
+    return all_correct ? 0 : 1;
+}
@@ -0,0 +1,721 @@
+/**
+ * The whole benchmark suite in one run: base64 decoding, loading glTF files and cooked assets, generating levels of
+ * detail, optimizing meshes for the vertex cache, decoding, mipmapping and compressing textures, transforming vertices
+ * and rendering a scene of spinning spheres with the CPU rasterizer.
+ * Everything is generated from fixed seeds into a temporary directory, so runs on the same machine can be compared
+ * across commits. Results are printed as a table and can also be written as JSON or CSV to keep track of them.
+ *
+ * Usage: bench [--frames N] [--json path] [--csv path] [--label name]
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb/stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../stb/stb_image_write.h"
+
+#include "bench_util.h"
+#include "../arena/arena.h"
+#include "../base64/base64.h"
+#include "../cooked_asset/cooked_asset.h"
+#include "../gltf/gltf.h"
+#include "../lod/lod.h"
+#include "../mapped_file/mapped_file.h"
+#include "../mesh_optimizer/mesh_optimizer.h"
+#include "../raster/raster.h"
+#include "../texture/texture.h"
+#include "../thread_pool/thread_pool.h"
+#include "../transform/transform.h"
+
+#define MAX_RESULTS 16
+
+#define BASE64_NUM_BYTES (16 * 1024 * 1024)
+#define BASE64_NUM_ITERATIONS 10
+
+// The generated model is a grid of this many quads along each side, 2 * 256 * 256 triangles.
+#define GLTF_GRID_SIZE 256
+#define GLTF_NUM_ITERATIONS 10
+
+#define TEXTURE_SIZE 1024
+#define TEXTURE_NUM_ITERATIONS 10
+
+#define TRANSFORM_NUM_VERTICES 1000000
+#define TRANSFORM_NUM_ITERATIONS 20
+
+#define RENDER_FRAME_SIZE 512
+#define RENDER_DEFAULT_NUM_FRAMES 120
+#define RENDER_NUM_OBJECTS 64
+#define RENDER_NUM_TEXTURES 4
+#define RENDER_TEXTURE_SIZE 256
+// Each sphere has this many rings of this many quads.
+#define RENDER_SPHERE_STACKS 16
+#define RENDER_SPHERE_SLICES 32
+
+typedef void (*bench_function_t)(void* data);
+
+typedef struct {
+    const char* name;
+    // What the throughput is measured in per second.
+    const char* unit;
+    int num_iterations;
+    double median_time;
+    double min_time;
+    double throughput;
+} bench_result_t;
+
+bench_result_t results[MAX_RESULTS];
+int num_results = 0;
+
+int compare_doubles(const void* a, const void* b) {
+    double difference = *(const double*)a - *(const double*)b;
+    return (difference > 0) - (difference < 0);
+}
+
+/**
+ * Time each call of the function separately after one call to warm up, so page faults and caches filling on the
+ * first call aren't counted. The median is what gets compared as it isn't thrown off by the odd slow iteration, and
+ * throughput is the amount of work each call does in the results unit divided by the median.
+ */
+void run_benchmark(
+        const char* name, bench_function_t function, void* data, int num_iterations, double work, const char* unit
+) {
+    double* times = malloc(num_iterations * sizeof(double));
+    function(data);
+    for(int i = 0; i < num_iterations; i++) {
+        double start_time = get_current_time();
+        function(data);
+        times[i] = get_current_time() - start_time;
+    }
+    qsort(times, num_iterations, sizeof(double), compare_doubles);
+
+    bench_result_t* result = &results[num_results++];
+    result->name = name;
+    result->unit = unit;
+    result->num_iterations = num_iterations;
+    result->median_time = times[num_iterations / 2];
+    result->min_time = times[0];
+    result->throughput = work / (result->median_time / 1000.0);
+    free(times);
+}
+
+// A smooth pattern with some noise on top, so it compresses about as well as a real texture.
+byte* generate_texture(int size, int seed) {
+    srand(seed);
+    byte* pixels = malloc(size * size * 4);
+    for(int y = 0; y < size; y++) {
+        for(int x = 0; x < size; x++) {
+            byte* pixel = &pixels[(y * size + x) * 4];
+            pixel[0] = (x * 255 / size + (rand() & 15)) & 0xff;
+            pixel[1] = (y * 255 / size + (rand() & 15)) & 0xff;
+            pixel[2] = ((x ^ y) + (rand() & 15)) & 0xff;
+            pixel[3] = 255;
+        }
+    }
+    return pixels;
+}
+
+void write_file(const char* path, const void* data, size_t size) {
+    FILE* file = fopen(path, "wb");
+    if(file == NULL || fwrite(data, 1, size, file) != size) {
+        printf("Failed to write %s.\n", path);
+        exit(-1);
+    }
+    fclose(file);
+}
+
+typedef struct {
+    byte* text;
+    size_t text_length;
+} base64_scenario_t;
+
+void decode_base64(void* data) {
+    base64_scenario_t* scenario = data;
+    size_t decoded_length;
+    free(base64_decode(scenario->text, scenario->text_length, &decoded_length));
+}
+
+void bench_base64() {
+    byte* bytes = malloc(BASE64_NUM_BYTES);
+    fill_bytes(bytes, BASE64_NUM_BYTES);
+
+    base64_scenario_t scenario;
+    scenario.text = base64_encode(bytes, BASE64_NUM_BYTES, &scenario.text_length);
+    scenario.text_length = remove_line_breaks(scenario.text, scenario.text_length);
+
+    double text_mb = scenario.text_length / (1024.0 * 1024.0);
+    run_benchmark("base64_decode", decode_base64, &scenario, BASE64_NUM_ITERATIONS, text_mb, "MB/s");
+
+    free(scenario.text);
+    free(bytes);
+}
+
+/**
+ * Write a flat grid mesh with a texture twice, once with everything in external files that get memory mapped, and
+ * once with everything embedded as base64 data URIs. The JSON is the same apart from the URIs.
+ */
+void write_gltf_files(const char* directory, char* external_path, char* embedded_path, size_t path_size) {
+    int num_vertices = (GLTF_GRID_SIZE + 1) * (GLTF_GRID_SIZE + 1);
+    int num_indices = GLTF_GRID_SIZE * GLTF_GRID_SIZE * 6;
+    size_t positions_size = num_vertices * 3 * sizeof(float);
+    size_t uvs_size = num_vertices * 2 * sizeof(float);
+    size_t indices_size = num_indices * sizeof(uint32_t);
+    size_t buffer_size = positions_size + uvs_size + indices_size;
+
+    byte* buffer = malloc(buffer_size);
+    float* positions = (float*)buffer;
+    float* uvs = (float*)(buffer + positions_size);
+    uint32_t* indices = (uint32_t*)(buffer + positions_size + uvs_size);
+    for(int y = 0; y <= GLTF_GRID_SIZE; y++) {
+        for(int x = 0; x <= GLTF_GRID_SIZE; x++) {
+            int vertex_idx = y * (GLTF_GRID_SIZE + 1) + x;
+            positions[vertex_idx * 3 + 0] = (float)x / GLTF_GRID_SIZE - 0.5f;
+            positions[vertex_idx * 3 + 1] = (float)y / GLTF_GRID_SIZE - 0.5f;
+            positions[vertex_idx * 3 + 2] = 0;
+            uvs[vertex_idx * 2 + 0] = (float)x / GLTF_GRID_SIZE;
+            uvs[vertex_idx * 2 + 1] = 1.0f - (float)y / GLTF_GRID_SIZE;
+        }
+    }
+    for(int y = 0; y < GLTF_GRID_SIZE; y++) {
+        for(int x = 0; x < GLTF_GRID_SIZE; x++) {
+            uint32_t bottom_left = y * (GLTF_GRID_SIZE + 1) + x;
+            uint32_t top_left = bottom_left + GLTF_GRID_SIZE + 1;
+            uint32_t* quad = &indices[(y * GLTF_GRID_SIZE + x) * 6];
+            quad[0] = bottom_left;
+            quad[1] = bottom_left + 1;
+            quad[2] = top_left;
+            quad[3] = top_left;
+            quad[4] = bottom_left + 1;
+            quad[5] = top_left + 1;
+        }
+    }
+
+    byte* texture = generate_texture(TEXTURE_SIZE, BENCH_SEED);
+    char texture_path[4096];
+    snprintf(texture_path, sizeof(texture_path), "%s/texture.png", directory);
+    if(!stbi_write_png(texture_path, TEXTURE_SIZE, TEXTURE_SIZE, 4, texture, TEXTURE_SIZE * 4)) {
+        printf("Failed to write %s.\n", texture_path);
+        exit(-1);
+    }
+    free(texture);
+
+    char buffer_path[4096];
+    snprintf(buffer_path, sizeof(buffer_path), "%s/mesh.bin", directory);
+    write_file(buffer_path, buffer, buffer_size);
+
+    // Build the data URIs for the embedded version.
+    mapped_file_t png_file;
+    if(!map_file(texture_path, &png_file)) {
+        printf("Failed to map %s.\n", texture_path);
+        exit(-1);
+    }
+    size_t buffer_text_length, png_text_length;
+    byte* buffer_text = base64_encode(buffer, buffer_size, &buffer_text_length);
+    byte* png_text = base64_encode(png_file.data, png_file.size, &png_text_length);
+    buffer_text_length = remove_line_breaks(buffer_text, buffer_text_length);
+    png_text_length = remove_line_breaks(png_text, png_text_length);
+    unmap_file(&png_file);
+
+    const char* json_format =
+            "{\"asset\": {\"version\": \"2.0\"},"
+            " \"buffers\": [{\"byteLength\": %zu, \"uri\": \"%s%.*s\"}],"
+            " \"bufferViews\": ["
+            "{\"buffer\": 0, \"byteOffset\": 0, \"byteLength\": %zu},"
+            " {\"buffer\": 0, \"byteOffset\": %zu, \"byteLength\": %zu},"
+            " {\"buffer\": 0, \"byteOffset\": %zu, \"byteLength\": %zu}],"
+            " \"accessors\": ["
+            "{\"bufferView\": 0, \"componentType\": 5126, \"count\": %d, \"type\": \"VEC3\"},"
+            " {\"bufferView\": 1, \"componentType\": 5126, \"count\": %d, \"type\": \"VEC2\"},"
+            " {\"bufferView\": 2, \"componentType\": 5125, \"count\": %d, \"type\": \"SCALAR\"}],"
+            " \"images\": [{\"uri\": \"%s%.*s\"}],"
+            " \"textures\": [{\"source\": 0}],"
+            " \"materials\": [{\"pbrMetallicRoughness\": {\"baseColorTexture\": {\"index\": 0}}}],"
+            " \"meshes\": [{\"primitives\": [{\"attributes\": {\"POSITION\": 0, \"TEXCOORD_0\": 1},"
+            " \"indices\": 2, \"material\": 0}]}]}";
+
+    for(int is_embedded = 0; is_embedded < 2; is_embedded++) {
+        const char* buffer_uri_prefix = is_embedded ? "data:application/octet-stream;base64," : "";
+        const char* buffer_uri = is_embedded ? (char*)buffer_text : "mesh.bin";
+        int buffer_uri_length = is_embedded ? (int)buffer_text_length : (int)strlen("mesh.bin");
+        const char* image_uri_prefix = is_embedded ? "data:image/png;base64," : "";
+        const char* image_uri = is_embedded ? (char*)png_text : "texture.png";
+        int image_uri_length = is_embedded ? (int)png_text_length : (int)strlen("texture.png");
+
+        char* json_path = is_embedded ? embedded_path : external_path;
+        snprintf(json_path, path_size, "%s/%s.gltf", directory, is_embedded ? "embedded" : "external");
+        FILE* file = fopen(json_path, "w");
+        if(file == NULL) {
+            printf("Failed to write %s.\n", json_path);
+            exit(-1);
+        }
+        fprintf(
+                file, json_format, buffer_size, buffer_uri_prefix, buffer_uri_length, buffer_uri,
+                positions_size, positions_size, uvs_size, positions_size + uvs_size, indices_size,
+                num_vertices, num_vertices, num_indices, image_uri_prefix, image_uri_length, image_uri
+        );
+        fclose(file);
+    }
+
+    free(buffer_text);
+    free(png_text);
+    free(buffer);
+}
+
+typedef struct {
+    char* path;
+    arena_t mesh_arena;
+
+    // A mesh loaded once to generate levels of detail for and optimize, which work in the scratch arena.
+    object_t mesh;
+    arena_t scratch_arena;
+} gltf_scenario_t;
+
+// The same steps as load_object_from_gltf() in main.c, apart from handing the texture to a render backend.
+void load_gltf(void* data) {
+    gltf_scenario_t* scenario = data;
+    gltf_t gltf;
+    object_t object;
+    open_gltf(scenario->path, &gltf);
+    load_gltf_meshes(&gltf, VERTEX_FORMAT_POSITION_UV, &scenario->mesh_arena, &object);
+
+    size_t image_size;
+    byte* image = get_gltf_texture_image(&gltf, &image_size);
+    int width, height, num_channels;
+    byte* pixels = stbi_load_from_memory(image, image_size, &width, &height, &num_channels, STBI_rgb_alpha);
+    if(pixels == NULL) {
+        printf("Failed to decode the texture in %s.\n", scenario->path);
+        exit(-1);
+    }
+    stbi_image_free(pixels);
+
+    close_gltf(&gltf);
+    reset_arena(&scenario->mesh_arena);
+}
+
+// Load a glTF file and save it as a cooked asset, the same as the first load in main.c does.
+void cook_gltf(gltf_scenario_t* scenario) {
+    gltf_t gltf;
+    object_t object;
+    open_gltf(scenario->path, &gltf);
+    load_gltf_meshes(&gltf, VERTEX_FORMAT_POSITION_UV, &scenario->mesh_arena, &object);
+    optimize_object_mesh(&object, &scenario->mesh_arena);
+    generate_object_lods(&object, &scenario->mesh_arena);
+
+    size_t image_size;
+    byte* image = get_gltf_texture_image(&gltf, &image_size);
+    int width, height, num_channels;
+    byte* pixels = stbi_load_from_memory(image, image_size, &width, &height, &num_channels, STBI_rgb_alpha);
+    if(pixels == NULL) {
+        printf("Failed to decode the texture in %s.\n", scenario->path);
+        exit(-1);
+    }
+    // The hashes are only used by the resource cache in main.c, so they can be left out here.
+    byte* mip_chain = generate_mip_chain(pixels, width, height);
+    char** source_uris = malloc((gltf.num_buffers + gltf.num_images) * sizeof(char*));
+    int num_source_uris = get_gltf_external_uris(&gltf, source_uris);
+    save_cooked_asset(
+            scenario->path, source_uris, num_source_uris, &object, 0, 0, image_size, mip_chain, width, height
+    );
+    free(source_uris);
+    free(mip_chain);
+    stbi_image_free(pixels);
+
+    close_gltf(&gltf);
+    reset_arena(&scenario->mesh_arena);
+}
+
+/**
+ * What loading a model costs in main.c once it has been cooked. The mesh is copied into the mesh arena and the mip
+ * chain is copied as a stand in for uploading it, so every page of the file gets read.
+ */
+void load_cooked(void* data) {
+    gltf_scenario_t* scenario = data;
+    cooked_asset_t cooked_asset;
+    if(!open_cooked_asset(scenario->path, VERTEX_FORMAT_POSITION_UV, &cooked_asset)) {
+        printf("Failed to open the cooked asset for %s.\n", scenario->path);
+        exit(-1);
+    }
+    cooked_asset_header_t* header = cooked_asset.header;
+    size_t vertices_size = (size_t)header->num_vertices * header->vertex_stride * sizeof(GLfloat);
+    size_t indices_size = get_cooked_indices_size(header);
+    memcpy(arena_alloc(&scenario->mesh_arena, vertices_size), cooked_asset.vertices, vertices_size);
+    memcpy(arena_alloc(&scenario->mesh_arena, indices_size), cooked_asset.indices, indices_size);
+    size_t mip_chain_size = cooked_asset.file.size - header->mip_chain_offset;
+    memcpy(arena_alloc(&scenario->mesh_arena, mip_chain_size), cooked_asset.mip_chain, mip_chain_size);
+
+    close_cooked_asset(&cooked_asset);
+    reset_arena(&scenario->mesh_arena);
+}
+
+// Simplify the same full detail mesh every time, the levels only need to last until the next call.
+void generate_lods(void* data) {
+    gltf_scenario_t* scenario = data;
+    object_t object = scenario->mesh;
+    generate_object_lods(&object, &scenario->scratch_arena);
+    reset_arena(&scenario->scratch_arena);
+}
+
+// Optimizing rewrites the vertices in place, so each call works on a fresh copy of the loaded mesh.
+void optimize_mesh(void* data) {
+    gltf_scenario_t* scenario = data;
+    object_t object = scenario->mesh;
+    size_t vertices_size = (size_t)object.num_vertices * object.vertex_stride * sizeof(GLfloat);
+    object.vertices = arena_alloc(&scenario->scratch_arena, vertices_size);
+    memcpy(object.vertices, scenario->mesh.vertices, vertices_size);
+    optimize_object_mesh(&object, &scenario->scratch_arena);
+    reset_arena(&scenario->scratch_arena);
+}
+
+void bench_gltf(const char* directory) {
+    char external_path[4096];
+    char embedded_path[4096];
+    write_gltf_files(directory, external_path, embedded_path, sizeof(external_path));
+
+    double num_triangles = GLTF_GRID_SIZE * GLTF_GRID_SIZE * 2 / 1000000.0;
+    gltf_scenario_t scenario;
+    init_arena(&scenario.mesh_arena, 16 * 1024 * 1024, 64);
+
+    scenario.path = external_path;
+    run_benchmark("load_gltf_external", load_gltf, &scenario, GLTF_NUM_ITERATIONS, num_triangles, "Mtriangles/s");
+    scenario.path = embedded_path;
+    run_benchmark("load_gltf_embedded", load_gltf, &scenario, GLTF_NUM_ITERATIONS, num_triangles, "Mtriangles/s");
+    cook_gltf(&scenario);
+    run_benchmark("load_cooked_asset", load_cooked, &scenario, GLTF_NUM_ITERATIONS, num_triangles, "Mtriangles/s");
+
+    gltf_t gltf;
+    open_gltf(scenario.path, &gltf);
+    load_gltf_meshes(&gltf, VERTEX_FORMAT_POSITION_UV, &scenario.mesh_arena, &scenario.mesh);
+    close_gltf(&gltf);
+    init_arena(&scenario.scratch_arena, 16 * 1024 * 1024, 64);
+    run_benchmark("generate_lods", generate_lods, &scenario, GLTF_NUM_ITERATIONS, num_triangles, "Mtriangles/s");
+    run_benchmark("optimize_mesh", optimize_mesh, &scenario, GLTF_NUM_ITERATIONS, num_triangles, "Mtriangles/s");
+
+    free_arena(&scenario.scratch_arena);
+    free_arena(&scenario.mesh_arena);
+}
+
+typedef struct {
+    mapped_file_t png_file;
+    byte* pixels;
+    byte* compressed;
+} texture_scenario_t;
+
+void decode_texture(void* data) {
+    texture_scenario_t* scenario = data;
+    int width, height, num_channels;
+    stbi_image_free(stbi_load_from_memory(
+            scenario->png_file.data, scenario->png_file.size, &width, &height, &num_channels, STBI_rgb_alpha
+    ));
+}
+
+void generate_mips(void* data) {
+    texture_scenario_t* scenario = data;
+    free(generate_mip_chain(scenario->pixels, TEXTURE_SIZE, TEXTURE_SIZE));
+}
+
+void compress_texture(void* data) {
+    texture_scenario_t* scenario = data;
+    compress_texture_bc1(scenario->pixels, TEXTURE_SIZE, TEXTURE_SIZE, scenario->compressed);
+}
+
+// Uses the texture written for the glTF benchmarks.
+void bench_textures(const char* directory) {
+    char texture_path[4096];
+    snprintf(texture_path, sizeof(texture_path), "%s/texture.png", directory);
+
+    texture_scenario_t scenario;
+    if(!map_file(texture_path, &scenario.png_file)) {
+        printf("Failed to map %s.\n", texture_path);
+        exit(-1);
+    }
+    scenario.pixels = generate_texture(TEXTURE_SIZE, BENCH_SEED);
+    scenario.compressed = malloc(get_bc1_size(TEXTURE_SIZE, TEXTURE_SIZE));
+
+    double num_pixels = TEXTURE_SIZE * TEXTURE_SIZE / 1000000.0;
+    run_benchmark("decode_texture", decode_texture, &scenario, TEXTURE_NUM_ITERATIONS, num_pixels, "Mpixels/s");
+    run_benchmark("generate_mip_chain", generate_mips, &scenario, TEXTURE_NUM_ITERATIONS, num_pixels, "Mpixels/s");
+    run_benchmark("compress_texture_bc1", compress_texture, &scenario, TEXTURE_NUM_ITERATIONS, num_pixels, "Mpixels/s");
+
+    unmap_file(&scenario.png_file);
+    free(scenario.pixels);
+    free(scenario.compressed);
+}
+
+typedef struct {
+    float* vertices;
+    float matrix[4][4];
+} transform_scenario_t;
+
+void transform_vertices(void* data) {
+    transform_scenario_t* scenario = data;
+    apply_matrix_transform(scenario->vertices, TRANSFORM_NUM_VERTICES, scenario->matrix);
+}
+
+void bench_transform() {
+    transform_scenario_t scenario;
+    scenario.vertices = malloc(TRANSFORM_NUM_VERTICES * 4 * sizeof(float));
+    fill_vertices(scenario.vertices, TRANSFORM_NUM_VERTICES);
+
+    // A small rotation so the vertices stay in range however many times they're transformed.
+    transform_stack_t stack;
+    transform_stack_init(&stack);
+    transform_stack_rotate_x(&stack, 0.63f / 60);
+    transform_stack_rotate_y(&stack, 0.5f / 60);
+    memcpy(scenario.matrix, transform_stack_top(&stack), sizeof(scenario.matrix));
+
+    run_benchmark(
+            "apply_matrix_transform", transform_vertices, &scenario, TRANSFORM_NUM_ITERATIONS,
+            TRANSFORM_NUM_VERTICES / 1000000.0, "Mvertices/s"
+    );
+    free(scenario.vertices);
+}
+
+typedef struct {
+    render_backend_t backend;
+    object_t objects[RENDER_NUM_OBJECTS];
+    float spins[RENDER_NUM_OBJECTS][4][4];
+} render_scenario_t;
+
+float random_range(float min, float max) {
+    return min + (float)rand() / RAND_MAX * (max - min);
+}
+
+// A UV sphere of radius 1, wound counter clockwise when seen from outside like the triangles in glTF models.
+void create_sphere(arena_t* arena, object_t* object) {
+    int num_vertices = (RENDER_SPHERE_STACKS + 1) * (RENDER_SPHERE_SLICES + 1);
+    object->vertex_format = VERTEX_FORMAT_POSITION_UV;
+    object->vertex_stride = get_vertex_stride(VERTEX_FORMAT_POSITION_UV);
+    object->num_vertices = num_vertices;
+    object->num_indices = RENDER_SPHERE_STACKS * RENDER_SPHERE_SLICES * 2;
+    object->index_type = get_index_type(num_vertices);
+    object->vertices = arena_alloc(arena, num_vertices * object->vertex_stride * sizeof(GLfloat));
+    object->indices = arena_alloc(arena, get_object_indices_size(object));
+
+    for(int stack = 0; stack <= RENDER_SPHERE_STACKS; stack++) {
+        for(int slice = 0; slice <= RENDER_SPHERE_SLICES; slice++) {
+            float theta = (float)M_PI * stack / RENDER_SPHERE_STACKS;
+            float phi = 2 * (float)M_PI * slice / RENDER_SPHERE_SLICES;
+            GLfloat* vertex = &object->vertices[(stack * (RENDER_SPHERE_SLICES + 1) + slice) * object->vertex_stride];
+            memset(vertex, 0, object->vertex_stride * sizeof(GLfloat));
+            vertex[VERTEX_POSITION_OFFSET + 0] = sinf(theta) * cosf(phi);
+            vertex[VERTEX_POSITION_OFFSET + 1] = cosf(theta);
+            vertex[VERTEX_POSITION_OFFSET + 2] = sinf(theta) * sinf(phi);
+            vertex[VERTEX_POSITION_OFFSET + 3] = 1.0f;
+            vertex[VERTEX_TEXTURE_UV_OFFSET + 0] = (float)slice / RENDER_SPHERE_SLICES;
+            vertex[VERTEX_TEXTURE_UV_OFFSET + 1] = (float)stack / RENDER_SPHERE_STACKS;
+        }
+    }
+
+    int index_idx = 0;
+    for(int stack = 0; stack < RENDER_SPHERE_STACKS; stack++) {
+        for(int slice = 0; slice < RENDER_SPHERE_SLICES; slice++) {
+            GLuint top_left = stack * (RENDER_SPHERE_SLICES + 1) + slice;
+            GLuint bottom_left = top_left + RENDER_SPHERE_SLICES + 1;
+            set_object_index(object, index_idx++, top_left);
+            set_object_index(object, index_idx++, top_left + 1);
+            set_object_index(object, index_idx++, bottom_left);
+            set_object_index(object, index_idx++, bottom_left);
+            set_object_index(object, index_idx++, top_left + 1);
+            set_object_index(object, index_idx++, bottom_left + 1);
+        }
+    }
+    compute_object_bounds(object);
+}
+
+// Spin every object about its own position by a fixed step, like render_frame() in main.c, then draw them.
+void render_scene_frame(void* data) {
+    render_scenario_t* scenario = data;
+    for(int i = 0; i < RENDER_NUM_OBJECTS; i++) {
+        multiply_matrices(scenario->objects[i].model_matrix, scenario->spins[i], scenario->objects[i].model_matrix);
+    }
+    scenario->backend.draw_frame(&scenario->backend);
+}
+
+// FNV-1a, so a change in what gets drawn shows up in the results as well as a change in speed.
+uint32_t hash_pixels(byte* pixels, size_t num_bytes) {
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < num_bytes; i++) {
+        hash = (hash ^ pixels[i]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t bench_render(int num_frames, thread_pool_t* pool) {
+    render_scenario_t* scenario = malloc(sizeof(render_scenario_t));
+    create_raster_backend(&scenario->backend, RENDER_FRAME_SIZE, RENDER_FRAME_SIZE, pool);
+
+    GLuint texture_ids[RENDER_NUM_TEXTURES];
+    for(int i = 0; i < RENDER_NUM_TEXTURES; i++) {
+        byte* pixels = generate_texture(RENDER_TEXTURE_SIZE, BENCH_SEED + i);
+        byte* mip_chain = generate_mip_chain(pixels, RENDER_TEXTURE_SIZE, RENDER_TEXTURE_SIZE);
+        texture_ids[i] = scenario->backend.create_texture(
+                &scenario->backend, mip_chain, RENDER_TEXTURE_SIZE, RENDER_TEXTURE_SIZE
+        );
+        free(mip_chain);
+        free(pixels);
+    }
+
+    arena_t mesh_arena;
+    init_arena(&mesh_arena, 4 * 1024 * 1024, 64);
+    object_t* scene_objects[RENDER_NUM_OBJECTS];
+    srand(BENCH_SEED);
+    for(int i = 0; i < RENDER_NUM_OBJECTS; i++) {
+        object_t* object = &scenario->objects[i];
+        memset(object, 0, sizeof(object_t));
+        create_sphere(&mesh_arena, object);
+        // The spheres are small on screen, so this is also what keeps the triangle count down as there are more.
+        generate_object_lods(object, &mesh_arena);
+        object->texture_id = texture_ids[i % RENDER_NUM_TEXTURES];
+        object->position.x = random_range(-0.8f, 0.8f);
+        object->position.y = random_range(-0.8f, 0.8f);
+        object->position.z = random_range(-0.5f, 0.5f);
+
+        float scale = random_range(0.05f, 0.2f);
+        transform_stack_t stack;
+        transform_stack_init(&stack);
+        transform_stack_scale(&stack, scale, scale, scale);
+        transform_stack_rotate_x(&stack, random_range(0, 2 * (float)M_PI));
+        transform_stack_translate(&stack, object->position.x, object->position.y, object->position.z);
+        memcpy(object->model_matrix, transform_stack_top(&stack), sizeof(object->model_matrix));
+
+        transform_stack_init(&stack);
+        transform_stack_translate(&stack, -object->position.x, -object->position.y, -object->position.z);
+        transform_stack_rotate_x(&stack, random_range(-1, 1) / 60);
+        transform_stack_rotate_y(&stack, random_range(-1, 1) / 60);
+        transform_stack_translate(&stack, object->position.x, object->position.y, object->position.z);
+        memcpy(scenario->spins[i], transform_stack_top(&stack), sizeof(scenario->spins[i]));
+
+        scene_objects[i] = object;
+    }
+    scenario->backend.set_scene(&scenario->backend, scene_objects, RENDER_NUM_OBJECTS);
+
+    run_benchmark("render_cpu_frame", render_scene_frame, scenario, num_frames, 1, "frames/s");
+
+    byte* pixels = malloc(RENDER_FRAME_SIZE * RENDER_FRAME_SIZE * 4);
+    scenario->backend.read_pixels(&scenario->backend, pixels);
+    uint32_t checksum = hash_pixels(pixels, RENDER_FRAME_SIZE * RENDER_FRAME_SIZE * 4);
+
+    free(pixels);
+    scenario->backend.destroy(&scenario->backend);
+    free_arena(&mesh_arena);
+    free(scenario);
+    return checksum;
+}
+
+void write_json(const char* path, const char* label, int num_threads, int num_frames, uint32_t render_checksum) {
+    FILE* file = fopen(path, "w");
+    if(file == NULL) {
+        printf("Failed to write %s.\n", path);
+        exit(-1);
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"label\": \"%s\",\n", label);
+    fprintf(file, "  \"num_threads\": %d,\n", num_threads);
+    fprintf(file, "  \"base64_kernel\": \"%s\",\n", base64_kernel_name(base64_best_kernel()));
+    fprintf(file, "  \"transform_kernel\": \"%s\",\n", get_transform_kernel_name(get_best_transform_kernel()));
+    fprintf(file, "  \"render_frames\": %d,\n", num_frames);
+    fprintf(file, "  \"render_checksum\": \"%08x\",\n", render_checksum);
+    fprintf(file, "  \"results\": [\n");
+    for(int i = 0; i < num_results; i++) {
+        bench_result_t* result = &results[i];
+        fprintf(
+                file, "    {\"name\": \"%s\", \"unit\": \"%s\", \"iterations\": %d, \"median_ms\": %.4f, "
+                      "\"min_ms\": %.4f, \"throughput\": %.4f}%s\n",
+                result->name, result->unit, result->num_iterations, result->median_time, result->min_time,
+                result->throughput, i < num_results - 1 ? "," : ""
+        );
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+}
+
+void write_csv(const char* path, const char* label) {
+    FILE* file = fopen(path, "w");
+    if(file == NULL) {
+        printf("Failed to write %s.\n", path);
+        exit(-1);
+    }
+    fprintf(file, "label,name,unit,iterations,median_ms,min_ms,throughput\n");
+    for(int i = 0; i < num_results; i++) {
+        bench_result_t* result = &results[i];
+        fprintf(
+                file, "%s,%s,%s,%d,%.4f,%.4f,%.4f\n", label, result->name, result->unit, result->num_iterations,
+                result->median_time, result->min_time, result->throughput
+        );
+    }
+    fclose(file);
+}
+
+int main(int argc, char** argv) {
+    int num_frames = RENDER_DEFAULT_NUM_FRAMES;
+    const char* json_path = NULL;
+    const char* csv_path = NULL;
+    const char* label = "";
+    for(int i = 1; i < argc; i++) {
+        if(i + 1 < argc && strcmp(argv[i], "--frames") == 0) {
+            num_frames = atoi(argv[++i]);
+        } else if(i + 1 < argc && strcmp(argv[i], "--json") == 0) {
+            json_path = argv[++i];
+        } else if(i + 1 < argc && strcmp(argv[i], "--csv") == 0) {
+            csv_path = argv[++i];
+        } else if(i + 1 < argc && strcmp(argv[i], "--label") == 0) {
+            label = argv[++i];
+        } else {
+            printf("Usage: %s [--frames N] [--json path] [--csv path] [--label name]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(num_frames < 1) {
+        num_frames = 1;
+    }
+
+    char directory[] = "/tmp/3d_bench_XXXXXX";
+    if(mkdtemp(directory) == NULL) {
+        printf("Failed to create a directory for the benchmark files.\n");
+        exit(-1);
+    }
+    thread_pool_t* pool = create_thread_pool(0);
+
+    bench_base64();
+    bench_gltf(directory);
+    bench_textures(directory);
+    bench_transform();
+    uint32_t render_checksum = bench_render(num_frames, pool);
+
+    printf("\n%-24s %6s %12s %12s %14s\n", "benchmark", "runs", "median ms", "min ms", "throughput");
+    for(int i = 0; i < num_results; i++) {
+        bench_result_t* result = &results[i];
+        printf(
+                "%-24s %6d %12.3f %12.3f %14.2f %s\n", result->name, result->num_iterations, result->median_time,
+                result->min_time, result->throughput, result->unit
+        );
+    }
+    printf(
+            "%d threads, %s base64 kernel, %s transform kernel, rendered frame checksum %08x\n", pool->num_threads,
+            base64_kernel_name(base64_best_kernel()), get_transform_kernel_name(get_best_transform_kernel()),
+            render_checksum
+    );
+
+    if(json_path != NULL) {
+        write_json(json_path, label, pool->num_threads, num_frames, render_checksum);
+    }
+    if(csv_path != NULL) {
+        write_csv(csv_path, label);
+    }
+
+    const char* file_names[] = {
+        "external.gltf", "embedded.gltf", "embedded.gltf.cooked", "mesh.bin", "texture.png"
+    };
+    for(int i = 0; i < (int)(sizeof(file_names) / sizeof(file_names[0])); i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", directory, file_names[i]);
+        unlink(path);
+    }
+    rmdir(directory);
+    destroy_thread_pool(pool);
+    return 0;
+}
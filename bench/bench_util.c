@@ -0,0 +1,37 @@
+#include "bench_util.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+double get_current_time() {
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (double)tp.tv_sec * 1000.0 + (double)tp.tv_nsec / 1000000.0;
+}
+
+void fill_vertices(float* vertices, int num_vertices) {
+    srand(BENCH_SEED);
+    for(int i = 0; i < num_vertices; i++) {
+        vertices[i * 4 + 0] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+        vertices[i * 4 + 1] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+        vertices[i * 4 + 2] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+        vertices[i * 4 + 3] = 1.0f;
+    }
+}
+
+void fill_bytes(unsigned char* bytes, size_t num_bytes) {
+    srand(BENCH_SEED);
+    for(size_t i = 0; i < num_bytes; i++) {
+        bytes[i] = rand() & 0xff;
+    }
+}
+
+size_t remove_line_breaks(unsigned char* text, size_t length) {
+    size_t new_length = 0;
+    for(size_t i = 0; i < length; i++) {
+        if(text[i] != '\n') {
+            text[new_length++] = text[i];
+        }
+    }
+    return new_length;
+}
@@ -0,0 +1,24 @@
+#ifndef INC_3D_BENCH_UTIL_H
+#define INC_3D_BENCH_UTIL_H
+
+#include <stddef.h>
+
+// Every benchmark seeds rand() with this so each run works through the same data.
+#define BENCH_SEED 1234
+
+// Milliseconds from a monotonic clock, only useful for taking the difference between two calls.
+double get_current_time();
+
+// Fill x, y and z of each 4 float vertex with random positions in -1 to 1, and w with 1.
+void fill_vertices(float* vertices, int num_vertices);
+
+// Fill with random bytes, the same ones every run.
+void fill_bytes(unsigned char* bytes, size_t num_bytes);
+
+/**
+ * base64_encode breaks lines every 72 characters, which is useful for checking decoders but not what data URIs in glTF
+ * files contain. Removes them in place and returns the new length.
+ */
+size_t remove_line_breaks(unsigned char* text, size_t length);
+
+#endif //INC_3D_BENCH_UTIL_H
@@ -0,0 +1,163 @@
+/**
+ * Measures drawing a grid of spinning copies of one model with the OpenGL backend, once as a single instanced
+ * object and once as the same number of ordinary objects sharing the mesh, which the batch has to give a model
+ * matrix uniform each and split into a draw call per MAX_BATCH_OBJECTS. Renders offscreen through EGL so it needs a
+ * headless build.
+ *
+ * Usage: instance_bench [model.gltf] [num_frames]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb/stb_image.h"
+
+#include "bench_util.h"
+#include "../arena/arena.h"
+#include "../gl_render/gl_render.h"
+#include "../gltf/gltf.h"
+#include "../headless/headless.h"
+#include "../texture/texture.h"
+#include "../transform/transform.h"
+
+#define DEFAULT_MODEL_PATH "/Users/jack/workspace/3d/models/cube.gltf"
+#define DEFAULT_NUM_FRAMES 120
+
+#define FRAME_SIZE 1024
+// The instances are laid out in a square grid this many along each side.
+#define GRID_SIZE 100
+#define NUM_INSTANCES (GRID_SIZE * GRID_SIZE)
+
+void load_model(char* path, render_backend_t* backend, arena_t* mesh_arena, object_t* object_out) {
+    gltf_t gltf;
+    open_gltf(path, &gltf);
+    load_gltf_meshes(&gltf, VERTEX_FORMAT_POSITION_UV, mesh_arena, object_out);
+
+    size_t image_size;
+    byte* image = get_gltf_texture_image(&gltf, &image_size);
+    if(image != NULL) {
+        int width, height, num_channels;
+        byte* pixels = stbi_load_from_memory(image, (int)image_size, &width, &height, &num_channels, STBI_rgb_alpha);
+        if(pixels == NULL) {
+            printf("Failed to decode the texture in %s.\n", path);
+            exit(-1);
+        }
+        byte* mip_chain = generate_mip_chain(pixels, width, height);
+        object_out->texture_id = backend->create_texture(backend, mip_chain, width, height);
+        free(mip_chain);
+        stbi_image_free(pixels);
+    }
+    close_gltf(&gltf);
+}
+
+/**
+ * Scale the model to fit in its grid cell, tilt each one differently so they don't all look the same, and move it
+ * to its cell. Also get the small rotation about the cell's centre that each instance spins by every frame.
+ */
+void get_grid_matrices(object_t* model, float (*matrices)[4][4], float (*spins)[4][4]) {
+    bounds_t* bounds = &model->bounds;
+    float cell_size = 2.0f / GRID_SIZE;
+    float scale = cell_size * 0.4f / (bounds->radius > 0 ? bounds->radius : 1.0f);
+    for(int i = 0; i < NUM_INSTANCES; i++) {
+        float x = -1.0f + cell_size * ((float)(i % GRID_SIZE) + 0.5f);
+        float y = -1.0f + cell_size * ((float)(i / GRID_SIZE) + 0.5f);
+
+        transform_stack_t stack;
+        transform_stack_init(&stack);
+        transform_stack_translate(&stack, -bounds->center.x, -bounds->center.y, -bounds->center.z);
+        transform_stack_scale(&stack, scale, scale, scale);
+        transform_stack_rotate_x(&stack, (float)i * 0.37f);
+        transform_stack_rotate_y(&stack, (float)i * 0.61f);
+        transform_stack_translate(&stack, x, y, 0);
+        memcpy(matrices[i], transform_stack_top(&stack), sizeof(float[4][4]));
+
+        transform_stack_init(&stack);
+        transform_stack_translate(&stack, -x, -y, 0);
+        transform_stack_rotate_y(&stack, 1.0f / 60);
+        transform_stack_translate(&stack, x, y, 0);
+        memcpy(spins[i], transform_stack_top(&stack), sizeof(float[4][4]));
+    }
+}
+
+// Spin every copy and draw a frame, waiting for the GPU to finish so its time is counted too.
+double time_frames(render_backend_t* backend, float (**matrices)[4], float (*spins)[4][4], int num_frames) {
+    double start_time = 0;
+    // The first frame is a warm up, where the driver compiles shaders and allocates buffers.
+    for(int frame = 0; frame <= num_frames; frame++) {
+        if(frame == 1) {
+            start_time = get_current_time();
+        }
+        for(int i = 0; i < NUM_INSTANCES; i++) {
+            multiply_matrices(matrices[i], spins[i], matrices[i]);
+        }
+        backend->draw_frame(backend);
+        glFinish();
+    }
+    return (get_current_time() - start_time) / num_frames;
+}
+
+int main(int argc, char** argv) {
+    char* model_path = argc > 1 ? argv[1] : DEFAULT_MODEL_PATH;
+    int num_frames = argc > 2 ? atoi(argv[2]) : DEFAULT_NUM_FRAMES;
+
+    headless_context_t context;
+    create_headless_context(&context, FRAME_SIZE, FRAME_SIZE);
+    arena_t mesh_arena;
+    arena_t scratch_arena;
+    init_arena(&mesh_arena, 4 * 1024 * 1024, 64);
+    init_arena(&scratch_arena, 16 * 1024 * 1024, 16);
+    render_backend_t backend;
+    create_gl_backend(&backend, FRAME_SIZE, FRAME_SIZE, &scratch_arena);
+
+    object_t model = { 0 };
+    load_model(model_path, &backend, &mesh_arena, &model);
+
+    float (*spins)[4][4] = malloc(NUM_INSTANCES * sizeof(float[4][4]));
+    float (*instance_matrices)[4][4] = malloc(NUM_INSTANCES * sizeof(float[4][4]));
+    get_grid_matrices(&model, instance_matrices, spins);
+
+    // One object drawing every copy.
+    object_t instanced = model;
+    instanced.instance_matrices = instance_matrices;
+    instanced.num_instances = NUM_INSTANCES;
+    object_t* scene = &instanced;
+    backend.set_scene(&backend, &scene, 1);
+    float (**matrices)[4] = malloc(NUM_INSTANCES * sizeof(float (*)[4]));
+    for(int i = 0; i < NUM_INSTANCES; i++) {
+        matrices[i] = instanced.instance_matrices[i];
+    }
+    double instanced_time = time_frames(&backend, matrices, spins, num_frames);
+    int instanced_triangles = backend.num_drawn_triangles;
+
+    // The same copies as separate objects, with their vertices and indices shared rather than duplicated.
+    get_grid_matrices(&model, instance_matrices, spins);
+    object_t* objects = malloc(NUM_INSTANCES * sizeof(object_t));
+    object_t** scene_objects = malloc(NUM_INSTANCES * sizeof(object_t*));
+    for(int i = 0; i < NUM_INSTANCES; i++) {
+        objects[i] = model;
+        memcpy(objects[i].model_matrix, instance_matrices[i], sizeof(float[4][4]));
+        scene_objects[i] = &objects[i];
+        matrices[i] = objects[i].model_matrix;
+    }
+    backend.set_scene(&backend, scene_objects, NUM_INSTANCES);
+    double separate_time = time_frames(&backend, matrices, spins, num_frames);
+    int separate_triangles = backend.num_drawn_triangles;
+
+    printf("%d copies of %s, %d frames at %dx%d\n", NUM_INSTANCES, model_path, num_frames, FRAME_SIZE, FRAME_SIZE);
+    printf("instanced: %7.2fms/frame, %d triangles\n", instanced_time, instanced_triangles);
+    printf("separate:  %7.2fms/frame, %d triangles (%.2fx instanced)\n",
+           separate_time, separate_triangles, separate_time / instanced_time);
+
+    free(objects);
+    free(scene_objects);
+    free(matrices);
+    free(instance_matrices);
+    free(spins);
+    backend.destroy(&backend);
+    free_arena(&mesh_arena);
+    free_arena(&scratch_arena);
+    destroy_headless_context(&context);
+    return 0;
+}
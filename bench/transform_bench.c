@@ -0,0 +1,102 @@
+/**
+ * Compares transforming a mesh the way display() used to, with a separate pass over the vertices for each
+ * matrix, against composing the matrices with a transform stack and transforming the vertices once.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "../transform/transform.h"
+
+#define NUM_VERTICES 1000000
+#define NUM_ITERATIONS 20
+
+/**
+ * The old per frame workload for one object: two calls to rotate_object(), each translating to the origin,
+ * rotating and translating back, with every matrix applied in its own pass.
+ */
+int transform_separately(float* vertices, int num_vertices, float x_theta, float y_theta) {
+    float matrix[4][4];
+    int num_passes = 0;
+
+    get_translate_matrix(matrix, -0.5f, 0, 0);
+    apply_matrix_transform(vertices, num_vertices, matrix); num_passes++;
+    get_x_rotation_matrix(matrix, x_theta);
+    apply_matrix_transform(vertices, num_vertices, matrix); num_passes++;
+    get_translate_matrix(matrix, 0.5f, 0, 0);
+    apply_matrix_transform(vertices, num_vertices, matrix); num_passes++;
+
+    get_translate_matrix(matrix, -0.5f, 0, 0);
+    apply_matrix_transform(vertices, num_vertices, matrix); num_passes++;
+    get_y_rotation_matrix(matrix, y_theta);
+    apply_matrix_transform(vertices, num_vertices, matrix); num_passes++;
+    get_translate_matrix(matrix, 0.5f, 0, 0);
+    apply_matrix_transform(vertices, num_vertices, matrix); num_passes++;
+
+    return num_passes;
+}
+
+int transform_fused(float* vertices, int num_vertices, float x_theta, float y_theta) {
+    transform_stack_t stack;
+    transform_stack_init(&stack);
+    transform_stack_translate(&stack, -0.5f, 0, 0);
+    transform_stack_rotate_x(&stack, x_theta);
+    transform_stack_rotate_y(&stack, y_theta);
+    transform_stack_translate(&stack, 0.5f, 0, 0);
+
+    transform_stack_apply(&stack, vertices, num_vertices);
+    return 1;
+}
+
+int main() {
+    size_t buffer_size = NUM_VERTICES * 4 * sizeof(float);
+    float* separate_vertices = malloc(buffer_size);
+    float* fused_vertices = malloc(buffer_size);
+    fill_vertices(separate_vertices, NUM_VERTICES);
+    memcpy(fused_vertices, separate_vertices, buffer_size);
+
+    int separate_passes = 0;
+    double start_time = get_current_time();
+    for(int i = 0; i < NUM_ITERATIONS; i++) {
+        separate_passes = transform_separately(separate_vertices, NUM_VERTICES, 0.01f, 0.02f);
+    }
+    double separate_time = (get_current_time() - start_time) / NUM_ITERATIONS;
+
+    int fused_passes = 0;
+    start_time = get_current_time();
+    for(int i = 0; i < NUM_ITERATIONS; i++) {
+        fused_passes = transform_fused(fused_vertices, NUM_VERTICES, 0.01f, 0.02f);
+    }
+    double fused_time = (get_current_time() - start_time) / NUM_ITERATIONS;
+
+    // Both paths should land the vertices in the same place, give or take float rounding.
+    float max_error = 0;
+    for(int i = 0; i < NUM_VERTICES * 4; i++) {
+        float error = fabsf(separate_vertices[i] - fused_vertices[i]);
+        if(error > max_error) {
+            max_error = error;
+        }
+    }
+
+    double megabytes = buffer_size / (1024.0 * 1024.0);
+    printf("%d vertices, %d iterations, max difference between results %g\n", NUM_VERTICES, NUM_ITERATIONS, max_error);
+    printf(
+            "separate: %d passes, %.1fMB read+written, %.2fms per frame\n",
+            separate_passes, separate_passes * megabytes * 2, separate_time
+    );
+    printf(
+            "fused:    %d passes, %.1fMB read+written, %.2fms per frame (%.2fx faster)\n",
+            fused_passes, fused_passes * megabytes * 2, fused_time, separate_time / fused_time
+    );
+
+    free(separate_vertices);
+    free(fused_vertices);
+
+    if(max_error > 1e-3f) {
+        printf("Fused transform does not match the separate transforms.\n");
+        return 1;
+    }
+    return 0;
+}
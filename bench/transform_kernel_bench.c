@@ -0,0 +1,134 @@
+/**
+ * Checks each vectorised transform kernel against the original scalar transform and measures how many vertices
+ * per second each one can transform.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "../transform/transform.h"
+
+#define NUM_VERTICES 1000000
+#define NUM_ITERATIONS 50
+// Deliberately not a multiple of the unroll width so the tail handling gets checked too.
+#define NUM_CHECK_VERTICES 1003
+
+// The transform as it was originally written in main.c, used as the source of truth.
+void reference_matrix_transform(float* vertex_pointer, int num_vertices, float matrix[4][4]) {
+    for(int vertex_idx = 0; vertex_idx < num_vertices; vertex_idx++) {
+        int idx = vertex_idx * 4;
+
+        float result[4] = { 0, 0, 0, 0 };
+
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                result[i] += matrix[i][j] * vertex_pointer[idx + j];
+            }
+        }
+        for (int i = 0; i < 4; i++) {
+            vertex_pointer[idx + i] = result[i];
+        }
+    }
+}
+
+void get_test_matrix(float output[4][4]) {
+    transform_stack_t stack;
+    transform_stack_init(&stack);
+    transform_stack_scale(&stack, 1.5f, 0.5f, 2.0f);
+    transform_stack_rotate_x(&stack, 0.3f);
+    transform_stack_rotate_y(&stack, -0.7f);
+    transform_stack_translate(&stack, 0.25f, -1.0f, 3.0f);
+    memcpy(output, transform_stack_top(&stack), sizeof(float) * 16);
+}
+
+/**
+ * Run the kernel over vertices interleaved with other data every vertex_stride floats and make sure the positions
+ * match the reference and everything in between is left alone.
+ */
+int check_kernel(transform_kernel_t kernel, float matrix[4][4], int vertex_stride) {
+    float* expected = malloc(NUM_CHECK_VERTICES * 4 * sizeof(float));
+    float* actual = malloc(NUM_CHECK_VERTICES * vertex_stride * sizeof(float));
+    fill_vertices(expected, NUM_CHECK_VERTICES);
+    for(int i = 0; i < NUM_CHECK_VERTICES; i++) {
+        memcpy(&actual[i * vertex_stride], &expected[i * 4], 4 * sizeof(float));
+        for(int j = 4; j < vertex_stride; j++) {
+            actual[i * vertex_stride + j] = (float)j;
+        }
+    }
+
+    reference_matrix_transform(expected, NUM_CHECK_VERTICES, matrix);
+    apply_matrix_transform_with_kernel(kernel, actual, NUM_CHECK_VERTICES, vertex_stride, matrix);
+
+    // FMA rounds differently to a separate multiply and add so only expect the results to be close.
+    int is_correct = 1;
+    for(int i = 0; i < NUM_CHECK_VERTICES && is_correct; i++) {
+        for(int j = 0; j < vertex_stride; j++) {
+            float expected_value = j < 4 ? expected[i * 4 + j] : (float)j;
+            float actual_value = actual[i * vertex_stride + j];
+            if(fabsf(expected_value - actual_value) > 1e-5f * fmaxf(1.0f, fabsf(expected_value))) {
+                printf(
+                        "%s kernel mismatch with stride %d at vertex %d component %d: expected %f, got %f\n",
+                        get_transform_kernel_name(kernel), vertex_stride, i, j, expected_value, actual_value
+                );
+                is_correct = 0;
+                break;
+            }
+        }
+    }
+
+    free(expected);
+    free(actual);
+    return is_correct;
+}
+
+int main() {
+    float matrix[4][4];
+    get_test_matrix(matrix);
+
+    // The timed runs transform the same vertices repeatedly, so only rotate them to stop the values overflowing.
+    float timing_matrix[4][4];
+    get_x_rotation_matrix(timing_matrix, 0.01f);
+
+    float* vertices = malloc(NUM_VERTICES * 4 * sizeof(float));
+    int all_correct = 1;
+
+    printf("best kernel: %s\n", get_transform_kernel_name(get_best_transform_kernel()));
+
+    // The original implementation is timed first so the kernels have something to be compared against.
+    fill_vertices(vertices, NUM_VERTICES);
+    double start_time = get_current_time();
+    for(int i = 0; i < NUM_ITERATIONS; i++) {
+        reference_matrix_transform(vertices, NUM_VERTICES, timing_matrix);
+    }
+    double reference_seconds = (get_current_time() - start_time) / 1000.0;
+    double reference_rate = (double)NUM_VERTICES * NUM_ITERATIONS / reference_seconds;
+    printf("%-10s %8.1f million vertices/s\n", "reference", reference_rate / 1e6);
+
+    for(int kernel = 0; kernel < NUM_TRANSFORM_KERNELS; kernel++) {
+        if(!is_transform_kernel_supported(kernel)) {
+            printf("%-10s not supported\n", get_transform_kernel_name(kernel));
+            continue;
+        }
+        if(!check_kernel(kernel, matrix, 4) || !check_kernel(kernel, matrix, 8)) {
+            all_correct = 0;
+            continue;
+        }
+
+        fill_vertices(vertices, NUM_VERTICES);
+        start_time = get_current_time();
+        for(int i = 0; i < NUM_ITERATIONS; i++) {
+            apply_matrix_transform_with_kernel(kernel, vertices, NUM_VERTICES, 4, timing_matrix);
+        }
+        double seconds = (get_current_time() - start_time) / 1000.0;
+        double rate = (double)NUM_VERTICES * NUM_ITERATIONS / seconds;
+        printf(
+                "%-10s %8.1f million vertices/s (%.2fx reference)\n",
+                get_transform_kernel_name(kernel), rate / 1e6, rate / reference_rate
+        );
+    }
+
+    free(vertices);
+    return all_correct ? 0 : 1;
+}
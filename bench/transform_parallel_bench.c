@@ -0,0 +1,63 @@
+/**
+ * Measures how the parallel transform scales with the number of threads, using the same rotation about the
+ * objects position that display() applies to each model every frame.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "../thread_pool/thread_pool.h"
+#include "../transform/transform.h"
+
+#define NUM_VERTICES 4000000
+#define NUM_ITERATIONS 20
+
+void get_display_matrix(float output[4][4]) {
+    transform_stack_t stack;
+    transform_stack_init(&stack);
+    transform_stack_translate(&stack, -0.5f, 0, 0);
+    transform_stack_rotate_x(&stack, 0.63f / 60);
+    transform_stack_rotate_y(&stack, 0.5f / 60);
+    transform_stack_translate(&stack, 0.5f, 0, 0);
+    memcpy(output, transform_stack_top(&stack), sizeof(float) * 16);
+}
+
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : get_num_cpu_cores();
+
+    float matrix[4][4];
+    get_display_matrix(matrix);
+
+    float* vertices = malloc(NUM_VERTICES * 4 * sizeof(float));
+    fill_vertices(vertices, NUM_VERTICES);
+
+    double start_time = get_current_time();
+    for(int i = 0; i < NUM_ITERATIONS; i++) {
+        apply_matrix_transform(vertices, NUM_VERTICES, matrix);
+    }
+    double serial_time = (get_current_time() - start_time) / NUM_ITERATIONS;
+    printf("%d vertices, %s kernel\n", NUM_VERTICES, get_transform_kernel_name(get_best_transform_kernel()));
+    printf("serial:     %7.2fms\n", serial_time);
+
+    // Double the threads each pass, but make sure the core count itself is measured when it isn't a power of two.
+    for(
+            int num_threads = 1; num_threads <= max_threads;
+            num_threads = num_threads < max_threads && num_threads * 2 > max_threads ? max_threads : num_threads * 2
+    ) {
+        thread_pool_t* pool = create_thread_pool(num_threads);
+
+        start_time = get_current_time();
+        for(int i = 0; i < NUM_ITERATIONS; i++) {
+            apply_matrix_transform_parallel(pool, vertices, NUM_VERTICES, 4, matrix);
+        }
+        double parallel_time = (get_current_time() - start_time) / NUM_ITERATIONS;
+        printf("%2d threads: %7.2fms (%.2fx serial)\n", num_threads, parallel_time, serial_time / parallel_time);
+
+        destroy_thread_pool(pool);
+    }
+
+    free(vertices);
+    return 0;
+}
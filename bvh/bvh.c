@@ -0,0 +1,353 @@
+#include "bvh.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../profiler/profiler.h"
+
+// Deep enough for far more instances than fit in memory, as leaves are split down the middle.
+#define BVH_MAX_DEPTH 64
+
+void get_frustum(float view_projection[4][4], frustum_t* frustum_out) {
+    // Each plane is where one clip coordinate equals plus or minus w, e.g. the left plane is where x + w = 0.
+    for(int axis = 0; axis < 3; axis++) {
+        for(int side = 0; side < 2; side++) {
+            float* plane = frustum_out->planes[axis * 2 + side];
+            float sign = side == 0 ? 1.0f : -1.0f;
+            for(int i = 0; i < 4; i++) {
+                plane[i] = view_projection[3][i] + sign * view_projection[axis][i];
+            }
+
+            // Normalise so the plane gives distances, which the sphere test needs.
+            float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            for(int i = 0; i < 4; i++) {
+                plane[i] /= length;
+            }
+        }
+    }
+}
+
+static float get_axis(vec3_t vector, int axis) {
+    return axis == 0 ? vector.x : axis == 1 ? vector.y : vector.z;
+}
+
+/**
+ * Move an instance's bounds to where its model matrix puts it. The box around the moved box comes from transforming
+ * its centre and adding up how far each axis of its half size reaches, which only holds for matrices without a
+ * projection, and the sphere grows by the largest scale in the matrix.
+ */
+static void update_instance_bounds(bvh_t* bvh, int instance_idx) {
+    int object_idx = bvh->instance_objects[instance_idx];
+    object_t* object = bvh->objects[object_idx];
+    float (*matrix)[4] = get_instance_matrix(object, instance_idx - bvh->object_first_instances[object_idx]);
+    bounds_t* bounds = &object->bounds;
+
+    float center[3] = {
+        (bounds->min.x + bounds->max.x) / 2,
+        (bounds->min.y + bounds->max.y) / 2,
+        (bounds->min.z + bounds->max.z) / 2,
+    };
+    float half_size[3] = {
+        (bounds->max.x - bounds->min.x) / 2,
+        (bounds->max.y - bounds->min.y) / 2,
+        (bounds->max.z - bounds->min.z) / 2,
+    };
+    float sphere_center[3] = { bounds->center.x, bounds->center.y, bounds->center.z };
+
+    float moved_center[3];
+    float moved_half_size[3];
+    float moved_sphere_center[3];
+    float max_scale_squared = 0;
+    for(int i = 0; i < 3; i++) {
+        moved_center[i] = matrix[i][3];
+        moved_half_size[i] = 0;
+        moved_sphere_center[i] = matrix[i][3];
+        for(int j = 0; j < 3; j++) {
+            moved_center[i] += matrix[i][j] * center[j];
+            moved_half_size[i] += fabsf(matrix[i][j]) * half_size[j];
+            moved_sphere_center[i] += matrix[i][j] * sphere_center[j];
+        }
+
+        // Column i is where the model's i axis ends up, so its length is how much that axis is scaled.
+        float scale_squared = matrix[0][i] * matrix[0][i] + matrix[1][i] * matrix[1][i] + matrix[2][i] * matrix[2][i];
+        max_scale_squared = fmaxf(max_scale_squared, scale_squared);
+    }
+
+    bvh->instance_mins[instance_idx] = (vec3_t){
+        moved_center[0] - moved_half_size[0], moved_center[1] - moved_half_size[1], moved_center[2] - moved_half_size[2]
+    };
+    bvh->instance_maxes[instance_idx] = (vec3_t){
+        moved_center[0] + moved_half_size[0], moved_center[1] + moved_half_size[1], moved_center[2] + moved_half_size[2]
+    };
+    bvh->instance_centers[instance_idx] = (vec3_t){
+        moved_sphere_center[0], moved_sphere_center[1], moved_sphere_center[2]
+    };
+    bvh->instance_radiuses[instance_idx] = bounds->radius * sqrtf(max_scale_squared);
+}
+
+static void grow_box(vec3_t* min, vec3_t* max, vec3_t other_min, vec3_t other_max) {
+    min->x = fminf(min->x, other_min.x);
+    min->y = fminf(min->y, other_min.y);
+    min->z = fminf(min->z, other_min.z);
+    max->x = fmaxf(max->x, other_max.x);
+    max->y = fmaxf(max->y, other_max.y);
+    max->z = fmaxf(max->z, other_max.z);
+}
+
+static void fit_node(bvh_t* bvh, int node_idx) {
+    bvh_node_t* node = &bvh->nodes[node_idx];
+    if(node->num_instances == 0) {
+        bvh_node_t* first_child = &bvh->nodes[node_idx + 1];
+        bvh_node_t* second_child = &bvh->nodes[node->first];
+        node->min = first_child->min;
+        node->max = first_child->max;
+        grow_box(&node->min, &node->max, second_child->min, second_child->max);
+        return;
+    }
+
+    int first_instance_idx = bvh->instance_order[node->first];
+    node->min = bvh->instance_mins[first_instance_idx];
+    node->max = bvh->instance_maxes[first_instance_idx];
+    for(int i = 1; i < node->num_instances; i++) {
+        int instance_idx = bvh->instance_order[node->first + i];
+        grow_box(&node->min, &node->max, bvh->instance_mins[instance_idx], bvh->instance_maxes[instance_idx]);
+    }
+}
+
+static float get_instance_center(bvh_t* bvh, int instance_idx, int axis) {
+    return (get_axis(bvh->instance_mins[instance_idx], axis) + get_axis(bvh->instance_maxes[instance_idx], axis)) / 2;
+}
+
+/**
+ * Rearrange a run of the instance order so the instance at the middle is where it would be if the run was sorted by
+ * centre along the axis, with smaller ones before it and bigger ones after.
+ */
+static void partition_instances(bvh_t* bvh, int* order, int count, int axis) {
+    int low = 0;
+    int high = count - 1;
+    int middle = count / 2;
+    while(low < high) {
+        float pivot = get_instance_center(bvh, order[(low + high) / 2], axis);
+        int i = low;
+        int j = high;
+        while(i <= j) {
+            while(get_instance_center(bvh, order[i], axis) < pivot) {
+                i++;
+            }
+            while(get_instance_center(bvh, order[j], axis) > pivot) {
+                j--;
+            }
+            if(i <= j) {
+                int swap = order[i];
+                order[i++] = order[j];
+                order[j--] = swap;
+            }
+        }
+        if(middle <= j) {
+            high = j;
+        } else if(middle >= i) {
+            low = i;
+        } else {
+            break;
+        }
+    }
+}
+
+// Build the node for a run of the instance order, splitting it in half along the axis they're most spread out on.
+static void build_node(bvh_t* bvh, int first, int count) {
+    int node_idx = bvh->num_nodes++;
+    bvh_node_t* node = &bvh->nodes[node_idx];
+    if(count <= BVH_MAX_LEAF_INSTANCES) {
+        node->first = first;
+        node->num_instances = count;
+        fit_node(bvh, node_idx);
+        return;
+    }
+
+    float min_center[3];
+    float max_center[3];
+    for(int axis = 0; axis < 3; axis++) {
+        min_center[axis] = INFINITY;
+        max_center[axis] = -INFINITY;
+        for(int i = first; i < first + count; i++) {
+            float center = get_instance_center(bvh, bvh->instance_order[i], axis);
+            min_center[axis] = fminf(min_center[axis], center);
+            max_center[axis] = fmaxf(max_center[axis], center);
+        }
+    }
+    int split_axis = 0;
+    for(int axis = 1; axis < 3; axis++) {
+        if(max_center[axis] - min_center[axis] > max_center[split_axis] - min_center[split_axis]) {
+            split_axis = axis;
+        }
+    }
+    partition_instances(bvh, &bvh->instance_order[first], count, split_axis);
+
+    node->num_instances = 0;
+    build_node(bvh, first, count / 2);
+    // The node array never moves while building, it's allocated for the most nodes there can be.
+    bvh->nodes[node_idx].first = bvh->num_nodes;
+    build_node(bvh, first + count / 2, count - count / 2);
+    fit_node(bvh, node_idx);
+}
+
+void build_bvh(bvh_t* bvh, object_t** objects, int num_objects) {
+    PROFILE_SCOPE("build_bvh");
+    memset(bvh, 0, sizeof(bvh_t));
+    bvh->num_objects = num_objects;
+    bvh->objects = malloc(num_objects * sizeof(object_t*));
+    memcpy(bvh->objects, objects, num_objects * sizeof(object_t*));
+
+    bvh->object_first_instances = malloc((num_objects + 1) * sizeof(int));
+    for(int i = 0; i < num_objects; i++) {
+        bvh->object_first_instances[i] = bvh->num_instances;
+        bvh->num_instances += get_object_num_instances(objects[i]);
+    }
+    bvh->object_first_instances[num_objects] = bvh->num_instances;
+
+    int num_instances = bvh->num_instances;
+    bvh->instance_objects = malloc(num_instances * sizeof(int));
+    bvh->instance_order = malloc(num_instances * sizeof(int));
+    bvh->instance_mins = malloc(num_instances * sizeof(vec3_t));
+    bvh->instance_maxes = malloc(num_instances * sizeof(vec3_t));
+    bvh->instance_centers = malloc(num_instances * sizeof(vec3_t));
+    bvh->instance_radiuses = malloc(num_instances * sizeof(float));
+    bvh->is_visible = malloc(num_instances);
+
+    for(int object_idx = 0; object_idx < num_objects; object_idx++) {
+        int first = bvh->object_first_instances[object_idx];
+        for(int i = first; i < bvh->object_first_instances[object_idx + 1]; i++) {
+            bvh->instance_objects[i] = object_idx;
+        }
+    }
+    for(int i = 0; i < num_instances; i++) {
+        bvh->instance_order[i] = i;
+        bvh->is_visible[i] = 1;
+        update_instance_bounds(bvh, i);
+    }
+    bvh->num_visible = num_instances;
+
+    // A binary tree with a leaf per instance has one fewer inner node than leaves, and leaves only get fuller.
+    bvh->nodes = malloc((num_instances > 0 ? num_instances * 2 - 1 : 0) * sizeof(bvh_node_t));
+    if(num_instances > 0) {
+        build_node(bvh, 0, num_instances);
+    }
+}
+
+void free_bvh(bvh_t* bvh) {
+    free(bvh->objects);
+    free(bvh->object_first_instances);
+    free(bvh->instance_objects);
+    free(bvh->instance_order);
+    free(bvh->nodes);
+    free(bvh->instance_mins);
+    free(bvh->instance_maxes);
+    free(bvh->instance_centers);
+    free(bvh->instance_radiuses);
+    free(bvh->is_visible);
+    memset(bvh, 0, sizeof(bvh_t));
+}
+
+void refit_bvh(bvh_t* bvh) {
+    PROFILE_SCOPE("refit_bvh");
+    for(int i = 0; i < bvh->num_instances; i++) {
+        update_instance_bounds(bvh, i);
+    }
+
+    // Children are always after their parents, so going backwards fits every child before its parent.
+    for(int node_idx = bvh->num_nodes - 1; node_idx >= 0; node_idx--) {
+        fit_node(bvh, node_idx);
+    }
+}
+
+/**
+ * Test a box against the planes in the mask. Returns 0 if it's entirely outside one of them, otherwise clears the
+ * planes it's entirely inside of from the mask so nothing inside the box needs testing against them again.
+ */
+static int test_box(frustum_t* frustum, vec3_t min, vec3_t max, int* plane_mask) {
+    for(int i = 0; i < FRUSTUM_NUM_PLANES; i++) {
+        if(!(*plane_mask & (1 << i))) {
+            continue;
+        }
+        float* plane = frustum->planes[i];
+
+        // The corner furthest along the plane's normal is the last to leave it, and the nearest is the first.
+        float furthest = plane[3];
+        furthest += plane[0] * (plane[0] >= 0 ? max.x : min.x);
+        furthest += plane[1] * (plane[1] >= 0 ? max.y : min.y);
+        furthest += plane[2] * (plane[2] >= 0 ? max.z : min.z);
+        if(furthest < 0) {
+            return 0;
+        }
+        float nearest = plane[3];
+        nearest += plane[0] * (plane[0] >= 0 ? min.x : max.x);
+        nearest += plane[1] * (plane[1] >= 0 ? min.y : max.y);
+        nearest += plane[2] * (plane[2] >= 0 ? min.z : max.z);
+        if(nearest >= 0) {
+            *plane_mask &= ~(1 << i);
+        }
+    }
+    return 1;
+}
+
+static int test_sphere(frustum_t* frustum, vec3_t center, float radius, int plane_mask) {
+    for(int i = 0; i < FRUSTUM_NUM_PLANES; i++) {
+        float* plane = frustum->planes[i];
+        if((plane_mask & (1 << i)) &&
+           plane[0] * center.x + plane[1] * center.y + plane[2] * center.z + plane[3] < -radius) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int cull_bvh(bvh_t* bvh, frustum_t* frustum) {
+    PROFILE_SCOPE("cull_bvh");
+    memset(bvh->is_visible, 0, bvh->num_instances);
+    bvh->num_visible = 0;
+    if(bvh->num_nodes == 0) {
+        return 0;
+    }
+
+    int stack_nodes[BVH_MAX_DEPTH];
+    int stack_plane_masks[BVH_MAX_DEPTH];
+    int stack_size = 0;
+    stack_nodes[stack_size] = 0;
+    stack_plane_masks[stack_size++] = (1 << FRUSTUM_NUM_PLANES) - 1;
+    while(stack_size > 0) {
+        stack_size--;
+        bvh_node_t* node = &bvh->nodes[stack_nodes[stack_size]];
+        int plane_mask = stack_plane_masks[stack_size];
+        if(plane_mask != 0 && !test_box(frustum, node->min, node->max, &plane_mask)) {
+            continue;
+        }
+
+        if(node->num_instances == 0) {
+            stack_nodes[stack_size] = node->first;
+            stack_plane_masks[stack_size++] = plane_mask;
+            stack_nodes[stack_size] = (int)(node - bvh->nodes) + 1;
+            stack_plane_masks[stack_size++] = plane_mask;
+            continue;
+        }
+
+        // A leaf's box is around all of its instances, so each one still needs testing unless the whole leaf is inside.
+        for(int i = 0; i < node->num_instances; i++) {
+            int instance_idx = bvh->instance_order[node->first + i];
+            int instance_plane_mask = plane_mask;
+            int is_visible = plane_mask == 0 || (
+                    test_sphere(
+                            frustum, bvh->instance_centers[instance_idx], bvh->instance_radiuses[instance_idx],
+                            plane_mask
+                    ) &&
+                    test_box(
+                            frustum, bvh->instance_mins[instance_idx], bvh->instance_maxes[instance_idx],
+                            &instance_plane_mask
+                    )
+            );
+            bvh->is_visible[instance_idx] = (byte)is_visible;
+            bvh->num_visible += is_visible;
+        }
+    }
+    return bvh->num_visible;
+}
@@ -0,0 +1,96 @@
+#ifndef INC_3D_BVH_H
+#define INC_3D_BVH_H
+
+#include "../object/object.h"
+
+// Leaves stop being split once they have this many instances or fewer.
+#define BVH_MAX_LEAF_INSTANCES 4
+
+#define FRUSTUM_NUM_PLANES 6
+
+/**
+ * The six planes around everything that can be seen, left, right, bottom, top, near and far. Each is a, b, c, d with
+ * the normal pointing inwards, so a point is on the visible side of a plane when a * x + b * y + c * z + d >= 0.
+ */
+typedef struct {
+    float planes[FRUSTUM_NUM_PLANES][4];
+} frustum_t;
+
+/**
+ * Get the frustum for a view projection matrix, anything that ends up inside the clip volume after being transformed
+ * by it is inside the frustum. Model matrices currently take vertices straight to clip space, so the view projection
+ * is the identity until there's a camera.
+ */
+void get_frustum(float view_projection[4][4], frustum_t* frustum_out);
+
+/**
+ * A node is either a leaf with a run of instances, or has two children. The first child always comes straight after
+ * its parent, so children are after their parents in the node array.
+ */
+typedef struct {
+    vec3_t min;
+    vec3_t max;
+
+    // The second child for nodes with children, or the first of the leaf's instances in the instance order.
+    int first;
+    // 0 for nodes with children.
+    int num_instances;
+} bvh_node_t;
+
+/**
+ * A bounding volume hierarchy over every instance of a scene's objects, which lets whole groups of them that are all
+ * outside the view be skipped with one test. Each instance of an instanced object is culled on its own, and an
+ * ordinary object is a single instance. It's built once for the scene and refit every frame as instances move,
+ * which keeps every box tight around its instances without rebuilding. The tree only gets worse at skipping groups
+ * the further instances move from where they were when it was built.
+ */
+typedef struct {
+    object_t** objects;
+    int num_objects;
+
+    /**
+     * Instances are numbered object by object, so an objects instances start at object_first_instances[object_idx],
+     * with one more at the end for the total. Each instance also knows which object it's of.
+     */
+    int* object_first_instances;
+    int* instance_objects;
+    int num_instances;
+
+    // Instances in the order the leaves use them.
+    int* instance_order;
+
+    bvh_node_t* nodes;
+    int num_nodes;
+
+    /**
+     * Where each instance currently is, from its object's bounds and its model matrix, updated by refit_bvh(). The
+     * box is around the object's model space box, which is tighter than one around the sphere.
+     */
+    vec3_t* instance_mins;
+    vec3_t* instance_maxes;
+    vec3_t* instance_centers;
+    float* instance_radiuses;
+
+    // Whether each instance was inside the frustum for the last cull_bvh().
+    byte* is_visible;
+    int num_visible;
+} bvh_t;
+
+/**
+ * Build a hierarchy over every instance of the objects where they are now. Holds on to the object pointers, like the
+ * render backends, and numbers the instances in the same order as the objects.
+ */
+void build_bvh(bvh_t* bvh, object_t** objects, int num_objects);
+void free_bvh(bvh_t* bvh);
+
+// Move every box to where its instances are now, from their model matrices.
+void refit_bvh(bvh_t* bvh);
+
+/**
+ * Work out which instances are at least partly inside the frustum, filling in is_visible. Groups entirely outside
+ * are skipped without looking at their instances, and groups entirely inside aren't tested again. Returns how many
+ * instances are visible.
+ */
+int cull_bvh(bvh_t* bvh, frustum_t* frustum);
+
+#endif //INC_3D_BVH_H
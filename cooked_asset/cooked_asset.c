@@ -0,0 +1,240 @@
+#include "cooked_asset.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "../texture/texture.h"
+
+static void get_cooked_asset_path(const char* source_path, char* path_out, size_t path_size) {
+    snprintf(path_out, path_size, "%s.cooked", source_path);
+}
+
+// External files are named relative to the glTF file, so they're found the same way open_gltf() finds them.
+static void get_source_file_path(const char* source_path, const char* uri, char* path_out, size_t path_size) {
+    const char* last_slash = strrchr(source_path, '/');
+    int directory_length = last_slash != NULL ? (int)(last_slash - source_path + 1) : 0;
+    snprintf(path_out, path_size, "%.*s%s", directory_length, source_path, uri);
+}
+
+static uint64_t align_offset(uint64_t offset) {
+    return (offset + COOKED_ASSET_ALIGNMENT - 1) & ~(uint64_t)(COOKED_ASSET_ALIGNMENT - 1);
+}
+
+uint64_t get_cooked_indices_size(cooked_asset_header_t* header) {
+    uint64_t num_triangles = header->num_indices;
+    if(header->num_lods > 0) {
+        object_lod_t* last_lod = &header->lods[header->num_lods - 1];
+        num_triangles = (uint64_t)last_lod->first_index + last_lod->num_indices;
+    }
+    return num_triangles * 3 * get_index_size(header->index_type);
+}
+
+// Levels of detail have to follow on from each other with no gaps, which is what get_object_lod() relies on.
+static int are_cooked_lods_valid(cooked_asset_header_t* header) {
+    if(header->num_lods > MAX_OBJECT_LODS) {
+        return 0;
+    }
+    uint64_t next_index = header->num_indices;
+    for(uint32_t i = 0; i < header->num_lods; i++) {
+        if(header->lods[i].first_index < 0 || (uint64_t)header->lods[i].first_index != next_index ||
+           header->lods[i].num_indices <= 0) {
+            return 0;
+        }
+        next_index += header->lods[i].num_indices;
+    }
+    return 1;
+}
+
+// Work out where each part of the file goes from the header's counts, and return the size of the whole file.
+static uint64_t set_cooked_asset_offsets(cooked_asset_header_t* header) {
+    size_t mip_chain_offsets[MAX_TEXTURE_LEVELS + 1];
+    int num_levels = get_mip_chain_offsets(
+            TEXTURE_FORMAT_RGBA8, (int)header->texture_width, (int)header->texture_height, mip_chain_offsets
+    );
+    header->source_files_offset = align_offset(sizeof(cooked_asset_header_t));
+    header->vertices_offset = align_offset(
+            header->source_files_offset + (uint64_t)header->num_source_files * sizeof(cooked_asset_source_file_t)
+    );
+    header->indices_offset = align_offset(
+            header->vertices_offset + (uint64_t)header->num_vertices * header->vertex_stride * sizeof(GLfloat)
+    );
+    header->mip_chain_offset = align_offset(
+            header->indices_offset + get_cooked_indices_size(header)
+    );
+    return header->mip_chain_offset + mip_chain_offsets[num_levels];
+}
+
+int open_cooked_asset(const char* source_path, vertex_format_t vertex_format, cooked_asset_t* asset_out) {
+    memset(asset_out, 0, sizeof(cooked_asset_t));
+    struct stat source_stat;
+    if(stat(source_path, &source_stat) != 0) {
+        return 0;
+    }
+    char path[4096];
+    get_cooked_asset_path(source_path, path, sizeof(path));
+    if(!map_file(path, &asset_out->file)) {
+        return 0;
+    }
+
+    cooked_asset_header_t* header = (cooked_asset_header_t*)asset_out->file.data;
+    int is_valid = asset_out->file.size >= sizeof(cooked_asset_header_t) && header->magic == COOKED_ASSET_MAGIC &&
+                   header->version == COOKED_ASSET_VERSION;
+    if(!is_valid) {
+        printf("Ignoring cooked asset %s as it's from a different version.\n", path);
+        close_cooked_asset(asset_out);
+        return 0;
+    }
+    if(header->source_size != source_stat.st_size || header->source_modified_time != source_stat.st_mtime) {
+        printf("Ignoring cooked asset %s as %s has changed since it was cooked.\n", path, source_path);
+        close_cooked_asset(asset_out);
+        return 0;
+    }
+    if(header->vertex_format != vertex_format) {
+        close_cooked_asset(asset_out);
+        return 0;
+    }
+
+    // The offsets are checked against the counts so a corrupt header can't point outside the file.
+    if(!are_cooked_lods_valid(header)) {
+        printf("Ignoring cooked asset %s as it's corrupt.\n", path);
+        close_cooked_asset(asset_out);
+        return 0;
+    }
+    cooked_asset_header_t expected_header = *header;
+    uint64_t expected_size = set_cooked_asset_offsets(&expected_header);
+    is_valid = header->vertex_stride == (uint32_t)get_vertex_stride(vertex_format) &&
+               (header->index_type == INDEX_TYPE_UINT16 || header->index_type == INDEX_TYPE_UINT32) &&
+               header->texture_width > 0 && header->texture_height > 0 && asset_out->file.size == expected_size &&
+               header->source_files_offset == expected_header.source_files_offset &&
+               header->vertices_offset == expected_header.vertices_offset &&
+               header->indices_offset == expected_header.indices_offset &&
+               header->mip_chain_offset == expected_header.mip_chain_offset;
+    if(!is_valid) {
+        printf("Ignoring cooked asset %s as it's corrupt.\n", path);
+        close_cooked_asset(asset_out);
+        return 0;
+    }
+
+    // Only once the header is known to be sound can the source files it lists be trusted to be inside the file.
+    cooked_asset_source_file_t* source_files =
+            (cooked_asset_source_file_t*)(asset_out->file.data + header->source_files_offset);
+    for(uint32_t i = 0; i < header->num_source_files; i++) {
+        if(memchr(source_files[i].uri, '\0', sizeof(source_files[i].uri)) == NULL) {
+            printf("Ignoring cooked asset %s as it's corrupt.\n", path);
+            close_cooked_asset(asset_out);
+            return 0;
+        }
+        char source_file_path[4096];
+        get_source_file_path(source_path, source_files[i].uri, source_file_path, sizeof(source_file_path));
+        struct stat source_file_stat;
+        if(stat(source_file_path, &source_file_stat) != 0 || source_files[i].size != source_file_stat.st_size ||
+           source_files[i].modified_time != source_file_stat.st_mtime) {
+            printf("Ignoring cooked asset %s as %s has changed since it was cooked.\n", path, source_file_path);
+            close_cooked_asset(asset_out);
+            return 0;
+        }
+    }
+
+    asset_out->header = header;
+    asset_out->vertices = (GLfloat*)(asset_out->file.data + header->vertices_offset);
+    asset_out->indices = asset_out->file.data + header->indices_offset;
+    asset_out->mip_chain = asset_out->file.data + header->mip_chain_offset;
+    return 1;
+}
+
+void close_cooked_asset(cooked_asset_t* asset) {
+    unmap_file(&asset->file);
+    memset(asset, 0, sizeof(cooked_asset_t));
+}
+
+// Write some bytes at an offset in the file, padding with zeros from wherever the last write ended.
+static int write_at(FILE* file, uint64_t offset, const void* data, size_t size) {
+    static const byte zeros[COOKED_ASSET_ALIGNMENT] = { 0 };
+    long position = ftell(file);
+    if(position < 0 || (uint64_t)position > offset || offset - position > COOKED_ASSET_ALIGNMENT) {
+        return 0;
+    }
+    size_t padding = offset - position;
+    return fwrite(zeros, 1, padding, file) == padding && fwrite(data, 1, size, file) == size;
+}
+
+void save_cooked_asset(
+        const char* source_path, char** source_uris, int num_source_uris, object_t* object, uint64_t mesh_hash,
+        uint64_t texture_hash, size_t texture_image_size, byte* mip_chain, int texture_width, int texture_height
+) {
+    struct stat source_stat;
+    if(stat(source_path, &source_stat) != 0) {
+        return;
+    }
+
+    cooked_asset_source_file_t* source_files = calloc(num_source_uris, sizeof(cooked_asset_source_file_t));
+    for(int i = 0; i < num_source_uris; i++) {
+        char source_file_path[4096];
+        get_source_file_path(source_path, source_uris[i], source_file_path, sizeof(source_file_path));
+        struct stat source_file_stat;
+        if(strlen(source_uris[i]) >= sizeof(source_files[i].uri) || stat(source_file_path, &source_file_stat) != 0) {
+            printf("Not cooking %s as %s can't be checked for changes.\n", source_path, source_file_path);
+            free(source_files);
+            return;
+        }
+        source_files[i].size = source_file_stat.st_size;
+        source_files[i].modified_time = source_file_stat.st_mtime;
+        strcpy(source_files[i].uri, source_uris[i]);
+    }
+
+    cooked_asset_header_t header = {
+        .magic = COOKED_ASSET_MAGIC,
+        .version = COOKED_ASSET_VERSION,
+        .source_size = source_stat.st_size,
+        .source_modified_time = source_stat.st_mtime,
+        .num_source_files = num_source_uris,
+        .vertex_format = object->vertex_format,
+        .vertex_stride = object->vertex_stride,
+        .num_vertices = object->num_vertices,
+        .num_indices = object->num_indices,
+        .index_type = object->index_type,
+        .texture_width = texture_width,
+        .texture_height = texture_height,
+        .mesh_hash = mesh_hash,
+        .texture_hash = texture_hash,
+        .texture_image_size = texture_image_size,
+        .num_lods = object->num_lods,
+    };
+    memcpy(header.lods, object->lods, sizeof(header.lods));
+    uint64_t size = set_cooked_asset_offsets(&header);
+
+    // Write to a temporary file first and move it into place, so a half written file is never picked up.
+    char path[4096];
+    char temporary_path[4096 + 8];
+    get_cooked_asset_path(source_path, path, sizeof(path));
+    snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path);
+    FILE* file = fopen(temporary_path, "wb");
+    if(file == NULL) {
+        printf("Failed to write cooked asset %s.\n", path);
+        free(source_files);
+        return;
+    }
+
+    int is_written =
+            write_at(file, 0, &header, sizeof(header)) &&
+            write_at(
+                    file, header.source_files_offset, source_files,
+                    num_source_uris * sizeof(cooked_asset_source_file_t)
+            ) &&
+            write_at(
+                    file, header.vertices_offset, object->vertices,
+                    (size_t)object->num_vertices * object->vertex_stride * sizeof(GLfloat)
+            ) &&
+            write_at(file, header.indices_offset, object->indices, get_object_indices_size(object)) &&
+            write_at(file, header.mip_chain_offset, mip_chain, size - header.mip_chain_offset);
+    is_written = fclose(file) == 0 && is_written;
+    free(source_files);
+    if(!is_written || rename(temporary_path, path) != 0) {
+        printf("Failed to write cooked asset %s.\n", path);
+        remove(temporary_path);
+        return;
+    }
+    printf("Cooked %s into %s, %llu bytes.\n", source_path, path, (unsigned long long)size);
+}
@@ -0,0 +1,101 @@
+#ifndef INC_3D_COOKED_ASSET_H
+#define INC_3D_COOKED_ASSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../mapped_file/mapped_file.h"
+#include "../object/object.h"
+
+/**
+ * Loading a glTF file means parsing its JSON, decoding base64 and PNGs, expanding every vertex and building mip
+ * chains, which all gives the same result every time. So the first time a model is loaded all of that is saved
+ * next to it as a cooked asset, "<model path>.cooked", in exactly the layout the loader ends up with. Later runs
+ * map the cooked asset and use it in place, falling back to the glTF file if it or any of the buffer or image files
+ * it refers to have changed since it was cooked.
+ *
+ * The file is a header followed by the external source files, the vertices, the indices and the RGBA8 texture mip
+ * chain, each starting on a COOKED_ASSET_ALIGNMENT boundary so the vertices are as aligned in the mapping as they
+ * are in the mesh arena.
+ */
+#define COOKED_ASSET_MAGIC 0x4B4F4F43 // "COOK"
+#define COOKED_ASSET_VERSION 6
+#define COOKED_ASSET_ALIGNMENT 64
+
+// Models whose buffer or image uris are longer than this aren't cooked.
+#define COOKED_ASSET_MAX_URI_LENGTH 240
+
+// A buffer or image file the glTF file refers to, with its size and modification time when it was cooked.
+typedef struct {
+    int64_t size;
+    int64_t modified_time;
+    // Relative to the glTF file's directory, and always null terminated.
+    char uri[COOKED_ASSET_MAX_URI_LENGTH];
+} cooked_asset_source_file_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+
+    /**
+     * The size and modification time of the glTF file when it was cooked, if either changes, or changes for any of
+     * the external source files, the cooked asset is stale.
+     */
+    int64_t source_size;
+    int64_t source_modified_time;
+    uint32_t num_source_files;
+
+    uint32_t vertex_format;
+    uint32_t vertex_stride;
+    uint32_t num_vertices;
+    uint32_t num_indices;
+    uint32_t index_type;
+    uint32_t texture_width;
+    uint32_t texture_height;
+
+    // The levels of detail are cooked too, their triangles are after the full detail ones in the indices.
+    uint32_t num_lods;
+    object_lod_t lods[MAX_OBJECT_LODS];
+
+    // What the resource cache keys the mesh and texture by, so cooked and glTF loads share the same entries.
+    uint64_t mesh_hash;
+    uint64_t texture_hash;
+    uint64_t texture_image_size;
+
+    uint64_t source_files_offset;
+    uint64_t vertices_offset;
+    uint64_t indices_offset;
+    uint64_t mip_chain_offset;
+} cooked_asset_header_t;
+
+typedef struct {
+    mapped_file_t file;
+    cooked_asset_header_t* header;
+
+    // These point into the mapping, so they're only valid until the cooked asset is closed.
+    GLfloat* vertices;
+    void* indices;
+    byte* mip_chain;
+} cooked_asset_t;
+
+/**
+ * Map the cooked asset for a glTF file. Returns 0 if there isn't one, or it's stale, from an older version, or was
+ * cooked with a different vertex format.
+ */
+int open_cooked_asset(const char* source_path, vertex_format_t vertex_format, cooked_asset_t* asset_out);
+void close_cooked_asset(cooked_asset_t* asset);
+
+// The number of bytes taken by the indices, including every level of detail's.
+uint64_t get_cooked_indices_size(cooked_asset_header_t* header);
+
+/**
+ * Save everything loaded from a glTF file as its cooked asset, along with the uris of the external files it was
+ * loaded from, see get_gltf_external_uris(). Failing to save, e.g. because the model's directory is read only, only
+ * prints a warning.
+ */
+void save_cooked_asset(
+        const char* source_path, char** source_uris, int num_source_uris, object_t* object, uint64_t mesh_hash,
+        uint64_t texture_hash, size_t texture_image_size, byte* mip_chain, int texture_width, int texture_height
+);
+
+#endif //INC_3D_COOKED_ASSET_H
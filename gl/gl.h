@@ -0,0 +1,30 @@
+#ifndef INC_3D_GL_H
+#define INC_3D_GL_H
+
+/**
+ * Include OpenGL through here rather than directly so the same code builds against the macOS OpenGL framework and
+ * against Mesa on Linux. macOS only has vertex array objects through the APPLE extension in legacy contexts, so the
+ * standard names are mapped onto those, and likewise for timer queries and instanced arrays.
+ */
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
+
+#define glGenVertexArrays glGenVertexArraysAPPLE
+#define glBindVertexArray glBindVertexArrayAPPLE
+#define glDeleteVertexArrays glDeleteVertexArraysAPPLE
+
+#define glDrawElementsInstanced glDrawElementsInstancedARB
+#define glVertexAttribDivisor glVertexAttribDivisorARB
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED GL_TIME_ELAPSED_EXT
+#define glGetQueryObjectui64v glGetQueryObjectui64vEXT
+#endif
+#else
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+#endif //INC_3D_GL_H
@@ -0,0 +1,461 @@
+#include "gl_render.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lod/lod.h"
+#include "../profiler/profiler.h"
+#include "../shaders.h"
+#include "../transform/transform.h"
+
+// Compile a shader, logging and exiting if the compilation failed.
+static GLuint compile_shader(GLenum type, const char* source, const char* description) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    int compile_success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_success);
+    if (!compile_success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        printf("ERROR COMPILING %s: %s\n", description, infoLog);
+        exit(1);
+    }
+    return shader;
+}
+
+// Attach the vertex and fragment shaders to a new shader program and link it, logging and exiting on failure.
+static GLuint link_shader_program(GLuint vertex_shader, GLuint fragment_shader) {
+    GLuint shader_program = glCreateProgram();
+    glAttachShader(shader_program, vertex_shader);
+    glAttachShader(shader_program, fragment_shader);
+    glLinkProgram(shader_program);
+
+    int linkStatus;
+    glGetProgramiv(shader_program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
+        char infoLog[512];
+        glGetProgramInfoLog(shader_program, 512, NULL, infoLog);
+        printf("LINKING ERROR: %s\n", infoLog);
+        exit(1);
+    }
+    return shader_program;
+}
+
+static void load_shader_programs(gl_render_t* renderer) {
+    renderer->vertex_shader = compile_shader(GL_VERTEX_SHADER, vertexShaderSource, "VERTEX SHADER");
+    renderer->instanced_vertex_shader = compile_shader(
+            GL_VERTEX_SHADER, instancedVertexShaderSource, "INSTANCED VERTEX SHADER"
+    );
+    renderer->fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragmentShaderSource, "FRAGMENT SHADER");
+
+    // Both programs colour pixels the same way so they share the fragment shader.
+    renderer->shader_program = link_shader_program(renderer->vertex_shader, renderer->fragment_shader);
+    renderer->instanced_shader_program = link_shader_program(
+            renderer->instanced_vertex_shader, renderer->fragment_shader
+    );
+}
+
+// Get the BC1 version of an RGBA8 mip chain, from the cache if it has been compressed before.
+static byte* get_bc1_mip_chain(
+        gl_render_t* renderer, byte* mip_chain, int width, int height, mapped_file_t* cache_file_out
+) {
+    // Every other level comes from the first, so that's all the hash needs to cover.
+    uint64_t hash = hash_texture(mip_chain, width, height);
+    byte* bc1_chain = load_cached_texture(renderer->texture_cache_directory, hash, width, height, cache_file_out);
+    if(bc1_chain == NULL) {
+        PROFILE_SCOPE("compress_texture");
+        size_t offsets[MAX_TEXTURE_LEVELS + 1];
+        int num_levels = get_mip_chain_offsets(TEXTURE_FORMAT_BC1, width, height, offsets);
+        bc1_chain = arena_alloc(renderer->scratch_arena, offsets[num_levels]);
+        compress_mip_chain_bc1(mip_chain, width, height, bc1_chain);
+        save_cached_texture(renderer->texture_cache_directory, hash, width, height, bc1_chain);
+    }
+    return bc1_chain;
+}
+
+// Upload one level of a mip chain to the bound texture.
+static void upload_texture_level(
+        texture_format_t format, byte* mip_chain, size_t level_offsets[], int level, int width, int height
+) {
+    int level_width = get_mip_level_size(width, level);
+    int level_height = get_mip_level_size(height, level);
+    byte* data = &mip_chain[level_offsets[level]];
+    if(format == TEXTURE_FORMAT_BC1) {
+        GLsizei size = (GLsizei)(level_offsets[level + 1] - level_offsets[level]);
+        glCompressedTexImage2D(
+                GL_TEXTURE_2D, level, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, level_width, level_height, 0, size, data
+        );
+    } else {
+        // Rows of RGBA8 are always 4 byte aligned so no unpacking is needed.
+        glTexImage2D(
+                GL_TEXTURE_2D, level, GL_RGBA8, level_width, level_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data
+        );
+    }
+}
+
+static GLuint gl_create_texture(render_backend_t* backend, byte* mip_chain, int width, int height) {
+    gl_render_t* renderer = backend->data;
+
+    GLuint texture_id;
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+
+    // Set wrapping properties(clamp just uses the edge pixel if we exceed the edge).
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Set the filtering properties for sampling, minified textures use the nearest pixel of the nearest level.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    texture_format_t format = TEXTURE_FORMAT_RGBA8;
+    byte* gpu_mip_chain = mip_chain;
+    mapped_file_t cache_file = { 0 };
+    if(renderer->texture_cache_directory != NULL) {
+        format = TEXTURE_FORMAT_BC1;
+        gpu_mip_chain = get_bc1_mip_chain(renderer, mip_chain, width, height, &cache_file);
+    }
+    size_t offsets[MAX_TEXTURE_LEVELS + 1];
+    int num_levels = get_mip_chain_offsets(format, width, height, offsets);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+
+    // Upload the smallest levels now and leave the bigger ones to be streamed in over the next frames.
+    int base_level = num_levels;
+    {
+        PROFILE_SCOPE("upload_texture");
+        do {
+            base_level--;
+            upload_texture_level(format, gpu_mip_chain, offsets, base_level, width, height);
+        } while(base_level > 0 && offsets[base_level] - offsets[base_level - 1] <= TEXTURE_STREAM_INITIAL_BYTES);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base_level);
+
+    if(base_level > 0) {
+        renderer->texture_streams = realloc(
+                renderer->texture_streams, (renderer->num_texture_streams + 1) * sizeof(gl_texture_stream_t)
+        );
+        gl_texture_stream_t* stream = &renderer->texture_streams[renderer->num_texture_streams++];
+        stream->texture_id = texture_id;
+        stream->width = width;
+        stream->height = height;
+        stream->format = format;
+        stream->mip_chain = malloc(offsets[base_level]);
+        memcpy(stream->mip_chain, gpu_mip_chain, offsets[base_level]);
+        memcpy(stream->level_offsets, offsets, sizeof(offsets));
+        stream->base_level = base_level;
+    }
+    if(cache_file.data != NULL) {
+        unmap_file(&cache_file);
+    }
+
+    // Textures used to be uploaded as a float per channel without mips, which is what the savings are measured against.
+    size_t gpu_size = offsets[num_levels];
+    size_t float_size = (size_t)width * height * 4 * sizeof(GLfloat);
+    printf(
+            "Texture %u is %dx%d with %d levels, %zu bytes as %s instead of %zu as floats (%.1fx smaller), "
+            "%d levels left to stream.\n", texture_id, width, height, num_levels, gpu_size,
+            format == TEXTURE_FORMAT_BC1 ? "BC1" : "RGBA8", float_size, (double)float_size / gpu_size, base_level
+    );
+
+    // Unbind the texture.
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture_id;
+}
+
+static void gl_destroy_texture(render_backend_t* backend, GLuint texture_id) {
+    gl_render_t* renderer = backend->data;
+
+    // Anything still waiting to be streamed in isn't needed any more.
+    for(int i = 0; i < renderer->num_texture_streams; i++) {
+        if(renderer->texture_streams[i].texture_id == texture_id) {
+            free(renderer->texture_streams[i].mip_chain);
+            renderer->texture_streams[i] = renderer->texture_streams[--renderer->num_texture_streams];
+            break;
+        }
+    }
+    glDeleteTextures(1, &texture_id);
+}
+
+/**
+ * Upload the waiting texture levels that fit in this frame's budget, smallest first so every texture sharpens at
+ * about the same rate. Each texture samples from its biggest uploaded level until the rest arrive.
+ */
+static void stream_texture_levels(gl_render_t* renderer) {
+    if(renderer->num_texture_streams == 0) {
+        return;
+    }
+    PROFILE_SCOPE("stream_textures");
+
+    size_t uploaded_size = 0;
+    while(renderer->num_texture_streams > 0) {
+        int stream_idx = 0;
+        size_t level_size = 0;
+        for(int i = 0; i < renderer->num_texture_streams; i++) {
+            gl_texture_stream_t* stream = &renderer->texture_streams[i];
+            size_t size = stream->level_offsets[stream->base_level] - stream->level_offsets[stream->base_level - 1];
+            if(i == 0 || size < level_size) {
+                stream_idx = i;
+                level_size = size;
+            }
+        }
+        if(uploaded_size > 0 && uploaded_size + level_size > TEXTURE_STREAM_BYTES_PER_FRAME) {
+            break;
+        }
+
+        gl_texture_stream_t* stream = &renderer->texture_streams[stream_idx];
+        stream->base_level--;
+        glBindTexture(GL_TEXTURE_2D, stream->texture_id);
+        upload_texture_level(
+                stream->format, stream->mip_chain, stream->level_offsets, stream->base_level, stream->width,
+                stream->height
+        );
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, stream->base_level);
+        uploaded_size += level_size;
+
+        if(stream->base_level == 0) {
+            free(stream->mip_chain);
+            *stream = renderer->texture_streams[--renderer->num_texture_streams];
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if(renderer->num_texture_streams == 0) {
+        printf("Every texture level has been uploaded.\n");
+    }
+}
+
+static void free_instanced_meshes(gl_render_t* renderer) {
+    for(int i = 0; i < renderer->num_instanced_meshes; i++) {
+        free_instanced_mesh(&renderer->instanced_meshes[i]);
+    }
+    free(renderer->instanced_meshes);
+    renderer->instanced_meshes = NULL;
+    renderer->num_instanced_meshes = 0;
+}
+
+static void gl_set_scene(render_backend_t* backend, object_t** objects, int num_objects) {
+    gl_render_t* renderer = backend->data;
+
+    if(renderer->batch.objects != NULL) {
+        free_batch(&renderer->batch);
+    }
+    free_instanced_meshes(renderer);
+
+    // Instanced objects already share one draw call between all of their copies, so they're kept out of the batch.
+    object_t** ordinary_objects = malloc(num_objects * sizeof(object_t*));
+    int num_ordinary_objects = 0;
+    renderer->instanced_meshes = malloc(num_objects * sizeof(instanced_mesh_t));
+    for(int i = 0; i < num_objects; i++) {
+        if(objects[i]->instance_matrices != NULL) {
+            build_instanced_mesh(
+                    &renderer->instanced_meshes[renderer->num_instanced_meshes++], objects[i],
+                    renderer->is_quantizing_vertices
+            );
+        } else {
+            ordinary_objects[num_ordinary_objects++] = objects[i];
+        }
+    }
+
+    // Pack every other object into shared GPU buffers up front so each frame only needs a draw call per texture.
+    build_batch(&renderer->batch, ordinary_objects, num_ordinary_objects, renderer->is_quantizing_vertices);
+
+    // The batch sorts its objects, so the hierarchy is built over them in the batch's order.
+    memcpy(ordinary_objects, renderer->batch.objects, num_ordinary_objects * sizeof(object_t*));
+    for(int i = 0; i < renderer->num_instanced_meshes; i++) {
+        ordinary_objects[num_ordinary_objects + i] = renderer->instanced_meshes[i].object;
+    }
+    free_bvh(&renderer->bvh);
+    build_bvh(&renderer->bvh, ordinary_objects, num_objects);
+    free(ordinary_objects);
+
+    free(renderer->instance_lods);
+    renderer->instance_lods = calloc(renderer->bvh.num_instances, 1);
+}
+
+static void gl_draw_frame(render_backend_t* backend) {
+    gl_render_t* renderer = backend->data;
+    PROFILE_SCOPE("gl_draw_frame");
+
+    stream_texture_levels(renderer);
+
+    // Instances entirely outside the view aren't drawn, and draws with none in view don't upload their matrices.
+    refit_bvh(&renderer->bvh);
+    backend->num_drawn_objects = cull_bvh(&renderer->bvh, &renderer->frustum);
+    backend->num_culled_objects = renderer->bvh.num_instances - backend->num_drawn_objects;
+    // Instances that only cover a few pixels are drawn with fewer triangles, so far away ones cost much less.
+    backend->num_drawn_triangles = select_lods(&renderer->bvh, backend->height, renderer->instance_lods);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // The last frame may have left the instanced program in use.
+    glUseProgram(renderer->shader_program);
+    glBindVertexArray(renderer->vertex_array_object);
+
+    // Set the texture sampler for the shader. Because we're using GL_TEXTURE0 we set this to 0.
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(renderer->texture_sampler_uniform, 0);
+
+    draw_batch(
+            &renderer->batch, renderer->bvh.is_visible, renderer->instance_lods, renderer->position_attribute,
+            renderer->texture_uv_attribute, renderer->object_index_attribute, renderer->model_matrices_uniform
+    );
+
+    if(renderer->num_instanced_meshes == 0) {
+        return;
+    }
+    glUseProgram(renderer->instanced_shader_program);
+    glBindVertexArray(renderer->instanced_vertex_array_object);
+    glUniform1i(renderer->instanced_texture_sampler_uniform, 0);
+    for(int i = 0; i < renderer->num_instanced_meshes; i++) {
+        int first_instance = renderer->bvh.object_first_instances[renderer->batch.num_objects + i];
+        draw_instanced_mesh(
+                &renderer->instanced_meshes[i], &renderer->bvh.is_visible[first_instance],
+                &renderer->instance_lods[first_instance], &renderer->instanced_attributes,
+                renderer->has_instanced_arrays
+        );
+    }
+}
+
+static void gl_read_pixels(render_backend_t* backend, byte* pixels_out) {
+    PROFILE_SCOPE("gl_read_pixels");
+    glFinish();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, backend->width, backend->height, GL_RGBA, GL_UNSIGNED_BYTE, pixels_out);
+
+    // OpenGL's first row is the bottom of the frame, so swap the rows around to start at the top.
+    int row_size = backend->width * 4;
+    byte* row = malloc(row_size);
+    for(int y = 0; y < backend->height / 2; y++) {
+        byte* top_row = &pixels_out[y * row_size];
+        byte* bottom_row = &pixels_out[(backend->height - 1 - y) * row_size];
+        memcpy(row, top_row, row_size);
+        memcpy(top_row, bottom_row, row_size);
+        memcpy(bottom_row, row, row_size);
+    }
+    free(row);
+}
+
+static void gl_destroy(render_backend_t* backend) {
+    gl_render_t* renderer = backend->data;
+
+    if(renderer->batch.objects != NULL) {
+        free_batch(&renderer->batch);
+    }
+    free_instanced_meshes(renderer);
+    free_bvh(&renderer->bvh);
+    free(renderer->instance_lods);
+    for(int i = 0; i < renderer->num_texture_streams; i++) {
+        free(renderer->texture_streams[i].mip_chain);
+    }
+    free(renderer->texture_streams);
+    destroy_profiler_gpu_timers();
+    glDeleteVertexArrays(1, &renderer->vertex_array_object);
+    glDeleteVertexArrays(1, &renderer->instanced_vertex_array_object);
+    glDeleteProgram(renderer->shader_program);
+    glDeleteProgram(renderer->instanced_shader_program);
+    glDeleteShader(renderer->vertex_shader);
+    glDeleteShader(renderer->instanced_vertex_shader);
+    glDeleteShader(renderer->fragment_shader);
+
+    free(renderer);
+    backend->data = NULL;
+}
+
+void create_gl_backend(render_backend_t* backend, int width, int height, arena_t* scratch_arena) {
+    gl_render_t* renderer = calloc(1, sizeof(gl_render_t));
+    renderer->scratch_arena = scratch_arena;
+
+    backend->name = "gl";
+    backend->width = width;
+    backend->height = height;
+    backend->data = renderer;
+    backend->create_texture = gl_create_texture;
+    backend->destroy_texture = gl_destroy_texture;
+    backend->set_scene = gl_set_scene;
+    backend->draw_frame = gl_draw_frame;
+    backend->read_pixels = gl_read_pixels;
+    backend->destroy = gl_destroy;
+
+    // Model matrices take vertices straight to clip space, so the frustum is the clip volume itself.
+    float view_projection[4][4];
+    get_identity_matrix(view_projection);
+    get_frustum(view_projection, &renderer->frustum);
+
+    const char* version = (const char*)glGetString(GL_VERSION);
+    printf("OpenGL version supported by your graphics card: %s\n", version);
+
+    // This enables z-buffering so pixels are occluded based on depth.
+    glEnable(GL_DEPTH_TEST);
+
+    // Enable backface culling and set the winding order to counter clockwise.
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glFrontFace(GL_CCW);
+
+    // BC1 is S3TC's DXT1, which every desktop GPU supports but isn't core OpenGL because of patents that have expired.
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    renderer->has_bc1_textures = extensions != NULL && strstr(extensions, "GL_EXT_texture_compression_s3tc") != NULL;
+    // Instanced arrays are core since OpenGL 3.3, but OpenGL 2 contexts only have them through the ARB extension.
+    renderer->has_instanced_arrays = extensions != NULL && strstr(extensions, "GL_ARB_instanced_arrays") != NULL;
+
+    init_profiler_gpu_timers();
+    load_shader_programs(renderer);
+    glUseProgram(renderer->shader_program);
+
+    // Create a vertex array object that we can use for assigning the vertex attribute arrays.
+    glGenVertexArrays(1, &renderer->vertex_array_object);
+    glBindVertexArray(renderer->vertex_array_object);
+
+    // Find where the shader expects the vertex data and transforms so the batch can point them at its buffers.
+    renderer->position_attribute = glGetAttribLocation(renderer->shader_program, "aPos");
+    glEnableVertexAttribArray(renderer->position_attribute);
+    renderer->texture_uv_attribute = glGetAttribLocation(renderer->shader_program, "aTexCoord");
+    glEnableVertexAttribArray(renderer->texture_uv_attribute);
+    renderer->object_index_attribute = glGetAttribLocation(renderer->shader_program, "aObjectIndex");
+    glEnableVertexAttribArray(renderer->object_index_attribute);
+    renderer->model_matrices_uniform = glGetUniformLocation(renderer->shader_program, "modelMatrices");
+    renderer->texture_sampler_uniform = glGetUniformLocation(renderer->shader_program, "textureSampler");
+
+    // The instanced program has different attributes enabled so it gets a vertex array object of its own.
+    glGenVertexArrays(1, &renderer->instanced_vertex_array_object);
+    glBindVertexArray(renderer->instanced_vertex_array_object);
+    GLuint program = renderer->instanced_shader_program;
+    instanced_attributes_t* attributes = &renderer->instanced_attributes;
+    attributes->position_attribute = glGetAttribLocation(program, "aPos");
+    glEnableVertexAttribArray(attributes->position_attribute);
+    attributes->texture_uv_attribute = glGetAttribLocation(program, "aTexCoord");
+    glEnableVertexAttribArray(attributes->texture_uv_attribute);
+    const char* row_names[4] = { "aModelRow0", "aModelRow1", "aModelRow2", "aModelRow3" };
+    for(int row = 0; row < 4; row++) {
+        attributes->model_row_attributes[row] = glGetAttribLocation(program, row_names[row]);
+        // Without instanced arrays the rows are left as constant attributes that are set before each draw.
+        if(renderer->has_instanced_arrays) {
+            glEnableVertexAttribArray(attributes->model_row_attributes[row]);
+            glVertexAttribDivisor(attributes->model_row_attributes[row], 1);
+        }
+    }
+    renderer->instanced_texture_sampler_uniform = glGetUniformLocation(program, "textureSampler");
+    if(!renderer->has_instanced_arrays) {
+        printf("Instanced arrays aren't supported, each instance will be drawn separately.\n");
+    }
+
+    glBindVertexArray(renderer->vertex_array_object);
+}
+
+int enable_gl_texture_compression(render_backend_t* backend, const char* cache_directory) {
+    gl_render_t* renderer = backend->data;
+    if(!renderer->has_bc1_textures) {
+        printf("BC1 textures aren't supported, textures will be uploaded as RGBA8.\n");
+        return 0;
+    }
+    renderer->texture_cache_directory = cache_directory;
+    return 1;
+}
+
+void enable_gl_vertex_quantization(render_backend_t* backend) {
+    gl_render_t* renderer = backend->data;
+    renderer->is_quantizing_vertices = 1;
+}
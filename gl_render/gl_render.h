@@ -0,0 +1,105 @@
+#ifndef INC_3D_GL_RENDER_H
+#define INC_3D_GL_RENDER_H
+
+#include "../arena/arena.h"
+#include "../batch/batch.h"
+#include "../bvh/bvh.h"
+#include "../instancing/instancing.h"
+#include "../render/render.h"
+#include "../texture/texture.h"
+
+/**
+ * Textures start out with only their smallest levels uploaded, up to the first level bigger than this, so the first
+ * frame isn't held up uploading every texture in full.
+ */
+#define TEXTURE_STREAM_INITIAL_BYTES (64 * 1024)
+
+/**
+ * The rest of the levels are uploaded over the following frames, the smallest waiting level of any texture first,
+ * until this many bytes have been uploaded in a frame. At least one level is uploaded each frame however big it is.
+ */
+#define TEXTURE_STREAM_BYTES_PER_FRAME (4 * 1024 * 1024)
+
+// A texture that still has bigger levels waiting to be uploaded.
+typedef struct {
+    GLuint texture_id;
+    int width;
+    int height;
+    texture_format_t format;
+    // A copy of the levels that haven't been uploaded yet, which are all the ones before base_level.
+    byte* mip_chain;
+    size_t level_offsets[MAX_TEXTURE_LEVELS + 1];
+    // The biggest level uploaded so far, OpenGL samples from here until the next one is uploaded.
+    int base_level;
+} gl_texture_stream_t;
+
+typedef struct {
+    // Textures are compressed into here before uploading, which only needs to last until they're uploaded.
+    arena_t* scratch_arena;
+
+    // Set once BC1 compression is enabled, where compressed textures are kept between runs.
+    const char* texture_cache_directory;
+    int has_bc1_textures;
+
+    // Set once vertex quantization is enabled, scenes set after that upload quantized_vertex_t.
+    int is_quantizing_vertices;
+
+    gl_texture_stream_t* texture_streams;
+    int num_texture_streams;
+
+    GLuint shader_program;
+    GLuint vertex_shader;
+    GLuint fragment_shader;
+
+    GLuint vertex_array_object;
+    GLint position_attribute;
+    GLint texture_uv_attribute;
+    GLint object_index_attribute;
+    GLint model_matrices_uniform;
+    GLint texture_sampler_uniform;
+
+    // Instanced objects have a program of their own, which takes each instance's model matrix as attributes.
+    GLuint instanced_shader_program;
+    GLuint instanced_vertex_shader;
+    GLuint instanced_vertex_array_object;
+    instanced_attributes_t instanced_attributes;
+    GLint instanced_texture_sampler_uniform;
+    // Without instanced arrays every instance gets a draw call of its own.
+    int has_instanced_arrays;
+
+    // Every ordinary object, instanced objects are kept out of the batch and drawn by their own instanced meshes.
+    batch_t batch;
+    instanced_mesh_t* instanced_meshes;
+    int num_instanced_meshes;
+
+    /**
+     * Over the batch's objects in the same order followed by the instanced objects, so the start of its visibility can
+     * be handed straight to the batch and each instanced mesh's run of instances straight to it.
+     */
+    bvh_t bvh;
+    frustum_t frustum;
+    // The level of detail each visible instance is drawn at, in the same order again.
+    byte* instance_lods;
+} gl_render_t;
+
+/**
+ * Draw with OpenGL into whatever framebuffer is bound. There needs to be a current OpenGL context, from a window or
+ * a headless context, before this is called.
+ */
+void create_gl_backend(render_backend_t* backend, int width, int height, arena_t* scratch_arena);
+
+/**
+ * Compress textures to BC1 before uploading them, which takes an eighth of the memory of RGBA8 at some cost in
+ * quality. Compressed textures are saved in cache_directory so each one is only compressed once. Returns 0 and keeps
+ * uploading RGBA8 if the driver doesn't support BC1.
+ */
+int enable_gl_texture_compression(render_backend_t* backend, const char* cache_directory);
+
+/**
+ * Upload positions and UVs as 16 bit integers, 12 bytes a vertex instead of 32, for every scene set from now on.
+ * Positions are quantized across each objects bounding box, so the error grows with the size of the object, and
+ * anything else in the vertices, like normals, is left out.
+ */
+void enable_gl_vertex_quantization(render_backend_t* backend);
+
+#endif //INC_3D_GL_RENDER_H
@@ -0,0 +1,757 @@
+#include "gltf.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../base64/base64.h"
+#include "../transform/transform.h"
+
+typedef struct {
+    // The first element, or NULL if the accessor has no buffer view and should be read as zeros.
+    byte* data;
+    int count;
+    int component_type;
+    int num_components;
+    int is_normalized;
+    // Bytes from the start of one element to the next.
+    size_t stride;
+} accessor_view_t;
+
+static int get_int(cJSON* object, const char* name, int default_value) {
+    cJSON* item = cJSON_GetObjectItem(object, name);
+    return cJSON_IsNumber(item) ? (int)cJSON_GetNumberValue(item) : default_value;
+}
+
+static cJSON* get_indexed_item(gltf_t* gltf, const char* array_name, int idx) {
+    cJSON* item = cJSON_GetArrayItem(cJSON_GetObjectItem(gltf->json, array_name), idx);
+    if(item == NULL) {
+        printf("Model file refers to %s[%d] which doesn't exist.\n", array_name, idx);
+        exit(-1);
+    }
+    return item;
+}
+
+static int get_num_components(const char* type) {
+    if(type == NULL)                 return 0;
+    if(strcmp(type, "SCALAR") == 0)  return 1;
+    if(strcmp(type, "VEC2") == 0)    return 2;
+    if(strcmp(type, "VEC3") == 0)    return 3;
+    if(strcmp(type, "VEC4") == 0)    return 4;
+    if(strcmp(type, "MAT2") == 0)    return 4;
+    if(strcmp(type, "MAT3") == 0)    return 9;
+    if(strcmp(type, "MAT4") == 0)    return 16;
+    return 0;
+}
+
+static int get_component_size(int component_type) {
+    switch(component_type) {
+        case GLTF_BYTE:
+        case GLTF_UNSIGNED_BYTE:
+            return 1;
+        case GLTF_SHORT:
+        case GLTF_UNSIGNED_SHORT:
+            return 2;
+        case GLTF_UNSIGNED_INT:
+        case GLTF_FLOAT:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Decode a URI of the form "data:[<mime type>];base64,<data>". If the decoded size is known up front(buffers have a
+ * byteLength) it is decoded straight into a buffer of that size, otherwise into one big enough for the worst case.
+ */
+static byte* decode_data_uri(char* uri, size_t expected_size, size_t* size_out) {
+    char* data_start = strchr(uri, ',');
+    if(strncmp(uri, "data:", 5) != 0 || data_start == NULL) {
+        printf("Only embedded data URIs are supported, got \"%.64s\".\n", uri);
+        exit(-1);
+    }
+    if(data_start - uri < 7 || strncmp(data_start - 7, ";base64", 7) != 0) {
+        printf("Only base64 data URIs are supported.\n");
+        exit(-1);
+    }
+
+    data_start++;
+    byte* data;
+    if(expected_size > 0) {
+        data = malloc(expected_size);
+        if(base64_decode_into((byte*)data_start, strlen(data_start), data, expected_size, size_out) < 0) {
+            free(data);
+            data = NULL;
+        }
+    } else {
+        data = base64_decode((byte*)data_start, strlen(data_start), size_out);
+    }
+    if(data == NULL) {
+        printf("Failed to parse model's base64 data.\n");
+        exit(-1);
+    }
+    return data;
+}
+
+/**
+ * Load the data a buffer or image uri refers to, either by decoding it if it's a data URI or by mapping the file
+ * it names relative to the model file.
+ */
+static byte* load_uri(
+        gltf_t* gltf, char* uri, size_t expected_size, size_t* size_out, mapped_file_t* mapped_file_out
+) {
+    if(strncmp(uri, "data:", 5) == 0) {
+        return decode_data_uri(uri, expected_size, size_out);
+    }
+
+    size_t path_length = strlen(gltf->directory) + strlen(uri) + 1;
+    char* path = malloc(path_length);
+    snprintf(path, path_length, "%s%s", gltf->directory, uri);
+    if(!map_file(path, mapped_file_out)) {
+        printf("Failed to open %s referenced by the model file.\n", path);
+        exit(-1);
+    }
+    free(path);
+
+    *size_out = mapped_file_out->size;
+    return mapped_file_out->data;
+}
+
+static byte* get_buffer(gltf_t* gltf, int buffer_idx, size_t* size_out) {
+    if(buffer_idx < 0 || buffer_idx >= gltf->num_buffers) {
+        printf("Model file refers to buffers[%d] which doesn't exist.\n", buffer_idx);
+        exit(-1);
+    }
+
+    if(gltf->buffer_data[buffer_idx] == NULL) {
+        cJSON* buffer = get_indexed_item(gltf, "buffers", buffer_idx);
+        char* uri = cJSON_GetStringValue(cJSON_GetObjectItem(buffer, "uri"));
+        size_t expected_size = get_int(buffer, "byteLength", 0);
+        if(uri != NULL) {
+            gltf->buffer_data[buffer_idx] = load_uri(
+                    gltf, uri, expected_size, &gltf->buffer_sizes[buffer_idx], &gltf->buffer_files[buffer_idx]
+            );
+        } else if(buffer_idx == 0 && gltf->binary_chunk != NULL) {
+            gltf->buffer_data[buffer_idx] = gltf->binary_chunk;
+            gltf->buffer_sizes[buffer_idx] = gltf->binary_chunk_size;
+        } else {
+            printf("Buffer %d has no uri.\n", buffer_idx);
+            exit(-1);
+        }
+
+        if(gltf->buffer_sizes[buffer_idx] < expected_size) {
+            printf(
+                    "Buffer %d is %zu bytes but should be %zu bytes.\n",
+                    buffer_idx, gltf->buffer_sizes[buffer_idx], expected_size
+            );
+            exit(-1);
+        }
+    }
+
+    *size_out = gltf->buffer_sizes[buffer_idx];
+    return gltf->buffer_data[buffer_idx];
+}
+
+/**
+ * Work out where an accessors data lives so that it can be read straight out of the decoded buffer.
+ */
+static accessor_view_t get_accessor_view(gltf_t* gltf, int accessor_idx) {
+    cJSON* accessor = get_indexed_item(gltf, "accessors", accessor_idx);
+
+    accessor_view_t view = {
+        .data           = NULL,
+        .count          = get_int(accessor, "count", 0),
+        .component_type = get_int(accessor, "componentType", 0),
+        .num_components = get_num_components(cJSON_GetStringValue(cJSON_GetObjectItem(accessor, "type"))),
+        .is_normalized  = cJSON_IsTrue(cJSON_GetObjectItem(accessor, "normalized")),
+    };
+
+    int component_size = get_component_size(view.component_type);
+    if(component_size == 0 || view.num_components == 0) {
+        printf("Accessor %d has an unsupported component type or element type.\n", accessor_idx);
+        exit(-1);
+    }
+    if(cJSON_GetObjectItem(accessor, "sparse") != NULL) {
+        printf("Accessor %d is sparse, which isn't supported.\n", accessor_idx);
+        exit(-1);
+    }
+
+    size_t element_size = component_size * view.num_components;
+    view.stride = element_size;
+
+    int buffer_view_idx = get_int(accessor, "bufferView", -1);
+    if(buffer_view_idx == -1) {
+        // Accessors without a buffer view are all zeros.
+        return view;
+    }
+
+    cJSON* buffer_view = get_indexed_item(gltf, "bufferViews", buffer_view_idx);
+    size_t buffer_size;
+    byte* buffer = get_buffer(gltf, get_int(buffer_view, "buffer", 0), &buffer_size);
+
+    size_t byte_stride = get_int(buffer_view, "byteStride", 0);
+    if(byte_stride != 0) {
+        view.stride = byte_stride;
+    }
+
+    size_t offset = (size_t)get_int(buffer_view, "byteOffset", 0) + get_int(accessor, "byteOffset", 0);
+    size_t end = view.count > 0 ? offset + view.stride * (view.count - 1) + element_size : offset;
+    if(end > buffer_size) {
+        printf("Accessor %d reads past the end of its buffer(%zu > %zu).\n", accessor_idx, end, buffer_size);
+        exit(-1);
+    }
+
+    view.data = buffer + offset;
+    return view;
+}
+
+static float read_component(byte* pointer, int component_type, int is_normalized) {
+    switch(component_type) {
+        case GLTF_FLOAT: {
+            float value;
+            memcpy(&value, pointer, sizeof(value));
+            return value;
+        }
+        case GLTF_UNSIGNED_BYTE: {
+            uint8_t value = *pointer;
+            return is_normalized ? value / 255.0f : value;
+        }
+        case GLTF_BYTE: {
+            int8_t value = *(int8_t*)pointer;
+            return is_normalized ? fmaxf(value / 127.0f, -1.0f) : value;
+        }
+        case GLTF_UNSIGNED_SHORT: {
+            uint16_t value;
+            memcpy(&value, pointer, sizeof(value));
+            return is_normalized ? value / 65535.0f : value;
+        }
+        case GLTF_SHORT: {
+            int16_t value;
+            memcpy(&value, pointer, sizeof(value));
+            return is_normalized ? fmaxf(value / 32767.0f, -1.0f) : value;
+        }
+        case GLTF_UNSIGNED_INT: {
+            uint32_t value;
+            memcpy(&value, pointer, sizeof(value));
+            return (float)value;
+        }
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Convert num_components values from each element of the accessor into floats, writing each element output_stride
+ * floats apart so that they can go straight into interleaved vertices. Missing components are filled with zeros.
+ */
+static void read_accessor_floats(accessor_view_t* view, int num_components, float* output, int output_stride) {
+    int component_size = get_component_size(view->component_type);
+
+    for(int element_idx = 0; element_idx < view->count; element_idx++) {
+        float* output_element = &output[element_idx * output_stride];
+        if(view->data == NULL) {
+            memset(output_element, 0, num_components * sizeof(float));
+            continue;
+        }
+
+        byte* element = view->data + element_idx * view->stride;
+        if(view->component_type == GLTF_FLOAT && view->num_components >= num_components) {
+            memcpy(output_element, element, num_components * sizeof(float));
+            continue;
+        }
+        for(int component_idx = 0; component_idx < num_components; component_idx++) {
+            output_element[component_idx] = component_idx < view->num_components
+                    ? read_component(element + component_idx * component_size, view->component_type, view->is_normalized)
+                    : 0.0f;
+        }
+    }
+}
+
+/**
+ * Read a primitives indices into the model, offset by where the primitives vertices start. Indices are checked
+ * before they're stored, as one past the end could otherwise wrap around into range when stored as 16 bit.
+ */
+static void read_accessor_indices(
+        accessor_view_t* view, GLuint base_vertex, int num_vertices, object_t* model, int first_index
+) {
+    for(int index_idx = 0; index_idx < view->count; index_idx++) {
+        // An accessor without a bufferView is all zeros.
+        GLuint index = 0;
+        if(view->data != NULL) {
+            byte* element = view->data + index_idx * view->stride;
+            switch(view->component_type) {
+                case GLTF_UNSIGNED_BYTE: {
+                    index = *element;
+                    break;
+                }
+                case GLTF_UNSIGNED_SHORT: {
+                    uint16_t value;
+                    memcpy(&value, element, sizeof(value));
+                    index = value;
+                    break;
+                }
+                case GLTF_UNSIGNED_INT: {
+                    uint32_t value;
+                    memcpy(&value, element, sizeof(value));
+                    index = value;
+                    break;
+                }
+                default:
+                    printf("Indices must be unsigned bytes, shorts or ints.\n");
+                    exit(-1);
+            }
+        }
+        if(index >= (GLuint)num_vertices) {
+            printf("Primitive has an index past the end of its vertices.\n");
+            exit(-1);
+        }
+        set_object_index(model, first_index + index_idx, base_vertex + index);
+    }
+}
+
+static uint32_t read_uint32(byte* pointer) {
+    uint32_t value;
+    memcpy(&value, pointer, sizeof(value));
+    return value;
+}
+
+/**
+ * A .glb file is a 12 byte header followed by chunks that are each an 8 byte header(length and type) and then
+ * their data. The first chunk is always the JSON and the optional second chunk holds the binary buffer.
+ */
+static void find_glb_chunks(gltf_t* gltf, byte** json_out, size_t* json_size_out) {
+    byte* data = gltf->file.data;
+    size_t size = gltf->file.size;
+
+    uint32_t version = read_uint32(data + 4);
+    uint32_t length = read_uint32(data + 8);
+    if(version != 2 || length > size) {
+        printf("Unsupported or truncated .glb file(version %u, %u bytes of %zu).\n", version, length, size);
+        exit(-1);
+    }
+
+    *json_out = NULL;
+    size_t offset = 12;
+    while(offset + 8 <= length) {
+        uint32_t chunk_length = read_uint32(data + offset);
+        uint32_t chunk_type = read_uint32(data + offset + 4);
+        byte* chunk_data = data + offset + 8;
+        if(chunk_length > length - offset - 8) {
+            printf("A .glb chunk runs past the end of the file.\n");
+            exit(-1);
+        }
+
+        if(chunk_type == GLB_CHUNK_TYPE_JSON && *json_out == NULL) {
+            *json_out = chunk_data;
+            *json_size_out = chunk_length;
+        } else if(chunk_type == GLB_CHUNK_TYPE_BIN && gltf->binary_chunk == NULL) {
+            gltf->binary_chunk = chunk_data;
+            gltf->binary_chunk_size = chunk_length;
+        }
+        // Unknown chunk types are meant to be skipped. Chunks are padded to 4 bytes.
+        offset += 8 + ((chunk_length + 3) & ~3u);
+    }
+
+    if(*json_out == NULL) {
+        printf("The .glb file has no JSON chunk.\n");
+        exit(-1);
+    }
+}
+
+void open_gltf(char* file_path, gltf_t* gltf) {
+    memset(gltf, 0, sizeof(gltf_t));
+
+    if(!map_file(file_path, &gltf->file)) {
+        printf("Failed to open model file %s.\n", file_path);
+        exit(-1);
+    }
+
+    // Keep everything up to and including the last slash so relative URIs can be appended straight on.
+    char* last_slash = strrchr(file_path, '/');
+    size_t directory_length = last_slash != NULL ? last_slash - file_path + 1 : 0;
+    gltf->directory = malloc(directory_length + 1);
+    memcpy(gltf->directory, file_path, directory_length);
+    gltf->directory[directory_length] = '\0';
+
+    byte* json_data = gltf->file.data;
+    size_t json_size = gltf->file.size;
+    if(gltf->file.size >= 12 && read_uint32(gltf->file.data) == GLB_MAGIC) {
+        find_glb_chunks(gltf, &json_data, &json_size);
+    }
+
+    gltf->json = cJSON_ParseWithLength((char*)json_data, json_size);
+    if(!gltf->json) {
+        const char* error_str = cJSON_GetErrorPtr();
+        if(error_str != NULL) {
+            printf("Failed to parse model file: %s\n", error_str);
+        }
+        exit(-1);
+    }
+
+    gltf->num_buffers = cJSON_GetArraySize(cJSON_GetObjectItem(gltf->json, "buffers"));
+    gltf->buffer_data = calloc(gltf->num_buffers, sizeof(byte*));
+    gltf->buffer_sizes = calloc(gltf->num_buffers, sizeof(size_t));
+    gltf->buffer_files = calloc(gltf->num_buffers, sizeof(mapped_file_t));
+
+    gltf->num_images = cJSON_GetArraySize(cJSON_GetObjectItem(gltf->json, "images"));
+    gltf->image_data = calloc(gltf->num_images, sizeof(byte*));
+    gltf->image_sizes = calloc(gltf->num_images, sizeof(size_t));
+    gltf->image_files = calloc(gltf->num_images, sizeof(mapped_file_t));
+}
+
+void close_gltf(gltf_t* gltf) {
+    // Anything that wasn't mapped and isn't part of the .glb file was decoded from a data URI.
+    for(int i = 0; i < gltf->num_buffers; i++) {
+        if(gltf->buffer_files[i].data != NULL) {
+            unmap_file(&gltf->buffer_files[i]);
+        } else if(gltf->buffer_data[i] != gltf->binary_chunk) {
+            free(gltf->buffer_data[i]);
+        }
+    }
+    for(int i = 0; i < gltf->num_images; i++) {
+        if(gltf->image_files[i].data != NULL) {
+            unmap_file(&gltf->image_files[i]);
+        } else {
+            free(gltf->image_data[i]);
+        }
+    }
+    free(gltf->buffer_data);
+    free(gltf->buffer_sizes);
+    free(gltf->buffer_files);
+    free(gltf->image_data);
+    free(gltf->image_sizes);
+    free(gltf->image_files);
+    free(gltf->directory);
+
+    cJSON_Delete(gltf->json);
+    gltf->json = NULL;
+    unmap_file(&gltf->file);
+}
+
+// Read up to count numbers from a JSON array, leaving the rest of the output as it was.
+static void get_floats(cJSON* array, float* output, int count) {
+    cJSON* item;
+    int i = 0;
+    cJSON_ArrayForEach(item, array) {
+        if(i == count) {
+            break;
+        }
+        output[i++] = (float)cJSON_GetNumberValue(item);
+    }
+}
+
+/**
+ * Get the local transform of the first node that uses the mesh, either its column major matrix or its translation,
+ * rotation and scale. The identity if no node uses the mesh. Returns how many nodes use the mesh.
+ */
+static int get_mesh_node_matrix(gltf_t* gltf, int mesh_idx, float matrix_out[4][4]) {
+    get_identity_matrix(matrix_out);
+    int num_nodes = 0;
+    cJSON* node;
+    cJSON_ArrayForEach(node, cJSON_GetObjectItem(gltf->json, "nodes")) {
+        if(get_int(node, "mesh", -1) != mesh_idx || num_nodes++ > 0) {
+            continue;
+        }
+        cJSON* matrix = cJSON_GetObjectItem(node, "matrix");
+        if(matrix != NULL) {
+            float columns[16];
+            memcpy(columns, matrix_out, sizeof(columns));
+            get_floats(matrix, columns, 16);
+            for(int i = 0; i < 16; i++) {
+                matrix_out[i % 4][i / 4] = columns[i];
+            }
+            continue;
+        }
+
+        float translation[3] = { 0, 0, 0 };
+        float rotation[4] = { 0, 0, 0, 1 };
+        float scale[3] = { 1, 1, 1 };
+        get_floats(cJSON_GetObjectItem(node, "translation"), translation, 3);
+        get_floats(cJSON_GetObjectItem(node, "rotation"), rotation, 4);
+        get_floats(cJSON_GetObjectItem(node, "scale"), scale, 3);
+
+        // The rotation is an x, y, z, w quaternion, scale is applied first, then rotation, then translation.
+        float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+        float rotation_matrix[3][3] = {
+            { 1 - 2 * (y * y + z * z), 2 * (x * y - z * w), 2 * (x * z + y * w) },
+            { 2 * (x * y + z * w), 1 - 2 * (x * x + z * z), 2 * (y * z - x * w) },
+            { 2 * (x * z - y * w), 2 * (y * z + x * w), 1 - 2 * (x * x + y * y) },
+        };
+        for(int row = 0; row < 3; row++) {
+            for(int column = 0; column < 3; column++) {
+                matrix_out[row][column] = rotation_matrix[row][column] * scale[column];
+            }
+            matrix_out[row][3] = translation[row];
+        }
+    }
+    return num_nodes;
+}
+
+/**
+ * Normals stay perpendicular to the surface under a non uniform scale by going through the inverse transpose of the
+ * matrix's upper 3x3. That's the cofactor matrix over the determinant, and as normals get normalized afterwards only
+ * the determinant's sign is needed, so mirroring transforms don't turn them inside out.
+ */
+static void get_normal_matrix(float matrix[4][4], float normal_matrix_out[3][3]) {
+    for(int row = 0; row < 3; row++) {
+        for(int column = 0; column < 3; column++) {
+            int r1 = (row + 1) % 3, r2 = (row + 2) % 3;
+            int c1 = (column + 1) % 3, c2 = (column + 2) % 3;
+            normal_matrix_out[row][column] = matrix[r1][c1] * matrix[r2][c2] - matrix[r1][c2] * matrix[r2][c1];
+        }
+    }
+    float determinant = matrix[0][0] * normal_matrix_out[0][0] + matrix[0][1] * normal_matrix_out[0][1] +
+                        matrix[0][2] * normal_matrix_out[0][2];
+    if(determinant < 0) {
+        for(int row = 0; row < 3; row++) {
+            for(int column = 0; column < 3; column++) {
+                normal_matrix_out[row][column] = -normal_matrix_out[row][column];
+            }
+        }
+    }
+}
+
+/**
+ * Move a primitive's vertices into place with the transform of the node using its mesh, and its normals with the
+ * normal matrix. KHR_mesh_quantization integer positions only come out right once this has scaled them back.
+ */
+static void apply_node_matrix(
+        float matrix[4][4], object_t* model, GLfloat* vertices, int num_vertices, int has_normals
+) {
+    apply_matrix_transform_strided(&vertices[VERTEX_POSITION_OFFSET], num_vertices, model->vertex_stride, matrix);
+    if(!has_normals) {
+        return;
+    }
+    float normal_matrix[3][3];
+    get_normal_matrix(matrix, normal_matrix);
+    for(int i = 0; i < num_vertices; i++) {
+        GLfloat* normal = &vertices[i * model->vertex_stride + VERTEX_NORMAL_OFFSET];
+        float transformed[3];
+        for(int row = 0; row < 3; row++) {
+            transformed[row] = normal_matrix[row][0] * normal[0] + normal_matrix[row][1] * normal[1] +
+                               normal_matrix[row][2] * normal[2];
+        }
+        float length = sqrtf(
+                transformed[0] * transformed[0] + transformed[1] * transformed[1] + transformed[2] * transformed[2]
+        );
+        for(int axis = 0; axis < 3; axis++) {
+            normal[axis] = length > 0 ? transformed[axis] / length : 0;
+        }
+    }
+}
+
+static int is_triangle_primitive(cJSON* primitive) {
+    return get_int(primitive, "mode", GLTF_MODE_TRIANGLES) == GLTF_MODE_TRIANGLES;
+}
+
+void load_gltf_meshes(gltf_t* gltf, vertex_format_t vertex_format, arena_t* mesh_arena, object_t* object_out) {
+    object_t model;
+    model.position.x = 0;
+    model.position.y = 0;
+    model.position.z = 0;
+    get_identity_matrix(model.model_matrix);
+    model.vertex_format = vertex_format;
+    model.vertex_stride = get_vertex_stride(vertex_format);
+    model.texture_id = 0;
+
+    cJSON* meshes = cJSON_GetObjectItem(gltf->json, "meshes");
+    cJSON* mesh;
+    cJSON* primitive;
+
+    // Count everything up first so the vertices and indices can each go in one allocation.
+    int total_vertices = 0;
+    int total_indices = 0;
+    cJSON_ArrayForEach(mesh, meshes) {
+        cJSON_ArrayForEach(primitive, cJSON_GetObjectItem(mesh, "primitives")) {
+            if(!is_triangle_primitive(primitive)) {
+                printf("Skipping a primitive that isn't a triangle list.\n");
+                continue;
+            }
+            cJSON* attributes = cJSON_GetObjectItem(primitive, "attributes");
+            int position_accessor = get_int(attributes, "POSITION", -1);
+            if(position_accessor == -1) {
+                printf("Primitive has no POSITION attribute.\n");
+                exit(-1);
+            }
+
+            int num_vertices = get_int(get_indexed_item(gltf, "accessors", position_accessor), "count", 0);
+            int index_accessor = get_int(primitive, "indices", -1);
+            int num_indices = index_accessor == -1
+                    ? num_vertices
+                    : get_int(get_indexed_item(gltf, "accessors", index_accessor), "count", 0);
+            if(num_indices % 3 != 0) {
+                printf("Primitive has %d indices which isn't a whole number of triangles.\n", num_indices);
+                exit(-1);
+            }
+
+            total_vertices += num_vertices;
+            total_indices += num_indices;
+        }
+    }
+
+    size_t vertices_size = (size_t)total_vertices * model.vertex_stride * sizeof(GLfloat);
+    model.vertices = arena_alloc(mesh_arena, vertices_size);
+    // Zero the padding at the end of each vertex.
+    memset(model.vertices, 0, vertices_size);
+    model.num_vertices = total_vertices;
+    model.num_indices = total_indices / 3;
+    model.num_lods = 0;
+    // Whatever width the file stores its indices in, they're kept as 16 bit if the whole model fits.
+    model.index_type = get_index_type(total_vertices);
+    model.indices = arena_alloc(mesh_arena, get_object_indices_size(&model));
+
+    int vertex_offset = 0;
+    int index_offset = 0;
+    int mesh_idx = -1;
+    cJSON_ArrayForEach(mesh, meshes) {
+        mesh_idx++;
+        // Every primitive of a mesh goes through the same node transform, whatever type its positions are stored as.
+        float node_matrix[4][4];
+        int num_mesh_nodes = get_mesh_node_matrix(gltf, mesh_idx, node_matrix);
+        if(num_mesh_nodes > 1) {
+            printf(
+                    "Mesh %d is used by %d nodes, only the first one's transform is applied.\n",
+                    mesh_idx, num_mesh_nodes
+            );
+        }
+        cJSON_ArrayForEach(primitive, cJSON_GetObjectItem(mesh, "primitives")) {
+            if(!is_triangle_primitive(primitive)) {
+                continue;
+            }
+            cJSON* attributes = cJSON_GetObjectItem(primitive, "attributes");
+            GLfloat* vertices = &model.vertices[vertex_offset * model.vertex_stride];
+
+            accessor_view_t positions = get_accessor_view(gltf, get_int(attributes, "POSITION", -1));
+            read_accessor_floats(&positions, 3, &vertices[VERTEX_POSITION_OFFSET], model.vertex_stride);
+            // The gltf format does not include the w property of the vector, so fill it in.
+            for(int i = 0; i < positions.count; i++) {
+                vertices[i * model.vertex_stride + VERTEX_POSITION_OFFSET + 3] = 1.0f;
+            }
+
+            int texture_uv_accessor = get_int(attributes, "TEXCOORD_0", -1);
+            if(texture_uv_accessor != -1) {
+                accessor_view_t texture_uvs = get_accessor_view(gltf, texture_uv_accessor);
+                if(texture_uvs.count != positions.count) {
+                    printf("Primitive has %d UVs for %d vertices.\n", texture_uvs.count, positions.count);
+                    exit(-1);
+                }
+                read_accessor_floats(&texture_uvs, 2, &vertices[VERTEX_TEXTURE_UV_OFFSET], model.vertex_stride);
+            }
+
+            int normal_accessor = get_int(attributes, "NORMAL", -1);
+            int has_normals = vertex_format == VERTEX_FORMAT_POSITION_UV_NORMAL && normal_accessor != -1;
+            if(has_normals) {
+                accessor_view_t normals = get_accessor_view(gltf, normal_accessor);
+                if(normals.count != positions.count) {
+                    printf("Primitive has %d normals for %d vertices.\n", normals.count, positions.count);
+                    exit(-1);
+                }
+                read_accessor_floats(&normals, 3, &vertices[VERTEX_NORMAL_OFFSET], model.vertex_stride);
+            }
+
+            apply_node_matrix(node_matrix, &model, vertices, positions.count, has_normals);
+
+            // Primitives without indices draw their vertices in order.
+            int index_accessor = get_int(primitive, "indices", -1);
+            int num_indices;
+            if(index_accessor != -1) {
+                accessor_view_t indices = get_accessor_view(gltf, index_accessor);
+                read_accessor_indices(&indices, vertex_offset, positions.count, &model, index_offset);
+                num_indices = indices.count;
+            } else {
+                for(int i = 0; i < positions.count; i++) {
+                    set_object_index(&model, index_offset + i, vertex_offset + i);
+                }
+                num_indices = positions.count;
+            }
+
+            vertex_offset += positions.count;
+            index_offset += num_indices;
+        }
+    }
+
+    compute_object_bounds(&model);
+    printf("%d vertices and %d triangles in model\n", model.num_vertices, model.num_indices);
+    *object_out = model;
+}
+
+/**
+ * Follow the first textured primitives material through to the image its base colour texture uses.
+ */
+static int find_texture_image_idx(gltf_t* gltf) {
+    cJSON* mesh;
+    cJSON* primitive;
+    cJSON_ArrayForEach(mesh, cJSON_GetObjectItem(gltf->json, "meshes")) {
+        cJSON_ArrayForEach(primitive, cJSON_GetObjectItem(mesh, "primitives")) {
+            int material_idx = get_int(primitive, "material", -1);
+            if(material_idx == -1) {
+                continue;
+            }
+            cJSON* material = get_indexed_item(gltf, "materials", material_idx);
+            cJSON* pbr = cJSON_GetObjectItem(material, "pbrMetallicRoughness");
+            int texture_idx = get_int(cJSON_GetObjectItem(pbr, "baseColorTexture"), "index", -1);
+            if(texture_idx == -1) {
+                continue;
+            }
+            int image_idx = get_int(get_indexed_item(gltf, "textures", texture_idx), "source", -1);
+            if(image_idx != -1) {
+                return image_idx;
+            }
+        }
+    }
+    return gltf->num_images > 0 ? 0 : -1;
+}
+
+byte* get_gltf_texture_image(gltf_t* gltf, size_t* size_out) {
+    int image_idx = find_texture_image_idx(gltf);
+    if(image_idx < 0 || image_idx >= gltf->num_images) {
+        return NULL;
+    }
+    cJSON* image = get_indexed_item(gltf, "images", image_idx);
+
+    // Images can either be embedded in a buffer, in which case we can point straight at them, or have a uri.
+    int buffer_view_idx = get_int(image, "bufferView", -1);
+    if(buffer_view_idx != -1) {
+        cJSON* buffer_view = get_indexed_item(gltf, "bufferViews", buffer_view_idx);
+        size_t buffer_size;
+        byte* buffer = get_buffer(gltf, get_int(buffer_view, "buffer", 0), &buffer_size);
+        size_t offset = get_int(buffer_view, "byteOffset", 0);
+        size_t length = get_int(buffer_view, "byteLength", 0);
+        if(offset + length > buffer_size) {
+            printf("Image %d reads past the end of its buffer.\n", image_idx);
+            exit(-1);
+        }
+        *size_out = length;
+        return buffer + offset;
+    }
+
+    if(gltf->image_data[image_idx] == NULL) {
+        char* uri = cJSON_GetStringValue(cJSON_GetObjectItem(image, "uri"));
+        if(uri == NULL) {
+            printf("Image %d has no uri or bufferView.\n", image_idx);
+            exit(-1);
+        }
+        gltf->image_data[image_idx] = load_uri(
+                gltf, uri, 0, &gltf->image_sizes[image_idx], &gltf->image_files[image_idx]
+        );
+    }
+    *size_out = gltf->image_sizes[image_idx];
+    return gltf->image_data[image_idx];
+}
+
+int get_gltf_external_uris(gltf_t* gltf, char** uris_out) {
+    int num_uris = 0;
+    const char* arrays[] = { "buffers", "images" };
+    for(size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+        cJSON* item;
+        cJSON_ArrayForEach(item, cJSON_GetObjectItem(gltf->json, arrays[i])) {
+            char* uri = cJSON_GetStringValue(cJSON_GetObjectItem(item, "uri"));
+            if(uri != NULL && strncmp(uri, "data:", 5) != 0) {
+                uris_out[num_uris++] = uri;
+            }
+        }
+    }
+    return num_uris;
+}
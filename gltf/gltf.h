@@ -0,0 +1,96 @@
+#ifndef INC_3D_GLTF_H
+#define INC_3D_GLTF_H
+
+#include <stddef.h>
+
+#include "../cJSON/cJSON.h"
+#include "../arena/arena.h"
+#include "../mapped_file/mapped_file.h"
+#include "../object/object.h"
+
+/**
+ * Notes on parsing .gltf files: The "buffers" define large portions of data that are accessed different ways for
+ * different things(vertices, texture UVs, etc). Each mesh is made of primitives, and each primitive lists its
+ * attributes(POSITION=vertices, TEXCOORD_0=uvs, etc) and indices. Each of those points to an "accessor" which
+ * tells us how many items to expect and what type they are(5126=float, 5123=unsigned short, etc). The accessors
+ * point to a "bufferView" which in turn tells us where in which buffer the data lives(offset, stride, length).
+ *
+ * Buffers and images can be base64 data URIs embedded in the JSON, separate files next to the .gltf, or for .glb
+ * files the binary chunk that follows the JSON. Files and .glb chunks are memory mapped and read in place, so the
+ * only loading cost for them is paging in the bytes that accessors actually touch.
+ */
+
+// Accessor component types.
+#define GLTF_BYTE           5120
+#define GLTF_UNSIGNED_BYTE  5121
+#define GLTF_SHORT          5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT   5125
+#define GLTF_FLOAT          5126
+
+// Primitive modes, we only draw triangle lists.
+#define GLTF_MODE_TRIANGLES 4
+
+// .glb container magic numbers, these are "glTF", "JSON" and "BIN\0" read as little endian integers.
+#define GLB_MAGIC           0x46546C67
+#define GLB_CHUNK_TYPE_JSON 0x4E4F534A
+#define GLB_CHUNK_TYPE_BIN  0x004E4942
+
+typedef struct {
+    cJSON* json;
+
+    // The .gltf or .glb file itself, and the directory it is in for finding files it refers to.
+    mapped_file_t file;
+    char* directory;
+
+    // The binary chunk of a .glb file, which is what buffer 0 refers to if it has no uri.
+    byte* binary_chunk;
+    size_t binary_chunk_size;
+
+    /**
+     * Buffers are loaded the first time an accessor needs them, and are NULL until then. Buffers from external
+     * files also keep their mapping so that it can be released when the file is closed.
+     */
+    int num_buffers;
+    byte** buffer_data;
+    size_t* buffer_sizes;
+    mapped_file_t* buffer_files;
+
+    // Images that came from a data URI or an external file rather than pointing into a buffer.
+    int num_images;
+    byte** image_data;
+    size_t* image_sizes;
+    mapped_file_t* image_files;
+} gltf_t;
+
+/**
+ * Map and parse a .gltf or .glb file, which one is worked out from the contents rather than the file extension.
+ */
+void open_gltf(char* file_path, gltf_t* gltf);
+void close_gltf(gltf_t* gltf);
+
+/**
+ * Combine every triangle primitive of every mesh in the file into a single object, with its vertices and indices
+ * in the mesh arena. Primitives can use any of the accessor component types and strides glTF allows, indices are
+ * stored as 16 bit when the model has few enough vertices. Each mesh is moved by the local transform of the node that
+ * uses it, which also scales KHR_mesh_quantization integer positions back into place. Parent nodes aren't followed,
+ * and a mesh used by several nodes is only loaded once with the first one's transform. The objects texture_id is left
+ * for the caller to fill in.
+ */
+void load_gltf_meshes(gltf_t* gltf, vertex_format_t vertex_format, arena_t* mesh_arena, object_t* object_out);
+
+/**
+ * Find the encoded image(PNG, JPEG, etc) used as the base colour texture by the first textured primitive, falling
+ * back to the first image in the file. Returns NULL if the file has no images. The data stays valid until the
+ * file is closed.
+ */
+byte* get_gltf_texture_image(gltf_t* gltf, size_t* size_out);
+
+/**
+ * Get the uri of every buffer and image kept in its own file rather than embedded, relative to the model file's
+ * directory. uris_out needs room for num_buffers + num_images, and the strings are only valid until the file is
+ * closed. Returns how many were found.
+ */
+int get_gltf_external_uris(gltf_t* gltf, char** uris_out);
+
+#endif //INC_3D_GLTF_H
@@ -0,0 +1,109 @@
+#include "headless.h"
+
+#include <EGL/eglext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../stb/stb_image_write.h"
+
+/**
+ * Prefer Mesa's surfaceless platform, which doesn't need an X server or a GPU, and fall back to whatever the default
+ * display is otherwise.
+ */
+static EGLDisplay get_headless_display() {
+    EGLDisplay display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(get_platform_display != NULL) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+#endif
+    if(display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    return display;
+}
+
+void create_headless_context(headless_context_t* context, int width, int height) {
+    memset(context, 0, sizeof(headless_context_t));
+    context->width = width;
+    context->height = height;
+
+    context->display = get_headless_display();
+    EGLint major, minor;
+    if(context->display == EGL_NO_DISPLAY || !eglInitialize(context->display, &major, &minor)) {
+        printf("Failed to initialise EGL, error 0x%x.\n", eglGetError());
+        exit(-1);
+    }
+    printf("Using EGL %d.%d from %s\n", major, minor, eglQueryString(context->display, EGL_VENDOR));
+
+    /**
+     * The shaders are written for legacy desktop OpenGL, so ask for that rather than OpenGL ES. Configs default to
+     * needing window support, which a display with no windows doesn't have, so ask for pbuffer support instead.
+     */
+    EGLint config_attributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint num_configs;
+    if(!eglChooseConfig(context->display, config_attributes, &config, 1, &num_configs) || num_configs == 0) {
+        printf("No EGL config supports desktop OpenGL.\n");
+        exit(-1);
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+    context->context = eglCreateContext(context->display, config, EGL_NO_CONTEXT, NULL);
+    if(context->context == EGL_NO_CONTEXT) {
+        printf("Failed to create an OpenGL context, error 0x%x.\n", eglGetError());
+        exit(-1);
+    }
+
+    // There's no surface to draw to, everything goes into the framebuffer object instead.
+    if(!eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE, context->context)) {
+        printf("Failed to make the OpenGL context current, error 0x%x.\n", eglGetError());
+        exit(-1);
+    }
+
+    glGenRenderbuffers(1, &context->color_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, context->color_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &context->depth_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, context->depth_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &context->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, context->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, context->color_renderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, context->depth_renderbuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Offscreen framebuffer is incomplete, status 0x%x.\n", status);
+        exit(-1);
+    }
+
+    glViewport(0, 0, width, height);
+}
+
+void destroy_headless_context(headless_context_t* context) {
+    glDeleteFramebuffers(1, &context->framebuffer);
+    glDeleteRenderbuffers(1, &context->color_renderbuffer);
+    glDeleteRenderbuffers(1, &context->depth_renderbuffer);
+
+    eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(context->display, context->context);
+    eglTerminate(context->display);
+}
+
+void save_frame_png(const char* path, unsigned char* pixels, int width, int height) {
+    if(!stbi_write_png(path, width, height, 4, pixels, width * 4)) {
+        printf("Failed to write frame to %s.\n", path);
+        exit(-1);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef INC_3D_HEADLESS_H
+#define INC_3D_HEADLESS_H
+
+#include <EGL/egl.h>
+
+#include "../gl/gl.h"
+
+/**
+ * An OpenGL context with nothing to display to, for rendering on machines without a display or GPU(e.g. Mesa's
+ * llvmpipe). Frames are drawn into a framebuffer object instead of a window and read back to be written to disk.
+ * The CPU render backend doesn't need any of this, only save_frame_png.
+ */
+typedef struct {
+    EGLDisplay display;
+    EGLContext context;
+
+    GLuint framebuffer;
+    GLuint color_renderbuffer;
+    GLuint depth_renderbuffer;
+    int width;
+    int height;
+} headless_context_t;
+
+/**
+ * Create a context and make it current, with a framebuffer of the given size bound so that drawing goes to it.
+ */
+void create_headless_context(headless_context_t* context, int width, int height);
+void destroy_headless_context(headless_context_t* context);
+
+/**
+ * Write width * height RGBA8 pixels, starting with the top row, to a PNG file.
+ */
+void save_frame_png(const char* path, unsigned char* pixels, int width, int height);
+
+#endif //INC_3D_HEADLESS_H
@@ -0,0 +1,166 @@
+#include "instancing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../profiler/profiler.h"
+#include "../transform/transform.h"
+
+void build_instanced_mesh(instanced_mesh_t* mesh, object_t* object, int is_quantized) {
+    PROFILE_SCOPE("build_instanced_mesh");
+    mesh->object = object;
+    mesh->num_instances = get_object_num_instances(object);
+    mesh->instance_matrices = malloc(mesh->num_instances * sizeof(float[4][4]));
+    mesh->is_quantized = is_quantized;
+
+    // Unlike the batch, indices stay relative to the objects own vertices so they can be uploaded as they are.
+    glGenBuffers(1, &mesh->vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer);
+    if(is_quantized) {
+        quantized_vertex_t* vertices = malloc(object->num_vertices * sizeof(quantized_vertex_t));
+        quantize_object_vertices(object, vertices, mesh->dequantize_matrix);
+        glBufferData(GL_ARRAY_BUFFER, object->num_vertices * sizeof(quantized_vertex_t), vertices, GL_STATIC_DRAW);
+        free(vertices);
+    } else {
+        glBufferData(
+                GL_ARRAY_BUFFER, object->num_vertices * object->vertex_stride * sizeof(GLfloat), object->vertices,
+                GL_STATIC_DRAW
+        );
+    }
+
+    glGenBuffers(1, &mesh->index_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, get_object_indices_size(object), object->indices, GL_STATIC_DRAW);
+
+    // Filled in every frame, so the driver is only told how big it is for now.
+    glGenBuffers(1, &mesh->instance_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, mesh->num_instances * sizeof(float[4][4]), NULL, GL_STREAM_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    printf(
+            "Instanced %d copies of an object (%d vertices, %d triangles).\n",
+            mesh->num_instances, object->num_vertices, object->num_indices
+    );
+}
+
+void free_instanced_mesh(instanced_mesh_t* mesh) {
+    glDeleteBuffers(1, &mesh->vertex_buffer);
+    glDeleteBuffers(1, &mesh->index_buffer);
+    glDeleteBuffers(1, &mesh->instance_buffer);
+
+    free(mesh->instance_matrices);
+    mesh->instance_matrices = NULL;
+    mesh->object = NULL;
+    mesh->num_instances = 0;
+}
+
+void draw_instanced_mesh(
+        instanced_mesh_t* mesh, const byte* is_instance_visible, const byte* instance_lods,
+        instanced_attributes_t* attributes, int has_instanced_arrays
+) {
+    object_t* object = mesh->object;
+
+    // Group the visible instances by level of detail so each level's matrices are one run of the instance buffer.
+    int level_starts[MAX_OBJECT_LODS + 2] = { 0 };
+    for(int i = 0; i < mesh->num_instances; i++) {
+        if(is_instance_visible[i]) {
+            level_starts[instance_lods[i] + 1]++;
+        }
+    }
+    for(int level = 0; level <= MAX_OBJECT_LODS; level++) {
+        level_starts[level + 1] += level_starts[level];
+    }
+    int num_visible = level_starts[MAX_OBJECT_LODS + 1];
+    if(num_visible == 0) {
+        return;
+    }
+
+    int level_ends[MAX_OBJECT_LODS + 1];
+    memcpy(level_ends, level_starts, sizeof(level_ends));
+    for(int i = 0; i < mesh->num_instances; i++) {
+        if(!is_instance_visible[i]) {
+            continue;
+        }
+        float (*matrix)[4] = mesh->instance_matrices[level_ends[instance_lods[i]]++];
+        if(mesh->is_quantized) {
+            multiply_matrices(matrix, get_instance_matrix(object, i), mesh->dequantize_matrix);
+        } else {
+            memcpy(matrix, get_instance_matrix(object, i), sizeof(float[4][4]));
+        }
+    }
+
+    PROFILE_GPU_SCOPE("gpu_draw_instances");
+    if(has_instanced_arrays) {
+        PROFILE_SCOPE("upload_instance_matrices");
+        // Orphan last frame's matrices so the driver doesn't have to wait for the GPU to finish reading them.
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->instance_buffer);
+        glBufferData(GL_ARRAY_BUFFER, mesh->num_instances * sizeof(float[4][4]), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, num_visible * sizeof(float[4][4]), mesh->instance_matrices);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer);
+    if(mesh->is_quantized) {
+        GLsizei stride = sizeof(quantized_vertex_t);
+        glVertexAttribPointer(
+                attributes->position_attribute, 3, GL_SHORT, GL_FALSE, stride,
+                (void*)offsetof(quantized_vertex_t, position)
+        );
+        glVertexAttribPointer(
+                attributes->texture_uv_attribute, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                (void*)offsetof(quantized_vertex_t, texture_uv)
+        );
+    } else {
+        GLsizei stride = object->vertex_stride * sizeof(GLfloat);
+        glVertexAttribPointer(
+                attributes->position_attribute, 4, GL_FLOAT, GL_FALSE, stride,
+                (void*)(VERTEX_POSITION_OFFSET * sizeof(GLfloat))
+        );
+        glVertexAttribPointer(
+                attributes->texture_uv_attribute, 2, GL_FLOAT, GL_FALSE, stride,
+                (void*)(VERTEX_TEXTURE_UV_OFFSET * sizeof(GLfloat))
+        );
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->index_buffer);
+    glBindTexture(GL_TEXTURE_2D, object->texture_id);
+    GLenum index_type = get_gl_index_type(object->index_type);
+    size_t index_size = get_index_size(object->index_type);
+
+    PROFILE_SCOPE("draw_elements_instanced");
+    for(int level = 0; level <= MAX_OBJECT_LODS; level++) {
+        int first_instance = level_starts[level];
+        int num_instances = level_starts[level + 1] - first_instance;
+        if(num_instances == 0) {
+            continue;
+        }
+        object_lod_t lod = get_object_lod(object, level);
+        GLsizei num_indices = lod.num_indices * 3;
+        const void* indices_offset = (void*)(lod.first_index * 3 * index_size);
+
+        if(!has_instanced_arrays) {
+            for(int i = first_instance; i < first_instance + num_instances; i++) {
+                for(int row = 0; row < 4; row++) {
+                    glVertexAttrib4fv(attributes->model_row_attributes[row], mesh->instance_matrices[i][row]);
+                }
+                glDrawElements(GL_TRIANGLES, num_indices, index_type, indices_offset);
+            }
+            continue;
+        }
+
+        // There's no base instance before OpenGL 4.2, so each level points the rows at the start of its run instead.
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->instance_buffer);
+        for(int row = 0; row < 4; row++) {
+            glVertexAttribPointer(
+                    attributes->model_row_attributes[row], 4, GL_FLOAT, GL_FALSE, sizeof(float[4][4]),
+                    (void*)(first_instance * sizeof(float[4][4]) + row * sizeof(float[4]))
+            );
+        }
+        glDrawElementsInstanced(GL_TRIANGLES, num_indices, index_type, indices_offset, num_instances);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,55 @@
+#ifndef INC_3D_INSTANCING_H
+#define INC_3D_INSTANCING_H
+
+#include "../object/object.h"
+
+/**
+ * Where the instanced vertex shader expects its inputs. Each instance's model matrix comes in as its four rows,
+ * which step once per instance rather than once per vertex.
+ */
+typedef struct {
+    GLint position_attribute;
+    GLint texture_uv_attribute;
+    GLint model_row_attributes[4];
+} instanced_attributes_t;
+
+/**
+ * An instanced object's mesh in its own GPU buffers, with every level of detail, and a buffer its visible instances'
+ * model matrices are streamed into each frame. However many instances there are, each level of detail in use costs
+ * one draw call.
+ */
+typedef struct {
+    object_t* object;
+
+    GLuint vertex_buffer;
+    GLuint index_buffer;
+    GLuint instance_buffer;
+
+    // Whether the vertex buffer holds quantized_vertex_t, which the dequantize matrix is put onto each instance for.
+    int is_quantized;
+    float dequantize_matrix[4][4];
+
+    // The visible instances' model matrices, grouped by level of detail, before they're uploaded.
+    float (*instance_matrices)[4][4];
+    int num_instances;
+} instanced_mesh_t;
+
+/**
+ * Upload an instanced object's mesh, quantized like the batch's if is_quantized is set. The mesh holds on to the
+ * object pointer so that it can read its instance matrices each frame, and has room for as many instances as the
+ * object has now.
+ */
+void build_instanced_mesh(instanced_mesh_t* mesh, object_t* object, int is_quantized);
+void free_instanced_mesh(instanced_mesh_t* mesh);
+
+/**
+ * Draw every one of the objects instances that's visible, going by is_instance_visible, at the level of detail in
+ * instance_lods, both in the order of the objects instances. Without instanced arrays, has_instanced_arrays being 0,
+ * each instance's rows are set as constant attributes and it gets a draw call of its own instead.
+ */
+void draw_instanced_mesh(
+        instanced_mesh_t* mesh, const byte* is_instance_visible, const byte* instance_lods,
+        instanced_attributes_t* attributes, int has_instanced_arrays
+);
+
+#endif //INC_3D_INSTANCING_H
@@ -0,0 +1,509 @@
+#include "lod.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Collapsing an edge folds a neighbouring triangle over if its normal turns by more than this much, as a cosine,
+ * which is about 75 degrees.
+ */
+#define LOD_MAX_NORMAL_CHANGE 0.25f
+
+// Stop making levels once one can't get rid of at least this fraction of the triangles of the one before.
+#define LOD_MIN_REDUCTION 0.1f
+
+/**
+ * The squared distance to a set of planes as a symmetric 4x4 matrix, a^2, ab, ac, ad, b^2, bc, bd, c^2, cd, d^2.
+ * Planes are weighted by their triangle's area, and the weight is kept so the error can be averaged.
+ */
+typedef struct {
+    double q[10];
+    double weight;
+} quadric_t;
+
+typedef struct {
+    int from;
+    int to;
+    double cost;
+} collapse_t;
+
+typedef struct {
+    object_t* object;
+    int num_vertices;
+
+    // The triangles left so far as plain indices.
+    GLuint* indices;
+    int num_triangles;
+
+    // The vertex with the same position that stands in for every vertex sharing it, for quadrics and borders.
+    int* position_ids;
+    byte* is_locked;
+    quadric_t* quadrics;
+
+    // The largest collapse cost so far, which is the error of the current triangles.
+    double max_cost;
+
+    // Scratch for each pass, the triangles around each vertex in one array.
+    int* vertex_triangle_offsets;
+    int* vertex_triangles;
+    collapse_t* collapses;
+    int* remap;
+    byte* is_pass_locked;
+} simplifier_t;
+
+static GLfloat* get_position(simplifier_t* simplifier, int vertex_idx) {
+    object_t* object = simplifier->object;
+    return &object->vertices[vertex_idx * object->vertex_stride + VERTEX_POSITION_OFFSET];
+}
+
+static void add_plane(quadric_t* quadric, double a, double b, double c, double d, double weight) {
+    double* q = quadric->q;
+    q[0] += weight * a * a;
+    q[1] += weight * a * b;
+    q[2] += weight * a * c;
+    q[3] += weight * a * d;
+    q[4] += weight * b * b;
+    q[5] += weight * b * c;
+    q[6] += weight * b * d;
+    q[7] += weight * c * c;
+    q[8] += weight * c * d;
+    q[9] += weight * d * d;
+    quadric->weight += weight;
+}
+
+static void add_quadric(quadric_t* quadric, quadric_t* other) {
+    for(int i = 0; i < 10; i++) {
+        quadric->q[i] += other->q[i];
+    }
+    quadric->weight += other->weight;
+}
+
+// The average squared distance from a point to the quadric's planes.
+static double evaluate_quadric(quadric_t* quadric, GLfloat* position) {
+    double x = position[0];
+    double y = position[1];
+    double z = position[2];
+    double* q = quadric->q;
+    double error = q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+                   q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+                   q[7] * z * z + 2 * q[8] * z + q[9];
+    return quadric->weight > 0 ? fmax(error, 0) / quadric->weight : 0;
+}
+
+/**
+ * Positions on a regular grid have most of their low mantissa bits zero, so the bits are mixed down before the
+ * table uses the low ones.
+ */
+static uint32_t hash_position(GLfloat* position) {
+    uint32_t bits[3];
+    memcpy(bits, position, sizeof(bits));
+    uint32_t hash = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+// Give every vertex the id of the first vertex with exactly the same position.
+static void find_position_ids(simplifier_t* simplifier) {
+    int table_size = 1;
+    while(table_size < simplifier->num_vertices * 2) {
+        table_size *= 2;
+    }
+    int* table = malloc(table_size * sizeof(int));
+    memset(table, -1, table_size * sizeof(int));
+
+    for(int i = 0; i < simplifier->num_vertices; i++) {
+        GLfloat* position = get_position(simplifier, i);
+        uint32_t slot = hash_position(position) & (table_size - 1);
+        while(table[slot] != -1 && memcmp(get_position(simplifier, table[slot]), position, 3 * sizeof(GLfloat)) != 0) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if(table[slot] == -1) {
+            table[slot] = i;
+        }
+        simplifier->position_ids[i] = table[slot];
+    }
+    free(table);
+}
+
+// Fill in which triangles use each vertex, optionally going by position rather than the vertex itself.
+static void find_vertex_triangles(simplifier_t* simplifier, int by_position) {
+    int* offsets = simplifier->vertex_triangle_offsets;
+    memset(offsets, 0, ((size_t)simplifier->num_vertices + 1) * sizeof(int));
+    for(int i = 0; i < simplifier->num_triangles * 3; i++) {
+        int vertex_idx = by_position ? simplifier->position_ids[simplifier->indices[i]] : (int)simplifier->indices[i];
+        offsets[vertex_idx + 1]++;
+    }
+    for(int i = 0; i < simplifier->num_vertices; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    // Filling each vertex's run moves its offset to the end of it, which is where the next vertex starts.
+    for(int i = 0; i < simplifier->num_triangles * 3; i++) {
+        int vertex_idx = by_position ? simplifier->position_ids[simplifier->indices[i]] : (int)simplifier->indices[i];
+        simplifier->vertex_triangles[offsets[vertex_idx]++] = i / 3;
+    }
+    memmove(&offsets[1], &offsets[0], (size_t)simplifier->num_vertices * sizeof(int));
+    offsets[0] = 0;
+}
+
+static int get_triangle_count(simplifier_t* simplifier, int vertex_idx) {
+    return simplifier->vertex_triangle_offsets[vertex_idx + 1] - simplifier->vertex_triangle_offsets[vertex_idx];
+}
+
+/**
+ * Lock every vertex that shares its position with another one, which is a seam in the UVs, and every vertex on an
+ * edge that doesn't have exactly two triangles, which is a border or somewhere the mesh isn't a closed surface.
+ * position_counts and is_position_locked are zeroed scratch with room for every vertex.
+ */
+static void lock_seams_and_borders(simplifier_t* simplifier, int* position_counts, byte* is_position_locked) {
+    for(int i = 0; i < simplifier->num_vertices; i++) {
+        position_counts[simplifier->position_ids[i]]++;
+    }
+
+    find_vertex_triangles(simplifier, 1);
+    for(int triangle_idx = 0; triangle_idx < simplifier->num_triangles; triangle_idx++) {
+        GLuint* triangle = &simplifier->indices[triangle_idx * 3];
+        for(int edge = 0; edge < 3; edge++) {
+            int a = simplifier->position_ids[triangle[edge]];
+            int b = simplifier->position_ids[triangle[(edge + 1) % 3]];
+
+            int num_edge_triangles = 0;
+            int first = simplifier->vertex_triangle_offsets[a];
+            for(int i = first; i < first + get_triangle_count(simplifier, a); i++) {
+                GLuint* other = &simplifier->indices[simplifier->vertex_triangles[i] * 3];
+                for(int corner = 0; corner < 3; corner++) {
+                    if(simplifier->position_ids[other[corner]] == b) {
+                        num_edge_triangles++;
+                        break;
+                    }
+                }
+            }
+            if(num_edge_triangles != 2) {
+                is_position_locked[a] = 1;
+                is_position_locked[b] = 1;
+            }
+        }
+    }
+
+    for(int i = 0; i < simplifier->num_vertices; i++) {
+        int position_id = simplifier->position_ids[i];
+        simplifier->is_locked[i] = position_counts[position_id] > 1 || is_position_locked[position_id];
+    }
+}
+
+static void get_triangle_normal(GLfloat* p0, GLfloat* p1, GLfloat* p2, double normal_out[3]) {
+    double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    normal_out[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    normal_out[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    normal_out[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static double get_length(double vector[3]) {
+    return sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+}
+
+// Every triangle's plane goes into the quadric of each of its corners' positions.
+static void init_quadrics(simplifier_t* simplifier) {
+    for(int triangle_idx = 0; triangle_idx < simplifier->num_triangles; triangle_idx++) {
+        GLuint* triangle = &simplifier->indices[triangle_idx * 3];
+        GLfloat* p0 = get_position(simplifier, triangle[0]);
+        double normal[3];
+        get_triangle_normal(p0, get_position(simplifier, triangle[1]), get_position(simplifier, triangle[2]), normal);
+        double length = get_length(normal);
+        if(length == 0) {
+            continue;
+        }
+
+        double a = normal[0] / length;
+        double b = normal[1] / length;
+        double c = normal[2] / length;
+        double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+        for(int corner = 0; corner < 3; corner++) {
+            add_plane(&simplifier->quadrics[simplifier->position_ids[triangle[corner]]], a, b, c, d, length / 2);
+        }
+    }
+}
+
+static int compare_collapses(const void* a, const void* b) {
+    double cost_a = ((const collapse_t*)a)->cost;
+    double cost_b = ((const collapse_t*)b)->cost;
+    return cost_a < cost_b ? -1 : cost_a > cost_b;
+}
+
+// Check that moving from onto to doesn't fold any of from's other triangles over, or pull them across a seam.
+static int is_collapse_valid(simplifier_t* simplifier, int from, int to) {
+    GLfloat* to_position = get_position(simplifier, to);
+    int first = simplifier->vertex_triangle_offsets[from];
+    for(int i = first; i < first + get_triangle_count(simplifier, from); i++) {
+        GLuint* triangle = &simplifier->indices[simplifier->vertex_triangles[i] * 3];
+        if(triangle[0] == (GLuint)to || triangle[1] == (GLuint)to || triangle[2] == (GLuint)to) {
+            continue;
+        }
+        /**
+         * A triangle with another vertex at to's position is across a UV seam from it, where from is at the end of
+         * the seam. Moving from onto to would stretch to's side of the texture across it.
+         */
+        for(int corner = 0; corner < 3; corner++) {
+            if(simplifier->position_ids[triangle[corner]] == simplifier->position_ids[to]) {
+                return 0;
+            }
+        }
+
+        GLfloat* positions[3];
+        GLfloat* moved_positions[3];
+        for(int corner = 0; corner < 3; corner++) {
+            positions[corner] = get_position(simplifier, triangle[corner]);
+            moved_positions[corner] = triangle[corner] == (GLuint)from ? to_position : positions[corner];
+        }
+        double normal[3];
+        double moved_normal[3];
+        get_triangle_normal(positions[0], positions[1], positions[2], normal);
+        get_triangle_normal(moved_positions[0], moved_positions[1], moved_positions[2], moved_normal);
+        double dot = normal[0] * moved_normal[0] + normal[1] * moved_normal[1] + normal[2] * moved_normal[2];
+        if(dot < LOD_MAX_NORMAL_CHANGE * get_length(normal) * get_length(moved_normal)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Collapse the cheapest edges that don't touch each other, so every collapse in a pass can be checked against the
+ * triangles as they were at the start of it. Returns how many triangles were removed.
+ */
+static int run_collapse_pass(simplifier_t* simplifier, int num_triangles_to_remove) {
+    find_vertex_triangles(simplifier, 0);
+
+    // Only each vertex's cheapest collapse is kept, which is all that could be used before its neighbours change.
+    for(int i = 0; i < simplifier->num_vertices; i++) {
+        simplifier->collapses[i].to = -1;
+    }
+    for(int triangle_idx = 0; triangle_idx < simplifier->num_triangles; triangle_idx++) {
+        GLuint* triangle = &simplifier->indices[triangle_idx * 3];
+        for(int edge = 0; edge < 3; edge++) {
+            int a = (int)triangle[edge];
+            int b = (int)triangle[(edge + 1) % 3];
+            for(int direction = 0; direction < 2; direction++) {
+                int from = direction == 0 ? a : b;
+                int to = direction == 0 ? b : a;
+                if(simplifier->is_locked[from]) {
+                    continue;
+                }
+                quadric_t quadric = simplifier->quadrics[simplifier->position_ids[from]];
+                add_quadric(&quadric, &simplifier->quadrics[simplifier->position_ids[to]]);
+                double cost = evaluate_quadric(&quadric, get_position(simplifier, to));
+
+                collapse_t* collapse = &simplifier->collapses[from];
+                if(collapse->to == -1 || cost < collapse->cost) {
+                    collapse->from = from;
+                    collapse->to = to;
+                    collapse->cost = cost;
+                }
+            }
+        }
+    }
+    int num_collapses = 0;
+    for(int i = 0; i < simplifier->num_vertices; i++) {
+        if(simplifier->collapses[i].to != -1) {
+            simplifier->collapses[num_collapses++] = simplifier->collapses[i];
+        }
+    }
+    qsort(simplifier->collapses, num_collapses, sizeof(collapse_t), compare_collapses);
+
+    for(int i = 0; i < simplifier->num_vertices; i++) {
+        simplifier->remap[i] = i;
+        simplifier->is_pass_locked[i] = 0;
+    }
+
+    int num_removed = 0;
+    for(int i = 0; i < num_collapses && num_removed < num_triangles_to_remove; i++) {
+        collapse_t* collapse = &simplifier->collapses[i];
+        int from = collapse->from;
+        int to = collapse->to;
+        if(simplifier->is_pass_locked[from] || simplifier->is_pass_locked[to]) {
+            continue;
+        }
+        if(!is_collapse_valid(simplifier, from, to)) {
+            continue;
+        }
+
+        // Everything around the collapse has changed, so none of it can be collapsed again until the next pass.
+        int first = simplifier->vertex_triangle_offsets[from];
+        for(int j = first; j < first + get_triangle_count(simplifier, from); j++) {
+            GLuint* triangle = &simplifier->indices[simplifier->vertex_triangles[j] * 3];
+            int has_to = 0;
+            for(int corner = 0; corner < 3; corner++) {
+                simplifier->is_pass_locked[triangle[corner]] = 1;
+                has_to |= triangle[corner] == (GLuint)to;
+            }
+            num_removed += has_to;
+        }
+        simplifier->is_pass_locked[to] = 1;
+
+        simplifier->remap[from] = to;
+        add_quadric(
+                &simplifier->quadrics[simplifier->position_ids[to]],
+                &simplifier->quadrics[simplifier->position_ids[from]]
+        );
+        simplifier->max_cost = fmax(simplifier->max_cost, collapse->cost);
+    }
+
+    // Triangles that had both ends of a collapsed edge are now lines, so they're dropped.
+    int num_triangles = 0;
+    for(int triangle_idx = 0; triangle_idx < simplifier->num_triangles; triangle_idx++) {
+        GLuint a = simplifier->remap[simplifier->indices[triangle_idx * 3 + 0]];
+        GLuint b = simplifier->remap[simplifier->indices[triangle_idx * 3 + 1]];
+        GLuint c = simplifier->remap[simplifier->indices[triangle_idx * 3 + 2]];
+        if(a == b || b == c || a == c) {
+            continue;
+        }
+        simplifier->indices[num_triangles * 3 + 0] = a;
+        simplifier->indices[num_triangles * 3 + 1] = b;
+        simplifier->indices[num_triangles * 3 + 2] = c;
+        num_triangles++;
+    }
+    num_removed = simplifier->num_triangles - num_triangles;
+    simplifier->num_triangles = num_triangles;
+    return num_removed;
+}
+
+static void simplify(simplifier_t* simplifier, int target_triangles) {
+    while(simplifier->num_triangles > target_triangles) {
+        if(run_collapse_pass(simplifier, simplifier->num_triangles - target_triangles) == 0) {
+            return;
+        }
+    }
+}
+
+void generate_object_lods(object_t* object, arena_t* arena) {
+    object->num_lods = 0;
+    if(object->num_indices < LOD_MIN_TRIANGLES || object->num_vertices <= 0) {
+        return;
+    }
+
+    simplifier_t simplifier = {
+        .object = object,
+        .num_vertices = object->num_vertices,
+        .num_triangles = object->num_indices,
+    };
+    size_t num_vertices = (size_t)object->num_vertices;
+    simplifier.indices = malloc((size_t)object->num_indices * 3 * sizeof(GLuint));
+    for(int i = 0; i < object->num_indices * 3; i++) {
+        simplifier.indices[i] = get_object_index(object, i);
+    }
+    simplifier.position_ids = malloc(num_vertices * sizeof(int));
+    simplifier.is_locked = malloc(num_vertices);
+    simplifier.quadrics = calloc(num_vertices, sizeof(quadric_t));
+    simplifier.vertex_triangle_offsets = malloc((num_vertices + 1) * sizeof(int));
+    simplifier.vertex_triangles = malloc((size_t)object->num_indices * 3 * sizeof(int));
+    simplifier.collapses = malloc(num_vertices * sizeof(collapse_t));
+    simplifier.remap = malloc(num_vertices * sizeof(int));
+    simplifier.is_pass_locked = malloc(num_vertices);
+
+    find_position_ids(&simplifier);
+    int* position_counts = calloc(num_vertices, sizeof(int));
+    byte* is_position_locked = calloc(num_vertices, 1);
+    lock_seams_and_borders(&simplifier, position_counts, is_position_locked);
+    free(position_counts);
+    free(is_position_locked);
+    init_quadrics(&simplifier);
+
+    // Each level carries on from the last, so the quadrics keep the error of every collapse that led to it.
+    GLuint* lod_indices[MAX_OBJECT_LODS];
+    int total_indices = object->num_indices;
+    int previous_triangles = object->num_indices;
+    while(object->num_lods < MAX_OBJECT_LODS) {
+        simplify(&simplifier, (int)(previous_triangles * LOD_TRIANGLE_RATIO));
+        if(simplifier.num_triangles > previous_triangles * (1 - LOD_MIN_REDUCTION)) {
+            break;
+        }
+
+        object_lod_t* lod = &object->lods[object->num_lods];
+        lod->first_index = total_indices;
+        lod->num_indices = simplifier.num_triangles;
+        lod->error = (float)sqrt(simplifier.max_cost);
+        size_t indices_size = (size_t)simplifier.num_triangles * 3 * sizeof(GLuint);
+        lod_indices[object->num_lods] = malloc(indices_size);
+        memcpy(lod_indices[object->num_lods++], simplifier.indices, indices_size);
+        total_indices += simplifier.num_triangles;
+        previous_triangles = simplifier.num_triangles;
+    }
+
+    printf("Generated %d levels of detail for %d triangles:", object->num_lods, object->num_indices);
+    for(int level = 0; level < object->num_lods; level++) {
+        printf(" %d", object->lods[level].num_indices);
+    }
+    printf(".\n");
+
+    // Copy the full detail indices over as they are, then add each level after them.
+    if(object->num_lods > 0) {
+        void* indices = arena_alloc(arena, get_object_indices_size(object));
+        memcpy(indices, object->indices, (size_t)object->num_indices * 3 * get_index_size(object->index_type));
+        object->indices = indices;
+        for(int level = 0; level < object->num_lods; level++) {
+            object_lod_t* lod = &object->lods[level];
+            for(int i = 0; i < lod->num_indices * 3; i++) {
+                set_object_index(object, lod->first_index * 3 + i, lod_indices[level][i]);
+            }
+            free(lod_indices[level]);
+        }
+    }
+
+    free(simplifier.indices);
+    free(simplifier.position_ids);
+    free(simplifier.is_locked);
+    free(simplifier.quadrics);
+    free(simplifier.vertex_triangle_offsets);
+    free(simplifier.vertex_triangles);
+    free(simplifier.collapses);
+    free(simplifier.remap);
+    free(simplifier.is_pass_locked);
+}
+
+int select_object_lod(object_t* object, float model_matrix[4][4], int viewport_height) {
+    if(object->num_lods == 0) {
+        return 0;
+    }
+
+    // How many pixels one unit in model space covers at the object's centre, going by its largest scale.
+    float (*matrix)[4] = model_matrix;
+    vec3_t center = object->bounds.center;
+    float w = matrix[3][0] * center.x + matrix[3][1] * center.y + matrix[3][2] * center.z + matrix[3][3];
+    if(w <= 0) {
+        return 0;
+    }
+    float max_scale_squared = 0;
+    for(int i = 0; i < 3; i++) {
+        float scale_squared = matrix[0][i] * matrix[0][i] + matrix[1][i] * matrix[1][i] + matrix[2][i] * matrix[2][i];
+        max_scale_squared = fmaxf(max_scale_squared, scale_squared);
+    }
+    // Clip space is 2 units tall.
+    float pixels_per_unit = sqrtf(max_scale_squared) * viewport_height / 2 / w;
+
+    int level = 0;
+    while(level < object->num_lods && object->lods[level].error * pixels_per_unit <= LOD_MAX_SCREEN_ERROR) {
+        level++;
+    }
+    return level;
+}
+
+int select_lods(bvh_t* bvh, int viewport_height, byte* lods_out) {
+    int num_triangles = 0;
+    for(int i = 0; i < bvh->num_instances; i++) {
+        if(!bvh->is_visible[i]) {
+            continue;
+        }
+        int object_idx = bvh->instance_objects[i];
+        object_t* object = bvh->objects[object_idx];
+        float (*matrix)[4] = get_instance_matrix(object, i - bvh->object_first_instances[object_idx]);
+        lods_out[i] = (byte)select_object_lod(object, matrix, viewport_height);
+        num_triangles += get_object_lod(object, lods_out[i]).num_indices;
+    }
+    return num_triangles;
+}
@@ -0,0 +1,45 @@
+#ifndef INC_3D_LOD_H
+#define INC_3D_LOD_H
+
+#include "../arena/arena.h"
+#include "../bvh/bvh.h"
+#include "../object/object.h"
+
+// Meshes with fewer triangles than this are cheap enough to always draw in full.
+#define LOD_MIN_TRIANGLES 512
+
+// Each level of detail aims for this fraction of the triangles of the one before it.
+#define LOD_TRIANGLE_RATIO 0.5f
+
+/**
+ * A level of detail is only used while its error covers at most this many pixels on screen, so switching between
+ * levels is hard to notice.
+ */
+#define LOD_MAX_SCREEN_ERROR 1.0f
+
+/**
+ * Simplify a mesh into up to MAX_OBJECT_LODS levels of detail, each with about LOD_TRIANGLE_RATIO of the triangles
+ * of the one before. Edges are collapsed cheapest first by quadric error, the sum of squared distances to the planes
+ * of the triangles that have been merged into each vertex, and a vertex only ever moves onto one of its neighbours,
+ * so every level uses the full mesh's vertices and only needs new indices. Vertices on UV seams and open borders
+ * never move, which keeps textures and outlines intact.
+ *
+ * The objects indices are replaced with a copy in the arena that has every level's triangles after the full detail
+ * ones. Stops early once collapsing more would fold triangles over, so simple meshes can get fewer levels, or none.
+ */
+void generate_object_lods(object_t* object, arena_t* arena);
+
+/**
+ * Pick the simplest level of detail whose error would cover at most LOD_MAX_SCREEN_ERROR pixels, going by how big the
+ * object is on a viewport viewport_height pixels tall when drawn with model_matrix. Model matrices take vertices
+ * straight to clip space, so that only needs the model matrix.
+ */
+int select_object_lod(object_t* object, float model_matrix[4][4], int viewport_height);
+
+/**
+ * Select a level of detail for every instance the hierarchy last found visible into lods_out, which has an entry
+ * for each of its instances. Returns how many triangles the visible instances have at those levels.
+ */
+int select_lods(bvh_t* bvh, int viewport_height, byte* lods_out);
+
+#endif //INC_3D_LOD_H
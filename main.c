@@ -1,5 +1,10 @@
-#include <OpenGL/gl.h>
+#include "gl/gl.h"
+
+#ifdef HEADLESS
+#include "headless/headless.h"
+#else
 #include <GLUT/glut.h>
+#endif
 
 #include <math.h>
 #include <printf.h>
@@ -7,66 +12,35 @@
 #include <memory.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include "shaders.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
-#include "cJSON/cJSON.h"
-#include "base64/base64.h"
-
-typedef unsigned char byte;
+#include "transform/transform.h"
+#include "object/object.h"
+#include "arena/arena.h"
+#include "gltf/gltf.h"
+#include "render/render.h"
+#include "gl_render/gl_render.h"
+#include "raster/raster.h"
+#include "thread_pool/thread_pool.h"
+#include "profiler/profiler.h"
+#include "resource_cache/resource_cache.h"
+#include "asset_loader/asset_loader.h"
 
 
 // Time since the last frame in seconds.
 double time_delta;
 double last_frame_time;
 
-typedef struct {
-    float x;
-    float y;
-    float z;
-} vec3_t;
-
-typedef struct {
-    vec3_t position;
-
-    GLfloat* vertices;
-    GLuint* indices;
-    GLfloat* texture_uvs; // TODO: Probably interleave with vertices.
-    GLfloat* colors; // TODO: Remove.
-
-    GLuint texture_id;
-
-    int num_vertices;
-    int num_indices;
-} object_t;
-
-typedef struct {
-    int item_size;
-
-    void* buffer;
-    int free_offset;
-} allocator_t;
-
-allocator_t new_allocator(int item_size, int max_num_items) {
-    allocator_t allocator = {
-        .item_size   = item_size,
-        .buffer      = aligned_alloc(512, max_num_items * item_size),
-        .free_offset = 0
-    };
-    return allocator;
-}
-
-void* acquire_memory(allocator_t* allocator, int num_items) {
-    void* acquired_pointer = allocator->buffer + allocator->free_offset * allocator->item_size;
-    allocator->free_offset += num_items;
-    return acquired_pointer;
-}
-
-allocator_t vertex_allocator;
-allocator_t index_allocator;
-allocator_t texture_uv_allocator;
+/**
+ * Vertex and index data for every object lives in the mesh arena for the life of the scene. Buffers that are only
+ * needed while uploading, like the compressed copy of each texture, go in the scratch arena which is reset each time
+ * newly loaded models are added to the scene. Only the main thread uses either, loads on worker threads have their
+ * own arenas.
+ */
+arena_t mesh_arena;
+arena_t scratch_arena;
 
 double get_current_time() {
     struct timespec tp;
@@ -139,197 +113,140 @@ void get_texture_data(int texture_id) {
 
 object_t create_pyramid(float base_width, float height, GLuint texture_id) {
     object_t triangle = {
-        .position     = { .x = 0, .y = 0, .z = 0 },
-        .num_vertices = 4,
-        .num_indices  = 4,
-        .texture_id   = texture_id,
+        .position      = { .x = 0, .y = 0, .z = 0 },
+        .vertex_format = VERTEX_FORMAT_POSITION_UV,
+        .vertex_stride = get_vertex_stride(VERTEX_FORMAT_POSITION_UV),
+        .num_vertices  = 4,
+        .num_indices   = 4,
+        .index_type    = INDEX_TYPE_UINT16,
+        .texture_id    = texture_id,
     };
-    GLuint v_start = vertex_allocator.free_offset;
+    get_identity_matrix(triangle.model_matrix);
 
-    triangle.vertices = acquire_memory(&vertex_allocator, triangle.num_vertices);
-    triangle.indices  = acquire_memory(&index_allocator, triangle.num_indices);
-    triangle.texture_uvs   = acquire_memory(&texture_uv_allocator, triangle.num_vertices);
+    triangle.vertices = arena_alloc(&mesh_arena, triangle.num_vertices * triangle.vertex_stride * sizeof(GLfloat));
+    triangle.indices  = arena_alloc(&mesh_arena, get_object_indices_size(&triangle));
 
     /**
      * The first 3 values of each vector define the x, y, and z coordinate.
      * The 4th value is the homogenous coordinate, or w coordinate, and is included
      * so that we can do more types of matrix transforms(translation, etc). Its useful
-     * to have a constant value that we can multiply by.
+     * to have a constant value that we can multiply by. The texture UV follows, then
+     * padding out to the vertex stride.
      */
     GLfloat template_vertices[] = {
-        0.0f, 0.55f, 0.0f, 1.0f,     // Apex.
-        0.43f, -0.4f, 0.24f, 1.0f,    // Front Right.
-        -0.43f, -0.4f, 0.24f, 1.0f,   // Front Left.
-        0.0f, -0.4f, -0.5f, 1.0f,   // Back.
+        0.0f, 0.55f, 0.0f, 1.0f,      0.0f, 0.0f,   0.0f, 0.0f, // Apex.
+        0.43f, -0.4f, 0.24f, 1.0f,    1.0f, 0.0f,   0.0f, 0.0f, // Front Right.
+        -0.43f, -0.4f, 0.24f, 1.0f,   0.0f, 1.0f,   0.0f, 0.0f, // Front Left.
+        0.0f, -0.4f, -0.5f, 1.0f,     1.0f, 1.0f,   0.0f, 0.0f, // Back.
     };
     memcpy(triangle.vertices, template_vertices, sizeof(template_vertices));
 
-    GLuint template_indices[] = {
-        v_start + 0, v_start + 2, v_start + 1,
-        v_start + 0, v_start + 3, v_start + 2,
-        v_start + 0, v_start + 1, v_start + 3,
-        v_start + 1, v_start + 2, v_start + 3,
+    GLushort template_indices[] = {
+        0, 2, 1,
+        0, 3, 2,
+        0, 1, 3,
+        1, 2, 3,
     };
     memcpy(triangle.indices, template_indices, sizeof(template_indices));
-
-    GLfloat texture_uvs[] = {
-            0.0f, 0.0f,
-            1.0f, 0.0f,
-            0.0f, 1.0f,
-            1.0f, 1.0f,
-    };
-    memcpy(triangle.texture_uvs, texture_uvs, sizeof(texture_uvs));
+    compute_object_bounds(&triangle);
 
     return triangle;
 }
 
 object_t create_cube(float side_width, GLuint texture_id) {
     object_t cube = {
-            .position     = { .x = 0, .y = 0, .z = 0 },
-            .num_vertices = 8,
-            .num_indices  = 12,
-            .texture_id   = texture_id,
+            .position      = { .x = 0, .y = 0, .z = 0 },
+            .vertex_format = VERTEX_FORMAT_POSITION_UV,
+            .vertex_stride = get_vertex_stride(VERTEX_FORMAT_POSITION_UV),
+            .num_vertices  = 8,
+            .num_indices   = 12,
+            .index_type    = INDEX_TYPE_UINT16,
+            .texture_id    = texture_id,
     };
-    GLuint v_start = vertex_allocator.free_offset;
+    get_identity_matrix(cube.model_matrix);
 
-    cube.vertices = acquire_memory(&vertex_allocator, cube.num_vertices);
-    cube.indices  = acquire_memory(&index_allocator, cube.num_indices);
-    cube.texture_uvs   = acquire_memory(&texture_uv_allocator, cube.num_vertices);
+    cube.vertices = arena_alloc(&mesh_arena, cube.num_vertices * cube.vertex_stride * sizeof(GLfloat));
+    cube.indices  = arena_alloc(&mesh_arena, get_object_indices_size(&cube));
 
     /**
      * The first 3 values of each vector define the x, y, and z coordinate.
      * The 4th value is the homogenous coordinate, or w coordinate, and is included
      * so that we can do more types of matrix transforms(translation, etc). Its useful
-     * to have a constant value that we can multiply by.
+     * to have a constant value that we can multiply by. The texture UV follows, then
+     * padding out to the vertex stride.
      */
     float len = side_width / 2;
     GLfloat template_vertices[] = {
-            -len,  -len, -len, 1.0f,
-            len,   -len, -len, 1.0f,
-            len,   -len, len, 1.0f,
-            -len, -len, len, 1.0f,
-
-            -len, len, -len, 1.0f,
-            len,  len, -len, 1.0f,
-            len,  len, len,  1.0f,
-            -len, len, len,  1.0f,
+            -len,  -len, -len, 1.0f,   0.0f, 1.0f,   0.0f, 0.0f,
+            len,   -len, -len, 1.0f,   1.0f, 1.0f,   0.0f, 0.0f,
+            len,   -len, len, 1.0f,    0.0f, 0.0f,   0.0f, 0.0f,
+            -len, -len, len, 1.0f,     1.0f, 0.0f,   0.0f, 0.0f,
+
+            -len, len, -len, 1.0f,     1.0f, 0.0f,   0.0f, 0.0f,
+            len,  len, -len, 1.0f,     0.0f, 0.0f,   0.0f, 0.0f,
+            len,  len, len,  1.0f,     1.0f, 1.0f,   0.0f, 0.0f,
+            -len, len, len,  1.0f,     0.0f, 1.0f,   0.0f, 0.0f,
     };
     memcpy(cube.vertices, template_vertices, sizeof(template_vertices));
 
-    GLuint template_indices[] = {
-            v_start + 0, v_start + 1, v_start + 2,
-            v_start + 0, v_start + 2, v_start + 3,
+    GLushort template_indices[] = {
+            0, 1, 2,
+            0, 2, 3,
 
-            v_start + 1, v_start + 0, v_start + 4,
-            v_start + 1, v_start + 4, v_start + 5,
+            1, 0, 4,
+            1, 4, 5,
 
-            v_start + 2, v_start + 1, v_start + 5,
-            v_start + 2, v_start + 5, v_start + 6,
+            2, 1, 5,
+            2, 5, 6,
 
-            v_start + 3, v_start + 2, v_start + 7,
-            v_start + 2, v_start + 6, v_start + 7,
+            3, 2, 7,
+            2, 6, 7,
 
-            v_start + 3, v_start + 7, v_start + 4,
-            v_start + 3, v_start + 4, v_start + 0,
+            3, 7, 4,
+            3, 4, 0,
 
-            v_start + 4, v_start + 6, v_start + 5,
-            v_start + 4, v_start + 7, v_start + 6,
+            4, 6, 5,
+            4, 7, 6,
     };
     memcpy(cube.indices, template_indices, sizeof(template_indices));
-
-    GLfloat template_uvs[] = {
-            0.0f, 1.0f,
-            1.0f, 1.0f,
-            0.0f, 0.0f,
-            1.0f, 0.0f,
-
-            1.0f, 0.0f,
-            0.0f, 0.0f,
-            1.0f, 1.0f,
-            0.0f, 1.0f,
-    };
-    memcpy(cube.texture_uvs, template_uvs, sizeof(template_uvs));
+    compute_object_bounds(&cube);
 
     return cube;
 }
 
 object_t create_quad(float width, float height, GLuint texture_id) {
     object_t quad = {
-            .position     = { .x = 0, .y = 0, .z = 0 },
-            .num_vertices = 4,
-            .num_indices  = 2,
-            .texture_id   = texture_id,
+            .position      = { .x = 0, .y = 0, .z = 0 },
+            .vertex_format = VERTEX_FORMAT_POSITION_UV,
+            .vertex_stride = get_vertex_stride(VERTEX_FORMAT_POSITION_UV),
+            .num_vertices  = 4,
+            .num_indices   = 2,
+            .index_type    = INDEX_TYPE_UINT16,
+            .texture_id    = texture_id,
     };
-    GLuint v_start = vertex_allocator.free_offset;
+    get_identity_matrix(quad.model_matrix);
 
-    quad.vertices    = acquire_memory(&vertex_allocator, quad.num_vertices);
-    quad.indices     = acquire_memory(&index_allocator, quad.num_indices);
-    quad.texture_uvs = acquire_memory(&index_allocator, quad.num_vertices);
+    quad.vertices = arena_alloc(&mesh_arena, quad.num_vertices * quad.vertex_stride * sizeof(GLfloat));
+    quad.indices  = arena_alloc(&mesh_arena, get_object_indices_size(&quad));
 
     GLfloat template_vertices[] = {
-        -width / 2,  -height / 2, 0.0f, 1.0f,
-        width / 2,   -height / 2, 0.0f, 1.0f,
-        -width / 2,  height / 2, 0.0f, 1.0f,
-        width / 2,   height / 2, 0.0f, 1.0f,
+        -width / 2,  -height / 2, 0.0f, 1.0f,   0.0f, 1.0f,   0.0f, 0.0f,
+        width / 2,   -height / 2, 0.0f, 1.0f,   1.0f, 1.0f,   0.0f, 0.0f,
+        -width / 2,  height / 2, 0.0f, 1.0f,    0.0f, 0.0f,   0.0f, 0.0f,
+        width / 2,   height / 2, 0.0f, 1.0f,    1.0f, 0.0f,   0.0f, 0.0f,
     };
     memcpy(quad.vertices, template_vertices, sizeof(template_vertices));
 
-    GLuint template_indices[] = {
+    GLushort template_indices[] = {
         0, 2, 1,
         1, 2, 3,
     };
     memcpy(quad.indices, template_indices, sizeof(template_indices));
-
-    GLfloat texture_uvs[] = {
-            0.0f, 1.0f,
-            1.0f, 1.0f,
-            0.0f, 0.0f,
-            1.0f, 0.0f,
-    };
-    memcpy(quad.texture_uvs, texture_uvs, sizeof(texture_uvs));
+    compute_object_bounds(&quad);
 
     return quad;
 }
 
-void apply_matrix_transform(GLfloat* vertex_pointer, int num_vertices, float matrix[4][4]) {
-    for(int vertex_idx = 0; vertex_idx < num_vertices; vertex_idx++) {
-        int idx = vertex_idx * 4;
-
-        float result[4] = { 0, 0, 0, 0 };
-
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                result[i] += matrix[i][j] * vertex_pointer[idx + j];
-            }
-        }
-        for (int i = 0; i < 4; i++) {
-            vertex_pointer[idx + i] = result[i];
-        }
-    }
-}
-
-void get_y_rotation_matrix(float output[4][4], float theta) {
-    output[0][0] = cos(theta);  output[0][1] = 0; output[0][2] = sin(theta); output[0][3] = 0;
-    output[1][0] = 0;           output[1][1] = 1; output[1][2] = 0;          output[1][3] = 0;
-    output[2][0] = -sin(theta); output[2][1] = 0; output[2][2] = cos(theta); output[2][3] = 0;
-    // NOTE: We need to set w to 1 here to ensure we don't zero it for future operations.
-    output[3][0] = 0;           output[3][1] = 0; output[3][2] = 0;          output[3][3] = 1;
-}
-
-void get_x_rotation_matrix(float output[4][4], float theta) {
-    output[0][0] = 1; output[0][1] = 0;          output[0][2] = 0;           output[0][3] = 0;
-    output[1][0] = 0; output[1][1] = cos(theta); output[1][2] = -sin(theta); output[1][3] = 0;
-    output[2][0] = 0; output[2][1] = sin(theta); output[2][2] = cos(theta);  output[2][3] = 0;
-    output[3][0] = 0; output[3][1] = 0;          output[3][2] = 0;           output[3][3] = 1;
-}
-
-void get_translate_matrix(float output[4][4], float x_distance, float y_distance, float z_distance) {
-    output[0][0] = 1; output[0][1] = 0; output[0][2] = 0; output[0][3] = x_distance;
-    output[1][0] = 0; output[1][1] = 1; output[1][2] = 0; output[1][3] = y_distance;
-    output[2][0] = 0; output[2][1] = 0; output[2][2] = 1; output[2][3] = z_distance;
-    output[3][0] = 0; output[3][1] = 0; output[3][2] = 0; output[3][3] = 1;
-}
-
 vec3_t add_vectors(vec3_t vec1, vec3_t vec2) {
     vec3_t new_vec = {
         .x = vec1.x + vec2.x,
@@ -342,97 +259,41 @@ vec3_t add_vectors(vec3_t vec1, vec3_t vec2) {
 void translate_object(object_t* shape, vec3_t distance) {
     float translation_matrix[4][4];
     get_translate_matrix(translation_matrix, distance.x, distance.y, distance.z);
-    apply_matrix_transform(shape->vertices, shape->num_vertices, translation_matrix);
+    multiply_matrices(shape->model_matrix, translation_matrix, shape->model_matrix);
 
     shape->position = add_vectors(shape->position, distance);
 }
 
-void init_textures(byte* texture_image_data, size_t texture_image_size, GLuint* out_texture_id) {
-    // TODO: Use our own memory instead of STBI stuff.
-    // TODO: if we load into floats, or pass ints to opengl, we can directly use the loaded buffer to provide the texture.
-    int image_width, image_height, num_channels;
-    char* image_path = "/Users/jack/workspace/3d/models/cube_texture.png";
-    // char* image_path = "/Users/jack/workspace/3d/models/ship_texture.png";
-    // unsigned char* image_data = stbi_load(image_path, &image_width, &image_height, &num_channels, STBI_rgb_alpha);
-    byte* image_data = stbi_load_from_memory(texture_image_data, texture_image_size, &image_width, &image_height, &num_channels, STBI_rgb_alpha);
-    if(image_data == NULL) {
-        const char* error = stbi_failure_reason();
-        printf("Failed to load image: %s\n", error);
-        exit(-1);
-    }
-
-    printf("Loaded %dx%d image with %d num_channels.\n", image_width, image_height, num_channels);
-    GLfloat* texture_data = (GLfloat*)malloc(image_width * image_height * 4 * sizeof(GLfloat));
-    for (int pixel_idx = 0; pixel_idx < image_width * image_height; pixel_idx += 1) {
-        int texture_offset = pixel_idx * 4;
-        int image_offset = pixel_idx * 4;
-        texture_data[texture_offset+0] = image_data[image_offset + 0] / 255.0f;
-        texture_data[texture_offset+1] = image_data[image_offset + 1] / 255.0f;
-        texture_data[texture_offset+2] = image_data[image_offset + 2] / 255.0f;
-        texture_data[texture_offset+3] = image_data[image_offset + 3] / 255.0f;
-//        printf(
-//                "%d, %d, %d\n",
-//                image_data[image_offset+0],
-//                image_data[image_offset+1],
-//                image_data[image_offset+2]
-//        );
-//        printf(
-//                "%.3f, %.3f, %.3f, %.3f\n",
-//                texture_data[texture_offset+0],
-//                texture_data[texture_offset+1],
-//                texture_data[texture_offset+2],
-//                texture_data[texture_offset+3]
-//        );
-    }
-
-    stbi_image_free(image_data);
-
-    glGenTextures(1, out_texture_id);
-    glBindTexture(GL_TEXTURE_2D, *out_texture_id);
-
-    // Set wrapping properties(clamp just uses the edge pixel if we exceed the edge).
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // Set the filtering properties for sampling.
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-    glTexImage2D(
-            GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height,
-            0, GL_RGBA, GL_FLOAT, texture_data
-    );
+// Frames are drawn by whichever backend main picks, everything else goes through this.
+render_backend_t render_backend;
 
-    // Unbind the texture.
-    glBindTexture(GL_TEXTURE_2D, 0);
+// Shares meshes and textures between every object loaded from the same or identical files.
+resource_cache_t resource_cache;
 
-    free(texture_data);
-}
+// Loads models on worker threads while frames keep being drawn.
+asset_loader_t asset_loader;
 
 void rotate_object(object_t* shape, float rotation_matrix[4][4]) {
+    PROFILE_SCOPE("rotate_object");
+
     /**
      * All rotations happen around the origin so we need to translate back to the origin before rotating,
-     * and translate back to our position after rotating.
-     * TODO: Support multiple rotations at the origin without multiple translations in between. Oh actually might not
-     * be necessary if rotation matrices can be combined.
+     * and translate back to our position after rotating. These are all folded into the model matrix so the
+     * cost doesn't depend on how many vertices the object has.
      */
     vec3_t position = shape->position;
 
     float translation_matrix[4][4];
     get_translate_matrix(translation_matrix, -position.x, -position.y, -position.z);
-    apply_matrix_transform(shape->vertices, shape->num_vertices, translation_matrix);
+    multiply_matrices(shape->model_matrix, translation_matrix, shape->model_matrix);
 
-    apply_matrix_transform(shape->vertices, shape->num_vertices, rotation_matrix);
+    multiply_matrices(shape->model_matrix, rotation_matrix, shape->model_matrix);
 
     get_translate_matrix(translation_matrix, position.x, position.y, position.z);
-    apply_matrix_transform(shape->vertices, shape->num_vertices, translation_matrix);
+    multiply_matrices(shape->model_matrix, translation_matrix, shape->model_matrix);
 }
 
 
-GLuint shaderProgram;
-GLuint vertexShader;
-GLuint fragmentShader;
-
 GLuint model_texture;
 
 object_t pyramid;
@@ -441,30 +302,48 @@ object_t quad;
 object_t ship_model;
 object_t cube_model;
 
-GLuint gl_vertex_array_object;
-GLuint gl_vertex_buffer;
-GLuint gl_texture_uv_buffer;
+object_t* scene_objects[] = { &ship_model, &cube_model };
+#define NUM_SCENE_OBJECTS (int)(sizeof(scene_objects) / sizeof(scene_objects[0]))
 
-double total_time = 0;
+// Hand the scene to the backend again after models have finished loading, so it picks up their new meshes.
+void update_scene() {
+    render_backend.set_scene(&render_backend, scene_objects, NUM_SCENE_OBJECTS);
+    if(asset_loader.num_loads == 0) {
+        print_resource_cache_stats(&resource_cache);
+        print_arena_stats(&mesh_arena, "Mesh");
+        print_arena_stats(&scratch_arena, "Scratch");
+    }
 
-void display() {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Anything the backend needed while uploading new textures is done with now.
+    reset_arena(&scratch_arena);
+}
 
-    update_time_delta();
+double total_time = 0;
+
+/**
+ * Move everything on by time_delta and draw the scene with the render backend.
+ */
+void render_frame() {
+    PROFILE_SCOPE("render_frame");
     total_time += time_delta;
 
-    // TODO: Its probably better to apply all transforms to each vertex as we iterate instead of iterating multiple times.
-    float transform_matrix[4][4];
+    // Swap in any models that have finished loading since the last frame.
+    if(finish_asset_loads(&asset_loader) > 0) {
+        update_scene();
+    }
+
+    // Combine the x and y rotations so each object only needs to be rotated once.
+    transform_stack_t rotation;
 
-    get_x_rotation_matrix(transform_matrix, 0.63f * time_delta);
-    rotate_object(&ship_model, transform_matrix);
-    get_y_rotation_matrix(transform_matrix, 0.5 * time_delta);
-    rotate_object(&ship_model, transform_matrix);
+    transform_stack_init(&rotation);
+    transform_stack_rotate_x(&rotation, 0.63f * time_delta);
+    transform_stack_rotate_y(&rotation, 0.5 * time_delta);
+    rotate_object(&ship_model, transform_stack_top(&rotation));
 
-    get_x_rotation_matrix(transform_matrix, -0.63f * time_delta);
-    rotate_object(&cube_model, transform_matrix);
-    get_y_rotation_matrix(transform_matrix, -0.5 * time_delta);
-    rotate_object(&cube_model, transform_matrix);
+    transform_stack_init(&rotation);
+    transform_stack_rotate_x(&rotation, -0.63f * time_delta);
+    transform_stack_rotate_y(&rotation, -0.5 * time_delta);
+    rotate_object(&cube_model, transform_stack_top(&rotation));
 
 //    vec3_t distance = {.x = 0, .y = 0, .z = -0.1f * time_delta};
 //    translate_object(&ship_model, distance);
@@ -473,46 +352,7 @@ void display() {
 //    get_y_rotation_matrix(transform_matrix, -0.8f * time_delta);
 //    rotate_object(&pyramid, transform_matrix);
 
-//    printf("============\n\n");
-//    print_float_buffer(ship_model.vertices, ship_model.num_vertices * 3, 4);
-//    exit(-1);
-
-    // This code draws the shapes with a texture.
-
-    // Set the texture sampler for the shader. Because we're using GL_TEXTURE0 we set this to 0.
-    glActiveTexture(GL_TEXTURE0);
-    GLint textureLocation = glGetUniformLocation(shaderProgram, "textureSampler");
-    glUniform1i(textureLocation, 0);  // Set the value of the uniform variable to 0 (texture unit 0)
-
-    // Load the shapes texture.
-    glBindTexture(GL_TEXTURE_2D, ship_model.texture_id);
-
-    // Tell open GL to update the vertex and texture buffers with the new data.
-    // TODO: We only need to update vertices that have moved since last frame.
-    glBindBuffer(GL_ARRAY_BUFFER, gl_vertex_buffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, ship_model.num_vertices * 4 * sizeof(GLfloat), ship_model.vertices);
-
-    // TODO: I think its pretty unlikely for texture UVs to change for an existing shape, this probably doesn't need
-    // to happen each frame.
-    glBindBuffer(GL_ARRAY_BUFFER, gl_texture_uv_buffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, ship_model.num_vertices * 2 * sizeof(GLfloat), ship_model.texture_uvs);
-
-    // TODO: Because we're just drawing the quad here all of the indices start from 0, I think in the end these will
-    // need to go back to being relative to the entire vertex array.
-    glDrawElements(GL_TRIANGLES, ship_model.num_indices * 3, GL_UNSIGNED_INT, ship_model.indices);
-
-    /**
-     * TODO: Don't even bother factoring this duplication out into a function. We shouldn't do a draw call for
-     * each object we should ensure all of their data(texture UVs, vertices, etc) are in contiguous memory and
-     * do a single draw call. This probably means using an allocator in the object creation instead of separate
-     * mallocs.
-     */
-    glBindTexture(GL_TEXTURE_2D, cube_model.texture_id);
-    glBindBuffer(GL_ARRAY_BUFFER, gl_vertex_buffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, cube_model.num_vertices * 4 * sizeof(GLfloat), cube_model.vertices);
-    glBindBuffer(GL_ARRAY_BUFFER, gl_texture_uv_buffer);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, cube_model.num_vertices * 2 * sizeof(GLfloat), cube_model.texture_uvs);
-    glDrawElements(GL_TRIANGLES, cube_model.num_indices * 3, GL_UNSIGNED_INT, cube_model.indices);
+    render_backend.draw_frame(&render_backend);
 
 
 //    size_t num_indices = total_time;
@@ -524,241 +364,168 @@ void display() {
 //        }
 //    }
 //    printf("\n");
-
-
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
-    glutSwapBuffers();
-    glutPostRedisplay();
 }
 
-void load_shader_program() {
-    // Compile the vertex shader.
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    // Log and exit if the compilation failed.
-    int compile_success;
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &compile_success);
-    if (!compile_success) {
-        char infoLog[512];
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        printf("ERROR COMPILING VERTEX SHADER: %s\n", infoLog);
-        exit(1);
-    }
-
-    // Do the same for the fragment shader.
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    shaderProgram = glCreateProgram();
-
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &compile_success);
-    if (!compile_success) {
-        char infoLog[512];
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        printf("ERROR COMPILING FRAGMENT SHADER: %s\n", infoLog);
-        exit(1);
-    }
+#define FRAME_WIDTH 512
+#define FRAME_HEIGHT 512
+
+#ifdef HEADLESS
+// Headless frames step by a fixed amount of time so the same frame number always renders the same image.
+#define HEADLESS_FRAME_TIME (1.0 / 60.0)
+#define HEADLESS_DEFAULT_NUM_FRAMES 60
+
+/**
+ * Render num_frames frames without a window and write each one to output_directory as frame_<number>.png. The
+ * render time includes reading the frame back, as that's the only way to know the backend has finished it.
+ */
+void render_headless_frames(int num_frames, const char* output_directory) {
+    double render_time = 0;
+    double save_time = 0;
+    int total_drawn_objects = 0;
+    int total_culled_objects = 0;
+    double total_drawn_triangles = 0;
+    char frame_path[4096];
+    byte* pixels = malloc(render_backend.width * render_backend.height * 4);
+
+    time_delta = HEADLESS_FRAME_TIME;
+    for(int frame_idx = 0; frame_idx < num_frames; frame_idx++) {
+        double start_time = get_current_time();
+        render_frame();
+        render_backend.read_pixels(&render_backend, pixels);
+        end_profiler_frame();
+        double rendered_time = get_current_time();
+        total_drawn_objects += render_backend.num_drawn_objects;
+        total_culled_objects += render_backend.num_culled_objects;
+        total_drawn_triangles += render_backend.num_drawn_triangles;
+
+        snprintf(frame_path, sizeof(frame_path), "%s/frame_%04d.png", output_directory, frame_idx);
+        {
+            PROFILE_SCOPE("save_frame");
+            save_frame_png(frame_path, pixels, render_backend.width, render_backend.height);
+        }
 
-    // Attach the vertex and fragment shaders to the shader program.
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-
-    // Link and use the shader program.
-    glLinkProgram(shaderProgram);
-
-    // Log and exit if there was a problem with the linking.
-    int linkStatus;
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &linkStatus);
-    if (linkStatus != GL_TRUE) {
-        char infoLog[512];
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        printf("LINKING ERROR: %s\n", infoLog);
-        exit(1);
+        render_time += rendered_time - start_time;
+        save_time += get_current_time() - rendered_time;
     }
 
-    glUseProgram(shaderProgram);
+    printf(
+            "Rendered %d frames to %s with the %s backend, %.2fms per frame to render and %.2fms per frame to save.\n",
+            num_frames, output_directory, render_backend.name, render_time / num_frames, save_time / num_frames
+    );
+    printf(
+            "Drew %.1f objects with %.0f triangles and culled %.1f objects per frame.\n",
+            (double)total_drawn_objects / num_frames, total_drawn_triangles / num_frames,
+            (double)total_culled_objects / num_frames
+    );
+    free(pixels);
 }
+#else
+double last_title_update_time = 0;
 
-void load_object_from_gltf(char* model_file_path, object_t* object_out) {
-    object_t model;
-    model.position.x = 0;
-    model.position.y = 0;
-    model.position.z = 0;
-
-    // Read and parse model file.
-    FILE* file = fopen(model_file_path, "r");
-    if(!file) {
-        printf("Failed to open model file.");
-        exit(-1);
+// Show how long frames are taking in the title bar, only once a second so the numbers can be read.
+void update_window_title() {
+    if(last_frame_time - last_title_update_time < 1000) {
+        return;
     }
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    last_title_update_time = last_frame_time;
+
+    profiler_stats_t stats;
+    get_profiler_stats("render_frame", &stats);
+    char title[256];
+    snprintf(
+            title, sizeof(title),
+            "Jacks 3-Dimensional Wonderland - frame p50 %.2fms, p95 %.2fms, p99 %.2fms, %d objects drawn, %d culled, "
+            "%d triangles",
+            stats.p50, stats.p95, stats.p99, render_backend.num_drawn_objects, render_backend.num_culled_objects,
+            render_backend.num_drawn_triangles
+    );
+    glutSetWindowTitle(title);
+}
 
-    char *json_buffer = (char*)malloc(file_size);
+void display() {
+    update_time_delta();
+    render_frame();
 
-    size_t bytes_read = fread(json_buffer, 1, file_size, file);
-    if(bytes_read != file_size) {
-        printf("failed to read entire model file(%lu out of an expected %lu).\n", bytes_read, file_size);
-        exit(-1);
-    }
-    fclose(file);
+    glutSwapBuffers();
+    end_profiler_frame();
+    update_window_title();
+    glutPostRedisplay();
+}
+#endif
 
-    cJSON* json = cJSON_ParseWithLength(json_buffer, file_size);
-    if(!json) {
-        const char* error_str = cJSON_GetErrorPtr();
-        if(error_str != NULL) {
-            printf("Failed to parse model file: %s\n", error_str);
-        }
-        cJSON_Delete(json);
-        free(json_buffer);
-        exit(-1);
-    }
-    free(json_buffer);
-
-    cJSON* buffer_views  = cJSON_GetObjectItem(json, "bufferViews");
-
-    cJSON* vertex_buffer_view = cJSON_GetArrayItem(buffer_views, 0);
-    cJSON* vertex_data_offset_json = cJSON_GetObjectItem(vertex_buffer_view, "byteOffset");
-    cJSON* vertex_data_size_json = cJSON_GetObjectItem(vertex_buffer_view, "byteLength");
-    size_t vertex_data_offset = cJSON_GetNumberValue(vertex_data_offset_json);
-    size_t vertex_data_size = cJSON_GetNumberValue(vertex_data_size_json);
-
-    cJSON* uv_buffer_view = cJSON_GetArrayItem(buffer_views, 2);
-    cJSON* uv_data_offset_json = cJSON_GetObjectItem(uv_buffer_view, "byteOffset");
-    cJSON* uv_data_size_json = cJSON_GetObjectItem(uv_buffer_view, "byteLength");
-    size_t uv_data_offset = cJSON_GetNumberValue(uv_data_offset_json);
-
-    cJSON* index_buffer_view = cJSON_GetArrayItem(buffer_views, 3);
-    cJSON* index_data_offset_json = cJSON_GetObjectItem(index_buffer_view, "byteOffset");
-    cJSON* index_data_size_json = cJSON_GetObjectItem(index_buffer_view, "byteLength");
-    size_t index_data_offset = cJSON_GetNumberValue(index_data_offset_json);
-    size_t index_data_size = cJSON_GetNumberValue(index_data_size_json);
-
-
-    cJSON* model_images = cJSON_GetObjectItem(json, "images");
-    cJSON* model_image  = cJSON_GetArrayItem(model_images, 0);
-    cJSON* texture_uri_json = cJSON_GetObjectItem(model_image, "uri");
-    // Jankily remove the prefix TODO: properly interpret the base64 prefix.
-    byte* texture_uri_base64 = &cJSON_GetStringValue(texture_uri_json)[22];
-
-    size_t texture_data_size;
-    byte* texture_data = base64_decode(texture_uri_base64, strlen(texture_uri_base64), &texture_data_size);
-    if(texture_data == NULL) {
-        printf("Failed to parse model's texture data from base64.\n");
-        exit(-1);
-    }
-    init_textures(texture_data, texture_data_size, &model.texture_id);
-
-    // TODO: Check that the JSON structure is as expected as we go.
-    cJSON* model_buffers = cJSON_GetObjectItem(json, "buffers");
-    cJSON* model_buffer  = cJSON_GetArrayItem(model_buffers, 0);
-    cJSON* model_uri     = cJSON_GetObjectItem(model_buffer, "uri");
-    char* model_uri_base64 = cJSON_GetStringValue(model_uri);
-
-    size_t model_data_size;
-    // TODO: Skip the prefix a bit more robustly.
-    // TODO: I think the gltf tells us how big we can expect the output buffer to be. Use this to allocate up front?
-    char* model_data = base64_decode(&model_uri_base64[37], strlen(model_uri_base64) - 37, &model_data_size);
-    if(model_data == NULL) {
-        printf("Failed to parse model's base64 data.\n");
-        exit(-1);
-    }
-    cJSON_Delete(json);
+// Set with the PROFILER_TRACE environment variable to save every timing as a Chrome trace when the program exits.
+const char* profiler_trace_path = NULL;
 
-    /**
-     * Notes on parsing .gltf files correctly: The "buffers" define large portions of data that are accessed
-     * different ways for different things(vertices, texture UVs, etc). If we look in "meshes" we can see how
-     * to access the different attributes(POSITION=vertices, TEXCOORD=uvs, indices=indices, etc). Each attribute
-     * points to an "accessor". The accessor tells us how many items we can expect, what type the items
-     * are(5126=float, 5123=unsigned short, etc), etc. The accessors point to a "bufferView" which in turn tell
-     * us how to actually pull that type of data out of the big data buffer(offset, stride, length, etc).
-     *
-     * We should take all of this into account but I'm going to hardcode everything I can to start with. For example
-     * the offset and length values here are currently hardcoded from reading the gltf file with my human eyes.
-     */
-    printf("System float size: %lu\n", sizeof(GLfloat));
-    printf("System short size: %lu\n", sizeof(unsigned short));
-
-
-    size_t num_floats = vertex_data_size / sizeof(GLfloat);
-    model.num_vertices = num_floats / 3;
-    printf("%d vertices in model\n", model.num_vertices);
-    model.vertices = malloc(model.num_vertices * 4 * sizeof(GLfloat));
-    GLfloat* vertex_data = (GLfloat*)(model_data + vertex_data_offset);
-    for(int i = 0; i < model.num_vertices; i++) {
-        // The gltf format does not include the w property of the vector, so inputs
-        // have 3 values per vector and the output has 4 values per vector.
-        int input_idx = i * 3;
-        int output_idx = i * 4;
-        model.vertices[output_idx + 0] = vertex_data[input_idx + 0];
-        model.vertices[output_idx + 1] = vertex_data[input_idx + 1];
-        model.vertices[output_idx + 2] = vertex_data[input_idx + 2];
-        model.vertices[output_idx + 3] = 1.0f;
-    }
-//    print_float_buffer(model.vertices, model.num_vertices * 4, 4);
-//    printf("\n=======================\n");
-
-    model.texture_uvs = malloc(model.num_vertices * 2 * sizeof(GLfloat));
-    GLfloat* uv_data = (GLfloat*)(model_data + uv_data_offset);
-    for(int i = 0; i < model.num_vertices; i++) {
-        int uv_idx = i * 2;
-        model.texture_uvs[uv_idx + 0] = uv_data[uv_idx + 0];//0.625f;
-        model.texture_uvs[uv_idx + 1] = uv_data[uv_idx + 1];//0.125;
+void report_profile() {
+    print_profiler_summary();
+    if(profiler_trace_path != NULL) {
+        write_profiler_trace(profiler_trace_path);
     }
-//    print_float_buffer(model.texture_uvs, model.num_vertices * 2, 2);
-//    printf("\n=======================\n");
-
-
-    size_t num_shorts = index_data_size / sizeof(unsigned short);
-    model.num_indices = num_shorts / 3;
-    printf("%d indices in model\n", model.num_indices);
-    model.indices = malloc(num_shorts * sizeof(GLuint));
-    unsigned short* index_data = (unsigned short*)(model_data + index_data_offset);
-    for(int i = 0; i < num_shorts; i++) {
-        model.indices[i] = (GLuint)index_data[i];
-//        printf("%d:%d, ", model.indices[i], (GLuint)index_data[i]);
-    }
-//    printf("\n");
-
-    free(model_data);
-
-    *object_out = model;
 }
 
 int main(int argc, char** argv) {
     last_frame_time = get_current_time();
-
+    profiler_trace_path = getenv("PROFILER_TRACE");
+    atexit(report_profile);
+
+    // Most of the arenas memory goes to vertices so align to cache lines, which keeps every vertex in a single line.
+    init_arena(&mesh_arena, 4 * 1024 * 1024, 64);
+    init_arena(&scratch_arena, 16 * 1024 * 1024, 16);
+
+#ifdef HEADLESS
+    // Usage: main [number of frames] [output directory] [gl|cpu]
+    int num_frames = argc > 1 ? atoi(argv[1]) : HEADLESS_DEFAULT_NUM_FRAMES;
+    const char* output_directory = argc > 2 ? argv[2] : ".";
+    const char* backend_name = argc > 3 ? argv[3] : "gl";
+
+    // The CPU backend doesn't need OpenGL at all, so only make a context for the OpenGL one.
+    headless_context_t headless_context;
+    thread_pool_t* thread_pool = NULL;
+    if(strcmp(backend_name, "cpu") == 0) {
+        thread_pool = create_thread_pool(0);
+        create_raster_backend(&render_backend, FRAME_WIDTH, FRAME_HEIGHT, thread_pool);
+    } else if(strcmp(backend_name, "gl") == 0) {
+        create_headless_context(&headless_context, FRAME_WIDTH, FRAME_HEIGHT);
+        create_gl_backend(&render_backend, FRAME_WIDTH, FRAME_HEIGHT, &scratch_arena);
+    } else {
+        printf("Unknown render backend %s, expected gl or cpu.\n", backend_name);
+        exit(-1);
+    }
+#else
     glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
+    glutInitWindowSize(FRAME_WIDTH, FRAME_HEIGHT);
     glutCreateWindow("Jacks 3-Dimensional Wonderland");
     glutDisplayFunc(display);
 
-    // This enables z-buffering so pixels are occluded based on depth.
-    glEnable(GLUT_DOUBLE| GL_DEPTH_TEST);
+    create_gl_backend(&render_backend, FRAME_WIDTH, FRAME_HEIGHT, &scratch_arena);
+#endif
 
-    // Enable backface culling and set the winding order to counter clockwise.
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    glFrontFace(GL_CCW);
-
-    const char* version = (const char*)glGetString(GL_VERSION);
-    int major, minor;
-    sscanf(version, "%d.%d", &major, &minor);
-    printf("OpenGL version supported by your graphics card: %s\n", version);
-
-    load_shader_program();
-
-    load_object_from_gltf("/Users/jack/workspace/3d/models/ship_model.gltf", &ship_model);
-    load_object_from_gltf("/Users/jack/workspace/3d/models/cube.gltf", &cube_model);
-
-    // TODO: Should really only need a single allocator.
-    vertex_allocator     = new_allocator(sizeof(GLfloat) * 4, 1024);
-    index_allocator      = new_allocator(sizeof(GLuint) * 3, 1024);
-    texture_uv_allocator = new_allocator(sizeof(GLfloat) * 3, 1024);
+    // Setting TEXTURE_CACHE to a directory compresses textures to BC1 and keeps the compressed versions there.
+    const char* texture_cache_directory = getenv("TEXTURE_CACHE");
+    if(texture_cache_directory != NULL && strcmp(render_backend.name, "gl") == 0) {
+        enable_gl_texture_compression(&render_backend, texture_cache_directory);
+    }
+    // Setting QUANTIZE_VERTICES uploads vertices as 16 bit integers, which takes less than half the GPU memory.
+    if(getenv("QUANTIZE_VERTICES") != NULL && strcmp(render_backend.name, "gl") == 0) {
+        enable_gl_vertex_quantization(&render_backend);
+    }
+    init_resource_cache(&resource_cache, &mesh_arena, &render_backend);
+    init_asset_loader(&asset_loader, 0, &resource_cache, &render_backend);
+
+    // Objects are drawn as plain grey cubes until their models have loaded.
+    byte placeholder_pixels[] = { 128, 128, 128, 255 };
+    GLuint placeholder_texture = render_backend.create_texture(&render_backend, placeholder_pixels, 1, 1);
+    object_t placeholder = create_cube(0.5f, placeholder_texture);
+    ship_model = placeholder;
+    cube_model = placeholder;
+
+    load_object_async(
+            &asset_loader, "/Users/jack/workspace/3d/models/ship_model.gltf", VERTEX_FORMAT_POSITION_UV, &ship_model
+    );
+    load_object_async(
+            &asset_loader, "/Users/jack/workspace/3d/models/cube.gltf", VERTEX_FORMAT_POSITION_UV, &cube_model
+    );
 
 //    pyramid1 = create_pyramid(0, 0, model_texture);
 //    pyramid = create_pyramid(0, 0);
@@ -777,30 +544,29 @@ int main(int argc, char** argv) {
 //    distance.y = 0.5;
 //    translate_object(&cube, distance);
 
-    // Create a vertex array object that we can use for assigning the vertex attribute arrays.
-    glGenVertexArraysAPPLE(1, &gl_vertex_array_object);
-    glBindVertexArrayAPPLE(gl_vertex_array_object);
-
-    // TODO: Pretty sure this is allocating on every draw! Fix immediately!
-    // Setup the json_buffer for storing vertex data and assign it to the appropriate input in the shader.
-    glGenBuffers(1, &gl_vertex_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, gl_vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, ship_model.num_vertices * 4 * sizeof(GLfloat), ship_model.vertices, GL_STATIC_DRAW);
-    GLint posAttrib = glGetAttribLocation(shaderProgram, "aPos");
-    glEnableVertexAttribArray(posAttrib);
-    glVertexAttribPointer(posAttrib, 4, GL_FLOAT, GL_FALSE, 0, 0);
-
-    // Do the same but for the texture UVs.
-    glGenBuffers(1, &gl_texture_uv_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, gl_texture_uv_buffer);
-    glBufferData(GL_ARRAY_BUFFER, ship_model.num_vertices * 2 * sizeof(GLfloat), ship_model.texture_uvs, GL_STATIC_DRAW);
-    GLint texAttrib = glGetAttribLocation(shaderProgram, "aTexCoord");
-    glEnableVertexAttribArray(texAttrib);
-    glVertexAttribPointer(texAttrib, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-
+    render_backend.set_scene(&render_backend, scene_objects, NUM_SCENE_OBJECTS);
 
+#ifdef HEADLESS
+    // Windows draw placeholders while models load, but headless frames wait so every run saves the same frames.
+    if(wait_for_asset_loads(&asset_loader) > 0) {
+        update_scene();
+    }
+    render_headless_frames(num_frames, output_directory);
+    free_asset_loader(&asset_loader);
+    for(int i = 0; i < NUM_SCENE_OBJECTS; i++) {
+        release_object_resources(&resource_cache, scene_objects[i]);
+    }
+    render_backend.destroy_texture(&render_backend, placeholder_texture);
+    free_resource_cache(&resource_cache);
+    render_backend.destroy(&render_backend);
+    if(thread_pool != NULL) {
+        destroy_thread_pool(thread_pool);
+    } else {
+        destroy_headless_context(&headless_context);
+    }
+#else
     glutMainLoop();
+#endif
 
     return 0;
 }
@@ -0,0 +1,50 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int map_file(const char* file_path, mapped_file_t* mapped_file_out) {
+    mapped_file_out->data = NULL;
+    mapped_file_out->size = 0;
+
+    int file = open(file_path, O_RDONLY);
+    if(file == -1) {
+        return 0;
+    }
+
+    struct stat file_stat;
+    if(fstat(file, &file_stat) == -1) {
+        close(file);
+        return 0;
+    }
+
+    // mmap doesn't allow empty mappings, but an empty file is still a valid file.
+    if(file_stat.st_size == 0) {
+        close(file);
+        return 1;
+    }
+
+    void* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping keeps its own reference to the file so we don't need the descriptor any more.
+    close(file);
+    if(data == MAP_FAILED) {
+        return 0;
+    }
+
+    // Loaders mostly read front to back so let the OS read ahead aggressively.
+    madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+
+    mapped_file_out->data = data;
+    mapped_file_out->size = file_stat.st_size;
+    return 1;
+}
+
+void unmap_file(mapped_file_t* mapped_file) {
+    if(mapped_file->data != NULL) {
+        munmap(mapped_file->data, mapped_file->size);
+    }
+    mapped_file->data = NULL;
+    mapped_file->size = 0;
+}
@@ -0,0 +1,19 @@
+#ifndef INC_3D_MAPPED_FILE_H
+#define INC_3D_MAPPED_FILE_H
+
+#include <stddef.h>
+
+/**
+ * A read only view of a whole file through mmap. Nothing is read up front, pages are loaded by the OS as they are
+ * touched, so large files cost roughly what is actually used from them.
+ */
+typedef struct {
+    unsigned char* data;
+    size_t size;
+} mapped_file_t;
+
+// Returns 0 if the file couldn't be opened or mapped.
+int map_file(const char* file_path, mapped_file_t* mapped_file_out);
+void unmap_file(mapped_file_t* mapped_file);
+
+#endif //INC_3D_MAPPED_FILE_H
@@ -0,0 +1,273 @@
+#include "mesh_optimizer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../profiler/profiler.h"
+
+// The number of floats at the start of each vertex that hold attributes, the rest is padding.
+static int get_vertex_attribute_size(vertex_format_t format) {
+    return format == VERTEX_FORMAT_POSITION_UV_NORMAL ? VERTEX_NORMAL_OFFSET + 3 : VERTEX_TEXTURE_UV_OFFSET + 2;
+}
+
+static uint32_t hash_vertex(const GLfloat* vertex, int num_floats) {
+    uint32_t hash = 2166136261u;
+    for(int i = 0; i < num_floats; i++) {
+        // Adding zero turns -0 into 0, so the two hash the same as well as comparing the same.
+        GLfloat value = vertex[i] + 0.0f;
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        hash = (hash ^ bits) * 16777619u;
+    }
+    // Only the low bits pick a slot, so mix the high ones down into them.
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+static int are_vertices_equal(const GLfloat* a, const GLfloat* b, int num_floats) {
+    for(int i = 0; i < num_floats; i++) {
+        if(a[i] != b[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Merge vertices with identical attributes, moving the first of each to the front of the vertices in the order they
+ * come. remap_out gets where each old vertex ended up. Returns how many are left.
+ */
+static int weld_vertices(object_t* object, int* remap_out) {
+    int stride = object->vertex_stride;
+    int num_floats = get_vertex_attribute_size(object->vertex_format);
+
+    // An open addressing table of the vertices kept so far, at most half full.
+    int table_size = 1;
+    while(table_size < object->num_vertices * 2) {
+        table_size *= 2;
+    }
+    int* table = malloc(table_size * sizeof(int));
+    memset(table, -1, table_size * sizeof(int));
+
+    int num_welded = 0;
+    for(int vertex_idx = 0; vertex_idx < object->num_vertices; vertex_idx++) {
+        GLfloat* vertex = &object->vertices[vertex_idx * stride];
+        uint32_t slot = hash_vertex(vertex, num_floats) & (table_size - 1);
+        while(table[slot] != -1 && !are_vertices_equal(&object->vertices[table[slot] * stride], vertex, num_floats)) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if(table[slot] == -1) {
+            // Kept vertices are never ahead of the one being read, so they can be moved down in place.
+            table[slot] = num_welded;
+            memmove(&object->vertices[num_welded * stride], vertex, stride * sizeof(GLfloat));
+            num_welded++;
+        }
+        remap_out[vertex_idx] = table[slot];
+    }
+
+    free(table);
+    return num_welded;
+}
+
+// Simulate a FIFO cache over a run of triangles, returning how many vertices missed it.
+static int count_cache_misses(const GLuint* indices, int num_triangles, int num_vertices) {
+    /**
+     * When each vertex last went into the cache, counted in misses. It has been pushed out once the cache is full of
+     * vertices that went in after it.
+     */
+    int* cache_times = malloc(num_vertices * sizeof(int));
+    for(int i = 0; i < num_vertices; i++) {
+        cache_times[i] = -VERTEX_CACHE_SIZE - 1;
+    }
+    int num_misses = 0;
+    for(int i = 0; i < num_triangles * 3; i++) {
+        if(num_misses - cache_times[indices[i]] >= VERTEX_CACHE_SIZE) {
+            cache_times[indices[i]] = num_misses++;
+        }
+    }
+    free(cache_times);
+    return num_misses;
+}
+
+/**
+ * Tipsify, from Sander, Nehab and Barczak's "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+ * It fans out around one vertex at a time, emitting all of its triangles, then moves on to whichever neighbour that
+ * was just used will still be in the cache once its own triangles are emitted. When no neighbour has triangles left
+ * it goes back to the most recently used vertex that does, and failing that the next one in the mesh.
+ */
+static void reorder_triangles(const GLuint* indices, int num_triangles, int num_vertices, GLuint* indices_out) {
+    // The triangles around each vertex in one array, with how many of them are still to be emitted.
+    int* vertex_triangle_offsets = calloc(num_vertices + 1, sizeof(int));
+    for(int i = 0; i < num_triangles * 3; i++) {
+        vertex_triangle_offsets[indices[i] + 1]++;
+    }
+    int* live_triangles = malloc(num_vertices * sizeof(int));
+    for(int vertex_idx = 0; vertex_idx < num_vertices; vertex_idx++) {
+        live_triangles[vertex_idx] = vertex_triangle_offsets[vertex_idx + 1];
+        vertex_triangle_offsets[vertex_idx + 1] += vertex_triangle_offsets[vertex_idx];
+    }
+    int* vertex_triangles = malloc(num_triangles * 3 * sizeof(int));
+    int* fill_offsets = malloc(num_vertices * sizeof(int));
+    memcpy(fill_offsets, vertex_triangle_offsets, num_vertices * sizeof(int));
+    for(int i = 0; i < num_triangles * 3; i++) {
+        vertex_triangles[fill_offsets[indices[i]]++] = i / 3;
+    }
+    free(fill_offsets);
+
+    // Time is counted in cache misses, starting late enough that nothing is in the cache yet.
+    int* cache_times = calloc(num_vertices, sizeof(int));
+    int time = VERTEX_CACHE_SIZE + 1;
+    byte* is_emitted = calloc(num_triangles, 1);
+    int* dead_ends = malloc(num_triangles * 3 * sizeof(int));
+    int num_dead_ends = 0;
+    int next_unvisited = 0;
+    int num_emitted = 0;
+
+    int fan_vertex = num_vertices > 0 ? 0 : -1;
+    while(fan_vertex >= 0) {
+        int first_emitted = num_emitted;
+        for(int i = vertex_triangle_offsets[fan_vertex]; i < vertex_triangle_offsets[fan_vertex + 1]; i++) {
+            int triangle_idx = vertex_triangles[i];
+            if(is_emitted[triangle_idx]) {
+                continue;
+            }
+            is_emitted[triangle_idx] = 1;
+            for(int corner = 0; corner < 3; corner++) {
+                GLuint vertex_idx = indices[triangle_idx * 3 + corner];
+                indices_out[num_emitted * 3 + corner] = vertex_idx;
+                dead_ends[num_dead_ends++] = (int)vertex_idx;
+                live_triangles[vertex_idx]--;
+                if(time - cache_times[vertex_idx] > VERTEX_CACHE_SIZE) {
+                    cache_times[vertex_idx] = time++;
+                }
+            }
+            num_emitted++;
+        }
+
+        /**
+         * Prefer the neighbour that went into the cache longest ago, as long as fanning around it won't push it back
+         * out. Each of its remaining triangles can add up to two new vertices.
+         */
+        int best_vertex = -1;
+        int best_priority = -1;
+        for(int i = first_emitted * 3; i < num_emitted * 3; i++) {
+            GLuint vertex_idx = indices_out[i];
+            if(live_triangles[vertex_idx] == 0) {
+                continue;
+            }
+            int priority = 0;
+            if(time - cache_times[vertex_idx] + 2 * live_triangles[vertex_idx] <= VERTEX_CACHE_SIZE) {
+                priority = time - cache_times[vertex_idx];
+            }
+            if(priority > best_priority) {
+                best_vertex = (int)vertex_idx;
+                best_priority = priority;
+            }
+        }
+        while(best_vertex == -1 && num_dead_ends > 0) {
+            int vertex_idx = dead_ends[--num_dead_ends];
+            if(live_triangles[vertex_idx] > 0) {
+                best_vertex = vertex_idx;
+            }
+        }
+        while(best_vertex == -1 && next_unvisited < num_vertices) {
+            if(live_triangles[next_unvisited] > 0) {
+                best_vertex = next_unvisited;
+            }
+            next_unvisited++;
+        }
+        fan_vertex = best_vertex;
+    }
+
+    free(vertex_triangle_offsets);
+    free(live_triangles);
+    free(vertex_triangles);
+    free(cache_times);
+    free(is_emitted);
+    free(dead_ends);
+}
+
+float get_object_acmr(object_t* object) {
+    if(object->num_indices == 0) {
+        return 0;
+    }
+    GLuint* indices = malloc(object->num_indices * 3 * sizeof(GLuint));
+    for(int i = 0; i < object->num_indices * 3; i++) {
+        indices[i] = get_object_index(object, i);
+    }
+    float acmr = (float)count_cache_misses(indices, object->num_indices, object->num_vertices) / object->num_indices;
+    free(indices);
+    return acmr;
+}
+
+void optimize_object_mesh(object_t* object, arena_t* arena) {
+    PROFILE_SCOPE("optimize_mesh");
+    if(object->num_indices == 0) {
+        return;
+    }
+    int num_vertices = object->num_vertices;
+    float acmr_before = get_object_acmr(object);
+    int total_indices = get_object_total_indices(object) * 3;
+    GLuint* indices = malloc(total_indices * sizeof(GLuint));
+    for(int i = 0; i < total_indices; i++) {
+        indices[i] = get_object_index(object, i);
+    }
+
+    int* remap = malloc(num_vertices * sizeof(int));
+    int num_welded = weld_vertices(object, remap);
+    for(int i = 0; i < total_indices; i++) {
+        indices[i] = remap[indices[i]];
+    }
+
+    // Only the full detail triangles are reordered, any levels of detail after them keep their order.
+    GLuint* reordered = malloc(total_indices * sizeof(GLuint));
+    reorder_triangles(indices, object->num_indices, num_welded, reordered);
+    memcpy(
+            &reordered[object->num_indices * 3], &indices[object->num_indices * 3],
+            (total_indices - object->num_indices * 3) * sizeof(GLuint)
+    );
+
+    // Number the vertices in the order the triangles first use them, which drops any no triangle uses.
+    memset(remap, -1, num_welded * sizeof(int));
+    int num_used = 0;
+    for(int i = 0; i < total_indices; i++) {
+        if(remap[reordered[i]] == -1) {
+            remap[reordered[i]] = num_used++;
+        }
+        reordered[i] = remap[reordered[i]];
+    }
+    int stride = object->vertex_stride;
+    GLfloat* welded_vertices = malloc(num_welded * stride * sizeof(GLfloat));
+    memcpy(welded_vertices, object->vertices, num_welded * stride * sizeof(GLfloat));
+    for(int vertex_idx = 0; vertex_idx < num_welded; vertex_idx++) {
+        if(remap[vertex_idx] != -1) {
+            memcpy(
+                    &object->vertices[remap[vertex_idx] * stride], &welded_vertices[vertex_idx * stride],
+                    stride * sizeof(GLfloat)
+            );
+        }
+    }
+    object->num_vertices = num_used;
+
+    object->index_type = get_index_type(num_used);
+    object->indices = arena_alloc(arena, get_object_indices_size(object));
+    for(int i = 0; i < total_indices; i++) {
+        set_object_index(object, i, reordered[i]);
+    }
+    compute_object_bounds(object);
+
+    float acmr_after = get_object_acmr(object);
+    printf(
+            "Optimized a mesh with %d triangles, welded %d vertices into %d, ACMR went from %.3f to %.3f.\n",
+            object->num_indices, num_vertices, num_used, acmr_before, acmr_after
+    );
+
+    free(indices);
+    free(remap);
+    free(reordered);
+    free(welded_vertices);
+}
@@ -0,0 +1,33 @@
+#ifndef INC_3D_MESH_OPTIMIZER_H
+#define INC_3D_MESH_OPTIMIZER_H
+
+#include "../arena/arena.h"
+#include "../object/object.h"
+
+/**
+ * How many transformed vertices the GPU is assumed to keep around for reuse. Real caches vary, but orders that do
+ * well with a small FIFO do well with bigger ones too.
+ */
+#define VERTEX_CACHE_SIZE 16
+
+/**
+ * Get ready to draw a freshly loaded mesh quickly, in three steps:
+ * - Vertices with the same position and UV, and normal for formats that have one, are welded into one, since
+ *   exporters often repeat them for every triangle or primitive that uses them.
+ * - Triangles are reordered with Tipsify so that each one mostly reuses vertices the GPU has just transformed.
+ * - Vertices are reordered into the order the triangles first use them, so fetching them walks through memory.
+ *
+ * The objects indices are replaced with a copy in the arena, which is 16 bit if welding brought the vertices down
+ * far enough, and its vertices are rewritten in place. Prints the ACMR before and after. This should run before
+ * generate_object_lods(), so the levels of detail start from the welded mesh and are stored after the reordered one.
+ */
+void optimize_object_mesh(object_t* object, arena_t* arena);
+
+/**
+ * The average cache miss ratio of the full detail mesh, how many vertices have to be transformed per triangle with a
+ * FIFO cache of VERTEX_CACHE_SIZE vertices. 3 means no vertex is ever reused, and well ordered meshes get down to
+ * around 0.6 to 0.7.
+ */
+float get_object_acmr(object_t* object);
+
+#endif //INC_3D_MESH_OPTIMIZER_H
@@ -0,0 +1,143 @@
+#include "object.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+int get_vertex_stride(vertex_format_t format) {
+    switch(format) {
+        case VERTEX_FORMAT_POSITION_UV_NORMAL:
+            return 12;
+        case VERTEX_FORMAT_POSITION_UV:
+        default:
+            return 8;
+    }
+}
+
+index_type_t get_index_type(int num_vertices) {
+    return num_vertices <= MAX_UINT16_INDEX_VERTICES ? INDEX_TYPE_UINT16 : INDEX_TYPE_UINT32;
+}
+
+size_t get_index_size(index_type_t index_type) {
+    return index_type == INDEX_TYPE_UINT16 ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+GLenum get_gl_index_type(index_type_t index_type) {
+    return index_type == INDEX_TYPE_UINT16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+GLuint get_object_index(object_t* object, int index_idx) {
+    if(object->index_type == INDEX_TYPE_UINT16) {
+        return ((GLushort*)object->indices)[index_idx];
+    }
+    return ((GLuint*)object->indices)[index_idx];
+}
+
+void set_object_index(object_t* object, int index_idx, GLuint index) {
+    if(object->index_type == INDEX_TYPE_UINT16) {
+        ((GLushort*)object->indices)[index_idx] = (GLushort)index;
+    } else {
+        ((GLuint*)object->indices)[index_idx] = index;
+    }
+}
+
+object_lod_t get_object_lod(object_t* object, int level) {
+    if(level == 0 || object->num_lods == 0) {
+        return (object_lod_t){ .first_index = 0, .num_indices = object->num_indices, .error = 0 };
+    }
+    return object->lods[level - 1];
+}
+
+int get_object_total_indices(object_t* object) {
+    if(object->num_lods == 0) {
+        return object->num_indices;
+    }
+    object_lod_t* last_lod = &object->lods[object->num_lods - 1];
+    return last_lod->first_index + last_lod->num_indices;
+}
+
+size_t get_object_indices_size(object_t* object) {
+    return (size_t)get_object_total_indices(object) * 3 * get_index_size(object->index_type);
+}
+
+int get_object_num_instances(object_t* object) {
+    return object->instance_matrices != NULL ? object->num_instances : 1;
+}
+
+float (*get_instance_matrix(object_t* object, int instance_idx))[4] {
+    return object->instance_matrices != NULL ? object->instance_matrices[instance_idx] : object->model_matrix;
+}
+
+void compute_object_bounds(object_t* object) {
+    bounds_t bounds = { 0 };
+    if(object->num_vertices > 0) {
+        GLfloat* position = &object->vertices[VERTEX_POSITION_OFFSET];
+        bounds.min = (vec3_t){ position[0], position[1], position[2] };
+        bounds.max = bounds.min;
+    }
+    for(int i = 1; i < object->num_vertices; i++) {
+        GLfloat* position = &object->vertices[i * object->vertex_stride + VERTEX_POSITION_OFFSET];
+        bounds.min.x = fminf(bounds.min.x, position[0]);
+        bounds.min.y = fminf(bounds.min.y, position[1]);
+        bounds.min.z = fminf(bounds.min.z, position[2]);
+        bounds.max.x = fmaxf(bounds.max.x, position[0]);
+        bounds.max.y = fmaxf(bounds.max.y, position[1]);
+        bounds.max.z = fmaxf(bounds.max.z, position[2]);
+    }
+
+    bounds.center.x = (bounds.min.x + bounds.max.x) / 2;
+    bounds.center.y = (bounds.min.y + bounds.max.y) / 2;
+    bounds.center.z = (bounds.min.z + bounds.max.z) / 2;
+    float max_distance_squared = 0;
+    for(int i = 0; i < object->num_vertices; i++) {
+        GLfloat* position = &object->vertices[i * object->vertex_stride + VERTEX_POSITION_OFFSET];
+        float x = position[0] - bounds.center.x;
+        float y = position[1] - bounds.center.y;
+        float z = position[2] - bounds.center.z;
+        max_distance_squared = fmaxf(max_distance_squared, x * x + y * y + z * z);
+    }
+    bounds.radius = sqrtf(max_distance_squared);
+
+    object->bounds = bounds;
+}
+
+static GLshort quantize_position(float value, float min, float extent) {
+    if(extent <= 0) {
+        return INT16_MIN;
+    }
+    long steps = lroundf((value - min) / extent * QUANTIZED_POSITION_STEPS);
+    return (GLshort)(fminf(fmaxf((float)steps, 0), QUANTIZED_POSITION_STEPS) + INT16_MIN);
+}
+
+static GLushort quantize_texture_uv(float value) {
+    return (GLushort)lroundf(fminf(fmaxf(value, 0), 1) * UINT16_MAX);
+}
+
+void quantize_object_vertices(object_t* object, quantized_vertex_t* vertices_out, float dequantize_matrix_out[4][4]) {
+    vec3_t min = object->bounds.min;
+    vec3_t extent = {
+        object->bounds.max.x - min.x, object->bounds.max.y - min.y, object->bounds.max.z - min.z
+    };
+    for(int i = 0; i < object->num_vertices; i++) {
+        GLfloat* vertex = &object->vertices[i * object->vertex_stride];
+        quantized_vertex_t* out = &vertices_out[i];
+        out->position[0] = quantize_position(vertex[VERTEX_POSITION_OFFSET + 0], min.x, extent.x);
+        out->position[1] = quantize_position(vertex[VERTEX_POSITION_OFFSET + 1], min.y, extent.y);
+        out->position[2] = quantize_position(vertex[VERTEX_POSITION_OFFSET + 2], min.z, extent.z);
+        out->position[3] = 0;
+        out->texture_uv[0] = quantize_texture_uv(vertex[VERTEX_TEXTURE_UV_OFFSET + 0]);
+        out->texture_uv[1] = quantize_texture_uv(vertex[VERTEX_TEXTURE_UV_OFFSET + 1]);
+    }
+
+    // Positions are stored offset by INT16_MIN so the whole range is used, which the translation takes back off.
+    float steps[3] = {
+        extent.x / QUANTIZED_POSITION_STEPS, extent.y / QUANTIZED_POSITION_STEPS, extent.z / QUANTIZED_POSITION_STEPS
+    };
+    float mins[3] = { min.x, min.y, min.z };
+    memset(dequantize_matrix_out, 0, sizeof(float[4][4]));
+    for(int axis = 0; axis < 3; axis++) {
+        dequantize_matrix_out[axis][axis] = steps[axis];
+        dequantize_matrix_out[axis][3] = mins[axis] - INT16_MIN * steps[axis];
+    }
+    dequantize_matrix_out[3][3] = 1;
+}
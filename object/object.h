@@ -0,0 +1,163 @@
+#ifndef INC_3D_OBJECT_H
+#define INC_3D_OBJECT_H
+
+#include <stddef.h>
+
+#include "../gl/gl.h"
+
+typedef unsigned char byte;
+
+typedef struct {
+    float x;
+    float y;
+    float z;
+} vec3_t;
+
+/**
+ * Vertices are interleaved so that everything needed to draw a vertex sits next to each other in memory instead
+ * of being fetched from a separate array for each attribute. Each vertex starts with its xyzw position followed
+ * by its texture UV and, for formats that have one, its normal. Vertices are padded to a multiple of 16 bytes so
+ * positions stay aligned for the SIMD transforms, which also makes a position and UV vertex exactly 32 bytes so
+ * it never straddles two cache lines. The batcher keeps the objects index in the last float of the padding.
+ */
+typedef enum {
+    VERTEX_FORMAT_POSITION_UV,
+    VERTEX_FORMAT_POSITION_UV_NORMAL,
+} vertex_format_t;
+
+// Offsets of each attribute within a vertex, in floats.
+#define VERTEX_POSITION_OFFSET 0
+#define VERTEX_TEXTURE_UV_OFFSET 4
+#define VERTEX_NORMAL_OFFSET 6
+
+// The number of floats between the start of one vertex and the next.
+int get_vertex_stride(vertex_format_t format);
+
+/**
+ * An axis aligned box and a sphere around every vertex of a mesh, in model space. The box is tighter for long thin
+ * meshes and the sphere for round ones or ones that are rotated, so culling checks both.
+ */
+typedef struct {
+    vec3_t min;
+    vec3_t max;
+    vec3_t center;
+    float radius;
+} bounds_t;
+
+/**
+ * Indices are 16 bit whenever every vertex of the mesh can be reached with one, which halves the memory they take
+ * and the bandwidth the GPU spends reading them. Only meshes with more vertices than that need 32 bit indices.
+ * 32 bit comes first so objects that don't set an index type get GLuint indices.
+ */
+typedef enum {
+    INDEX_TYPE_UINT32,
+    INDEX_TYPE_UINT16,
+} index_type_t;
+
+// The largest number of vertices that 16 bit indices can reach.
+#define MAX_UINT16_INDEX_VERTICES 65536
+
+// The smallest index type that can reach every one of the vertices.
+index_type_t get_index_type(int num_vertices);
+// The number of bytes in each index.
+size_t get_index_size(index_type_t index_type);
+// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, for glDrawElements.
+GLenum get_gl_index_type(index_type_t index_type);
+
+// The most simplified versions of a mesh kept alongside the full detail one.
+#define MAX_OBJECT_LODS 4
+
+// A level of detail, a run of triangles in the objects indices that uses the same vertices as the full mesh.
+typedef struct {
+    // Offset and length in triangles.
+    int first_index;
+    int num_indices;
+    // The furthest the simplified surface gets from the full detail one, in model space.
+    float error;
+} object_lod_t;
+
+typedef struct {
+    vec3_t position;
+
+    /**
+     * The accumulated translations and rotations applied to the object. Vertices stay in model space and this
+     * matrix is applied by the vertex shader, so moving an object never touches its vertex data.
+     */
+    float model_matrix[4][4];
+
+    /**
+     * Instanced objects draw their mesh once for each of these model matrices instead of once with model_matrix, so
+     * any number of copies share the same vertices, texture and draw call. The matrices belong to whoever made the
+     * object and can change every frame, but the number of instances is only picked up when the scene is set.
+     * NULL and 0 for ordinary objects.
+     */
+    float (*instance_matrices)[4][4];
+    int num_instances;
+
+    vertex_format_t vertex_format;
+    int vertex_stride;
+    GLfloat* vertices;
+    // GLushorts or GLuints depending on the index type, use get_object_index() rather than reading them directly.
+    index_type_t index_type;
+    void* indices;
+
+    GLuint texture_id;
+
+    int num_vertices;
+    // The number of triangles, there are 3 indices for each. Indices are relative to this objects vertices.
+    int num_indices;
+
+    /**
+     * Simpler versions of the mesh for when it's small on screen, from generate_object_lods(). Their triangles are
+     * stored after the full detail ones in indices, each simpler than the last.
+     */
+    object_lod_t lods[MAX_OBJECT_LODS];
+    int num_lods;
+
+    // Set from the vertices whenever the mesh is created or loaded, by compute_object_bounds().
+    bounds_t bounds;
+} object_t;
+
+GLuint get_object_index(object_t* object, int index_idx);
+void set_object_index(object_t* object, int index_idx, GLuint index);
+/**
+ * Get the triangles for a level of detail, 0 is the full mesh and 1 to num_lods are each of the simplified ones.
+ */
+object_lod_t get_object_lod(object_t* object, int level);
+// The number of triangles in every level of detail together, which is how many the indices hold.
+int get_object_total_indices(object_t* object);
+// The number of bytes taken by all of an objects indices, including every level of detail.
+size_t get_object_indices_size(object_t* object);
+
+/**
+ * How many copies of the object get drawn, and the model matrix for each. Ordinary objects have a single instance
+ * which uses model_matrix, so both kinds can be handled the same way.
+ */
+int get_object_num_instances(object_t* object);
+float (*get_instance_matrix(object_t* object, int instance_idx))[4];
+
+// Fit the objects bounds around its vertices. The sphere is centred on the box, which is close to the smallest one.
+void compute_object_bounds(object_t* object);
+
+/**
+ * A compact copy of a vertex's position and UV for the GPU, 12 bytes instead of the objects 32. Positions are 16 bit
+ * integers spread across the objects bounding box, and UVs are 16 bit fractions of 0 to 1. The fourth position
+ * component is left for the batcher's object index, the same as the padding of the objects own vertices, and keeps
+ * the UVs 4 byte aligned.
+ */
+typedef struct {
+    GLshort position[4];
+    GLushort texture_uv[2];
+} quantized_vertex_t;
+
+// The steps positions are quantized into across each axis of the bounding box.
+#define QUANTIZED_POSITION_STEPS 65535
+
+/**
+ * Quantize every vertex of the object, which needs its bounds to be up to date. UVs are clamped to 0 to 1, which
+ * samples the same as the clamped textures would. dequantize_matrix_out takes the quantized positions back to model
+ * space, so multiplying it onto the model matrix lets the vertex shader read them as they are.
+ */
+void quantize_object_vertices(object_t* object, quantized_vertex_t* vertices_out, float dequantize_matrix_out[4][4]);
+
+#endif //INC_3D_OBJECT_H
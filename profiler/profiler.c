@@ -0,0 +1,290 @@
+#include "profiler.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Track ids in the trace.
+#define PROFILER_CPU_TRACK 1
+#define PROFILER_GPU_TRACK 2
+
+static profiler_section_t sections[PROFILER_MAX_SECTIONS];
+static int num_sections = 0;
+
+static profiler_event_t* events = NULL;
+static int num_events = 0;
+static int events_capacity = 0;
+static int num_dropped_events = 0;
+
+static double profiler_start_time = -1;
+static int has_gpu_timers = 0;
+
+// Sections are only timed on the thread main() runs on, which is remembered before main() starts.
+static pthread_t main_thread;
+
+__attribute__((constructor)) static void init_profiler_main_thread() {
+    main_thread = pthread_self();
+}
+
+// Microseconds, which is what Chrome traces use.
+static double get_profiler_time() {
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    double time = (double)tp.tv_sec * 1000000.0 + (double)tp.tv_nsec / 1000.0;
+    if(profiler_start_time < 0) {
+        profiler_start_time = time;
+    }
+    return time - profiler_start_time;
+}
+
+static int find_section(const char* name) {
+    for(int i = 0; i < num_sections; i++) {
+        if(strcmp(sections[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int add_section(const char* name, int is_gpu) {
+    int section_idx = find_section(name);
+    if(section_idx >= 0) {
+        return section_idx;
+    }
+    if(num_sections == PROFILER_MAX_SECTIONS) {
+        printf("Too many profiler sections, %s would be number %d.\n", name, PROFILER_MAX_SECTIONS + 1);
+        exit(-1);
+    }
+
+    profiler_section_t* section = &sections[num_sections];
+    memset(section, 0, sizeof(profiler_section_t));
+    section->name = name;
+    section->is_gpu = is_gpu;
+    return num_sections++;
+}
+
+static void add_sample(int section_idx, double start_time, double duration) {
+    profiler_section_t* section = &sections[section_idx];
+    section->history[section->next_sample] = (float)(duration / 1000.0);
+    section->next_sample = (section->next_sample + 1) % PROFILER_HISTORY_SIZE;
+    if(section->num_samples < PROFILER_HISTORY_SIZE) {
+        section->num_samples++;
+    }
+
+    if(num_events == PROFILER_MAX_TRACE_EVENTS) {
+        num_dropped_events++;
+        return;
+    }
+    if(num_events == events_capacity) {
+        events_capacity = events_capacity == 0 ? 4096 : events_capacity * 2;
+        events = realloc(events, events_capacity * sizeof(profiler_event_t));
+    }
+    profiler_event_t* event = &events[num_events++];
+    event->section_idx = section_idx;
+    event->start_time = start_time;
+    event->duration = duration;
+}
+
+profiler_scope_t begin_profiler_scope(int* section_idx_cache, const char* name, int is_gpu) {
+    if(!pthread_equal(pthread_self(), main_thread)) {
+        profiler_scope_t skipped_scope = { .section_idx = -1 };
+        return skipped_scope;
+    }
+    if(*section_idx_cache < 0) {
+        *section_idx_cache = add_section(name, is_gpu);
+    }
+    profiler_scope_t scope = {
+        .section_idx = *section_idx_cache,
+        .start_time = get_profiler_time(),
+    };
+    profiler_section_t* section = &sections[scope.section_idx];
+    section->num_calls++;
+
+    if(is_gpu) {
+        if(!has_gpu_timers) {
+            scope.section_idx = -1;
+            return scope;
+        }
+        if(section->queries[0] == 0) {
+            glGenQueries(PROFILER_GPU_QUERIES, section->queries);
+        }
+
+        // If every query is still waiting on the GPU then the oldest has to be waited for before it can be reused.
+        int query_idx = section->next_query;
+        if(section->is_query_pending[query_idx]) {
+            GLuint64 elapsed_time;
+            glGetQueryObjectui64v(section->queries[query_idx], GL_QUERY_RESULT, &elapsed_time);
+            add_sample(scope.section_idx, section->query_start_times[query_idx], elapsed_time / 1000.0);
+            section->is_query_pending[query_idx] = 0;
+        }
+        section->query_start_times[query_idx] = scope.start_time;
+        glBeginQuery(GL_TIME_ELAPSED, section->queries[query_idx]);
+    }
+    return scope;
+}
+
+void end_profiler_scope(profiler_scope_t* scope) {
+    if(scope->section_idx < 0) {
+        return;
+    }
+    add_sample(scope->section_idx, scope->start_time, get_profiler_time() - scope->start_time);
+}
+
+void end_profiler_gpu_scope(profiler_scope_t* scope) {
+    if(scope->section_idx < 0) {
+        return;
+    }
+    profiler_section_t* section = &sections[scope->section_idx];
+    glEndQuery(GL_TIME_ELAPSED);
+    section->is_query_pending[section->next_query] = 1;
+    section->next_query = (section->next_query + 1) % PROFILER_GPU_QUERIES;
+}
+
+void init_profiler_gpu_timers() {
+    // Timer queries are core from OpenGL 3.3, older versions can still have them as an extension.
+    const char* version = (const char*)glGetString(GL_VERSION);
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    int major = 0, minor = 0;
+    if(version != NULL) {
+        sscanf(version, "%d.%d", &major, &minor);
+    }
+    has_gpu_timers = major > 3 || (major == 3 && minor >= 3) ||
+                     (extensions != NULL && (strstr(extensions, "GL_ARB_timer_query") != NULL ||
+                                             strstr(extensions, "GL_EXT_timer_query") != NULL));
+    if(!has_gpu_timers) {
+        printf("OpenGL timer queries aren't supported, GPU sections won't be timed.\n");
+    }
+}
+
+void destroy_profiler_gpu_timers() {
+    for(int i = 0; i < num_sections; i++) {
+        profiler_section_t* section = &sections[i];
+        if(section->queries[0] != 0) {
+            glDeleteQueries(PROFILER_GPU_QUERIES, section->queries);
+            memset(section->queries, 0, sizeof(section->queries));
+            memset(section->is_query_pending, 0, sizeof(section->is_query_pending));
+        }
+    }
+    has_gpu_timers = 0;
+}
+
+void end_profiler_frame() {
+    if(!has_gpu_timers) {
+        return;
+    }
+    for(int i = 0; i < num_sections; i++) {
+        profiler_section_t* section = &sections[i];
+        if(!section->is_gpu) {
+            continue;
+        }
+
+        // Queries finish in the order they were started, so stop at the first one that isn't ready.
+        for(int j = 0; j < PROFILER_GPU_QUERIES; j++) {
+            int query_idx = (section->next_query + j) % PROFILER_GPU_QUERIES;
+            if(!section->is_query_pending[query_idx]) {
+                continue;
+            }
+            GLint is_available;
+            glGetQueryObjectiv(section->queries[query_idx], GL_QUERY_RESULT_AVAILABLE, &is_available);
+            if(!is_available) {
+                break;
+            }
+            GLuint64 elapsed_time;
+            glGetQueryObjectui64v(section->queries[query_idx], GL_QUERY_RESULT, &elapsed_time);
+            add_sample(i, section->query_start_times[query_idx], elapsed_time / 1000.0);
+            section->is_query_pending[query_idx] = 0;
+        }
+    }
+}
+
+static int compare_floats(const void* a, const void* b) {
+    float difference = *(const float*)a - *(const float*)b;
+    return (difference > 0) - (difference < 0);
+}
+
+// Nearest rank, so every percentile is a time that was actually measured.
+static double get_percentile(float* sorted_samples, int num_samples, double percentile) {
+    int rank = (int)ceil(percentile * num_samples) - 1;
+    return sorted_samples[rank < 0 ? 0 : rank];
+}
+
+int get_profiler_stats(const char* name, profiler_stats_t* stats_out) {
+    memset(stats_out, 0, sizeof(profiler_stats_t));
+    int section_idx = find_section(name);
+    if(section_idx < 0) {
+        return 0;
+    }
+
+    profiler_section_t* section = &sections[section_idx];
+    stats_out->num_calls = section->num_calls;
+    stats_out->num_samples = section->num_samples;
+    if(section->num_samples == 0) {
+        return 1;
+    }
+
+    float sorted_samples[PROFILER_HISTORY_SIZE];
+    memcpy(sorted_samples, section->history, section->num_samples * sizeof(float));
+    qsort(sorted_samples, section->num_samples, sizeof(float), compare_floats);
+    stats_out->p50 = get_percentile(sorted_samples, section->num_samples, 0.50);
+    stats_out->p95 = get_percentile(sorted_samples, section->num_samples, 0.95);
+    stats_out->p99 = get_percentile(sorted_samples, section->num_samples, 0.99);
+    stats_out->max = sorted_samples[section->num_samples - 1];
+    return 1;
+}
+
+void print_profiler_summary() {
+    printf("Profile over the latest %d times of each section, in ms:\n", PROFILER_HISTORY_SIZE);
+    printf("%-28s %-3s %8s %9s %9s %9s %9s\n", "section", "", "calls", "p50", "p95", "p99", "max");
+    for(int i = 0; i < num_sections; i++) {
+        profiler_stats_t stats;
+        get_profiler_stats(sections[i].name, &stats);
+        if(stats.num_samples == 0) {
+            continue;
+        }
+        printf(
+                "%-28s %s %8d %9.3f %9.3f %9.3f %9.3f\n", sections[i].name, sections[i].is_gpu ? "gpu" : "cpu",
+                stats.num_calls, stats.p50, stats.p95, stats.p99, stats.max
+        );
+    }
+}
+
+void write_profiler_trace(const char* path) {
+    FILE* file = fopen(path, "w");
+    if(file == NULL) {
+        printf("Failed to open %s to write the profiler trace.\n", path);
+        exit(-1);
+    }
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(
+            file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"CPU\"}},\n",
+            PROFILER_CPU_TRACK
+    );
+    fprintf(
+            file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"GPU\"}}",
+            PROFILER_GPU_TRACK
+    );
+
+    // Complete events are a start time and a duration, so nesting comes from the times alone.
+    for(int i = 0; i < num_events; i++) {
+        profiler_event_t* event = &events[i];
+        profiler_section_t* section = &sections[event->section_idx];
+        fprintf(
+                file, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                      "\"ts\": %.3f, \"dur\": %.3f}",
+                section->name, section->is_gpu ? "gpu" : "cpu",
+                section->is_gpu ? PROFILER_GPU_TRACK : PROFILER_CPU_TRACK, event->start_time, event->duration
+        );
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Wrote %d profiler events to %s", num_events, path);
+    if(num_dropped_events > 0) {
+        printf(", %d later events didn't fit", num_dropped_events);
+    }
+    printf(".\n");
+}
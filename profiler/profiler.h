@@ -0,0 +1,128 @@
+#ifndef INC_3D_PROFILER_H
+#define INC_3D_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../gl/gl.h"
+
+#define PROFILER_MAX_SECTIONS 64
+
+// How many of the latest times each section keeps for working out percentiles.
+#define PROFILER_HISTORY_SIZE 512
+
+/**
+ * GPU timings only become available a few frames after they're recorded, so each GPU section cycles through this many
+ * queries rather than stalling the CPU until the GPU catches up.
+ */
+#define PROFILER_GPU_QUERIES 4
+
+// Every timing is also kept for the trace until there are this many, which is enough for several minutes of frames.
+#define PROFILER_MAX_TRACE_EVENTS (1024 * 1024)
+
+typedef struct {
+    int section_idx;
+    // Microseconds since the profiler started.
+    double start_time;
+    double duration;
+} profiler_event_t;
+
+typedef struct {
+    const char* name;
+    int is_gpu;
+    int num_calls;
+
+    // A ring buffer of the latest times in milliseconds.
+    float history[PROFILER_HISTORY_SIZE];
+    int num_samples;
+    int next_sample;
+
+    GLuint queries[PROFILER_GPU_QUERIES];
+    // GPU times are shown in the trace from when their commands were issued.
+    double query_start_times[PROFILER_GPU_QUERIES];
+    int is_query_pending[PROFILER_GPU_QUERIES];
+    int next_query;
+} profiler_section_t;
+
+typedef struct {
+    int num_calls;
+    int num_samples;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+} profiler_stats_t;
+
+/**
+ * Started by PROFILE_SCOPE and finished when it goes out of scope. Only the section is needed for GPU scopes, the GPU
+ * measures the time itself.
+ */
+typedef struct {
+    int section_idx;
+    double start_time;
+} profiler_scope_t;
+
+/**
+ * Time a named section of code from where this is placed to the end of the enclosing block, e.g.
+ *
+ *     void rotate_object(...) {
+ *         PROFILE_SCOPE("rotate_object");
+ *         ...
+ *     }
+ *
+ * The section is looked up by name the first time each call site runs and cached after that, so a scope only costs
+ * two reads of the clock. Sections are only timed on the main thread, scopes on any other thread do nothing, so
+ * code that also runs on worker threads can keep its scopes.
+ *
+ * PROFILE_GPU_SCOPE times how long the GPU spends on the OpenGL commands issued in the block instead. OpenGL can only
+ * time one block at once, so GPU scopes can't be nested, and they do nothing if the driver has no timer queries.
+ */
+#ifdef PROFILER_DISABLED
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) \
+    static int PROFILER_CONCAT(profiler_section_, __LINE__) = -1; \
+    profiler_scope_t PROFILER_CONCAT(profiler_scope_, __LINE__) __attribute__((cleanup(end_profiler_scope))) = \
+            begin_profiler_scope(&PROFILER_CONCAT(profiler_section_, __LINE__), name, 0)
+
+#define PROFILE_GPU_SCOPE(name) \
+    static int PROFILER_CONCAT(profiler_section_, __LINE__) = -1; \
+    profiler_scope_t PROFILER_CONCAT(profiler_scope_, __LINE__) __attribute__((cleanup(end_profiler_gpu_scope))) = \
+            begin_profiler_scope(&PROFILER_CONCAT(profiler_section_, __LINE__), name, 1)
+#endif
+
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+#define PROFILER_CONCAT_INNER(a, b) a##b
+
+profiler_scope_t begin_profiler_scope(int* section_idx_cache, const char* name, int is_gpu);
+void end_profiler_scope(profiler_scope_t* scope);
+void end_profiler_gpu_scope(profiler_scope_t* scope);
+
+/**
+ * Check for GPU timer query support, needs a current OpenGL context. GPU scopes do nothing until this has been
+ * called.
+ */
+void init_profiler_gpu_timers();
+
+// Free the GPU queries, while the OpenGL context is still current.
+void destroy_profiler_gpu_timers();
+
+/**
+ * Call once at the end of every frame. Collects any GPU timings that have finished without waiting for the ones that
+ * haven't.
+ */
+void end_profiler_frame();
+
+// Get the percentiles of the latest times of a section in milliseconds. Returns 0 if there's no section by that name.
+int get_profiler_stats(const char* name, profiler_stats_t* stats_out);
+
+void print_profiler_summary();
+
+/**
+ * Write every timing as a Chrome trace, which can be opened in chrome://tracing or https://ui.perfetto.dev. CPU
+ * sections show up on one track and GPU sections on another.
+ */
+void write_profiler_trace(const char* path);
+
+#endif //INC_3D_PROFILER_H
@@ -0,0 +1,551 @@
+#include "raster.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lod/lod.h"
+#include "../profiler/profiler.h"
+#include "../transform/transform.h"
+
+static int min_int(int a, int b) {
+    return a < b ? a : b;
+}
+
+static int max_int(int a, int b) {
+    return a > b ? a : b;
+}
+
+// Rounds towards negative infinity, unlike C's division which rounds towards zero.
+static int64_t floor_divide(int64_t value, int64_t divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+/**
+ * Convert a position in pixels to subpixels. Positions are clamped well beyond the edges of any frame so the edge
+ * maths can't overflow, see create_raster_backend() for what that does to triangles reaching that far.
+ */
+static int32_t to_subpixels(float pixels) {
+    float limit = (float)(1 << 28);
+    return (int32_t)lrintf(fmaxf(-limit, fminf(limit, pixels * RASTER_SUBPIXELS)));
+}
+
+/**
+ * Move a run of one instance's vertices by its model matrix, the same as the vertex shader, and from clip space onto
+ * the screen. Screen y goes down from the top row so the colour buffer can be read out in order.
+ */
+static void transform_vertices_job(void* data) {
+    raster_job_t* job = data;
+    raster_t* raster = job->raster;
+    int object_idx = raster->bvh.instance_objects[job->instance_idx];
+    object_t* object = raster->objects[object_idx];
+    float (*m)[4] = get_instance_matrix(object, job->instance_idx - raster->bvh.object_first_instances[object_idx]);
+
+    for(int i = job->first; i < job->first + job->count; i++) {
+        GLfloat* vertex = &object->vertices[i * object->vertex_stride];
+        float x = vertex[VERTEX_POSITION_OFFSET + 0];
+        float y = vertex[VERTEX_POSITION_OFFSET + 1];
+        float z = vertex[VERTEX_POSITION_OFFSET + 2];
+
+        float clip_x = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+        float clip_y = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+        float clip_z = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+        float clip_w = m[3][0] * x + m[3][1] * y + m[3][2] * z + m[3][3];
+
+        raster_vertex_t* out = &raster->vertices[raster->first_vertex[job->instance_idx] + i];
+        out->inv_w = 1.0f / clip_w;
+        out->x = to_subpixels((clip_x * out->inv_w * 0.5f + 0.5f) * raster->width);
+        out->y = to_subpixels((0.5f - clip_y * out->inv_w * 0.5f) * raster->height);
+        out->z = clip_z * out->inv_w;
+        out->u_over_w = vertex[VERTEX_TEXTURE_UV_OFFSET + 0] * out->inv_w;
+        out->v_over_w = vertex[VERTEX_TEXTURE_UV_OFFSET + 1] * out->inv_w;
+    }
+}
+
+/**
+ * Pick the mip level OpenGL would for GL_NEAREST_MIPMAP_NEAREST from how many texels the triangle moves across per
+ * pixel. OpenGL works this out per pixel, but while w is always 1 UVs are linear on screen so the whole triangle
+ * gets the same level, see create_raster_backend().
+ */
+static raster_texture_level_t* select_texture_level(
+        raster_texture_t* texture, raster_vertex_t* v0, raster_vertex_t* v1, raster_vertex_t* v2
+) {
+    if(texture == NULL || texture->num_levels == 0) {
+        return NULL;
+    }
+    float dx1 = (float)(v1->x - v0->x) / RASTER_SUBPIXELS;
+    float dy1 = (float)(v1->y - v0->y) / RASTER_SUBPIXELS;
+    float dx2 = (float)(v2->x - v0->x) / RASTER_SUBPIXELS;
+    float dy2 = (float)(v2->y - v0->y) / RASTER_SUBPIXELS;
+    float du1 = (v1->u_over_w - v0->u_over_w) * texture->levels[0].width;
+    float dv1 = (v1->v_over_w - v0->v_over_w) * texture->levels[0].height;
+    float du2 = (v2->u_over_w - v0->u_over_w) * texture->levels[0].width;
+    float dv2 = (v2->v_over_w - v0->v_over_w) * texture->levels[0].height;
+
+    // Solve for the change in texels per pixel along x and y from the change along two of the edges.
+    float inv_determinant = 1.0f / (dx1 * dy2 - dx2 * dy1);
+    float du_dx = (du1 * dy2 - du2 * dy1) * inv_determinant;
+    float du_dy = (du2 * dx1 - du1 * dx2) * inv_determinant;
+    float dv_dx = (dv1 * dy2 - dv2 * dy1) * inv_determinant;
+    float dv_dy = (dv2 * dx1 - dv1 * dx2) * inv_determinant;
+
+    /**
+     * The texture is minified when a pixel covers more than one texel, then each halving of that is a level down.
+     * Halving the log of the squared scale saves taking square roots.
+     */
+    float squared_scale = fmaxf(du_dx * du_dx + dv_dx * dv_dx, du_dy * du_dy + dv_dy * dv_dy);
+    float lod = 0.5f * log2f(squared_scale);
+    int level = lod > 0.5f ? (int)ceilf(lod + 0.5f) - 1 : 0;
+    return &texture->levels[min_int(max_int(level, 0), texture->num_levels - 1)];
+}
+
+static void add_to_bin(raster_bin_t* bin, int triangle_idx) {
+    if(bin->num_triangles == bin->capacity) {
+        bin->capacity = bin->capacity == 0 ? 64 : bin->capacity * 2;
+        bin->triangles = realloc(bin->triangles, bin->capacity * sizeof(int));
+    }
+    bin->triangles[bin->num_triangles++] = triangle_idx;
+}
+
+// Read a triangles indices here rather than through get_object_index() so the index type check can be inlined.
+static void get_triangle_indices(object_t* object, int triangle_idx, GLuint indices_out[3]) {
+    if(object->index_type == INDEX_TYPE_UINT16) {
+        GLushort* indices = &((GLushort*)object->indices)[triangle_idx * 3];
+        indices_out[0] = indices[0];
+        indices_out[1] = indices[1];
+        indices_out[2] = indices[2];
+    } else {
+        GLuint* indices = &((GLuint*)object->indices)[triangle_idx * 3];
+        indices_out[0] = indices[0];
+        indices_out[1] = indices[1];
+        indices_out[2] = indices[2];
+    }
+}
+
+/**
+ * Set up the edge equations for a run of one objects triangles, throw away the ones facing away or off screen,
+ * and add the rest to the bins of every tile their bounds touch. The run is of the level of detail the object is
+ * drawn at this frame, which has at most as many triangles as the full mesh the jobs were split up for.
+ */
+static void setup_triangles_job(void* data) {
+    raster_job_t* job = data;
+    raster_t* raster = job->raster;
+    object_t* object = raster->objects[raster->bvh.instance_objects[job->instance_idx]];
+    int num_tiles = raster->num_tiles_x * raster->num_tiles_y;
+    raster_bin_t* bins = &raster->bins[(job - raster->setup_jobs) * num_tiles];
+
+    for(int tile_idx = 0; tile_idx < num_tiles; tile_idx++) {
+        bins[tile_idx].num_triangles = 0;
+    }
+
+    raster_texture_t* texture = NULL;
+    if(object->texture_id > 0 && (int)object->texture_id <= raster->num_textures) {
+        texture = &raster->textures[object->texture_id - 1];
+    }
+
+    object_lod_t lod = get_object_lod(object, raster->instance_lods[job->instance_idx]);
+    int end = min_int(job->first + job->count, lod.num_indices);
+    raster_vertex_t* object_vertices = &raster->vertices[raster->first_vertex[job->instance_idx]];
+    for(int i = job->first; i < end; i++) {
+        GLuint indices[3];
+        get_triangle_indices(object, lod.first_index + i, indices);
+        raster_vertex_t* v0 = &object_vertices[indices[0]];
+        raster_vertex_t* v1 = &object_vertices[indices[1]];
+        raster_vertex_t* v2 = &object_vertices[indices[2]];
+
+        // There's no near plane clipping, so triangles with any vertex behind the eye are dropped whole.
+        if(v0->inv_w <= 0 || v1->inv_w <= 0 || v2->inv_w <= 0) {
+            continue;
+        }
+
+        /**
+         * Screen y is flipped compared to clip space, so triangles that are counter clockwise on screen in OpenGL
+         * have a negative area here. Those are the front faces, everything else gets culled like GL_BACK does.
+         */
+        int64_t area = (int64_t)(v1->x - v0->x) * (v2->y - v0->y) - (int64_t)(v1->y - v0->y) * (v2->x - v0->x);
+        if(area >= 0) {
+            continue;
+        }
+        // Swap two vertices so the edge equations come out positive inside the triangle.
+        raster_vertex_t* swap = v1;
+        v1 = v2;
+        v2 = swap;
+        area = -area;
+
+        // Only pixel centres inside the triangle get drawn, so round the bounds inwards to the nearest centres.
+        int64_t half_pixel = RASTER_SUBPIXELS / 2;
+        int64_t bounds_min_x = min_int(v0->x, min_int(v1->x, v2->x)) - half_pixel;
+        int64_t bounds_min_y = min_int(v0->y, min_int(v1->y, v2->y)) - half_pixel;
+        int64_t bounds_max_x = max_int(v0->x, max_int(v1->x, v2->x)) - half_pixel;
+        int64_t bounds_max_y = max_int(v0->y, max_int(v1->y, v2->y)) - half_pixel;
+        int min_x = max_int((int)floor_divide(bounds_min_x + RASTER_SUBPIXELS - 1, RASTER_SUBPIXELS), 0);
+        int min_y = max_int((int)floor_divide(bounds_min_y + RASTER_SUBPIXELS - 1, RASTER_SUBPIXELS), 0);
+        int max_x = min_int((int)floor_divide(bounds_max_x, RASTER_SUBPIXELS), raster->width - 1);
+        int max_y = min_int((int)floor_divide(bounds_max_y, RASTER_SUBPIXELS), raster->height - 1);
+        if(min_x > max_x || min_y > max_y) {
+            continue;
+        }
+
+        int triangle_idx = raster->first_triangle[job->instance_idx] + i;
+        raster_triangle_t* triangle = &raster->triangles[triangle_idx];
+        raster_vertex_t* vertices[3] = { v0, v1, v2 };
+        for(int edge = 0; edge < 3; edge++) {
+            // The edge opposite each vertex gives that vertex's weight.
+            raster_vertex_t* a = vertices[(edge + 1) % 3];
+            raster_vertex_t* b = vertices[(edge + 2) % 3];
+            int64_t edge_a = a->y - b->y;
+            int64_t edge_b = b->x - a->x;
+            triangle->edge_a[edge] = edge_a;
+            triangle->edge_b[edge] = edge_b;
+            triangle->edge_c[edge] = -(edge_a * a->x + edge_b * a->y);
+
+            /**
+             * Pixel centres exactly on an edge only belong to the triangle if it's a top or left edge, so pixels on
+             * an edge shared by two triangles are only drawn once. Taking one off the other edges makes their
+             * exact zeros negative, so every edge can be tested with >= 0.
+             */
+            int is_top_left = edge_a > 0 || (edge_a == 0 && edge_b > 0);
+            if(!is_top_left) {
+                triangle->edge_c[edge] -= 1;
+            }
+
+            triangle->z[edge] = vertices[edge]->z;
+            triangle->inv_w[edge] = vertices[edge]->inv_w;
+            triangle->u_over_w[edge] = vertices[edge]->u_over_w;
+            triangle->v_over_w[edge] = vertices[edge]->v_over_w;
+        }
+        triangle->inv_area = 1.0f / (float)area;
+        triangle->min_x = min_x;
+        triangle->min_y = min_y;
+        triangle->max_x = max_x;
+        triangle->max_y = max_y;
+        triangle->texture_level = select_texture_level(texture, v0, v1, v2);
+
+        for(int tile_y = min_y / RASTER_TILE_SIZE; tile_y <= max_y / RASTER_TILE_SIZE; tile_y++) {
+            for(int tile_x = min_x / RASTER_TILE_SIZE; tile_x <= max_x / RASTER_TILE_SIZE; tile_x++) {
+                add_to_bin(&bins[tile_y * raster->num_tiles_x + tile_x], triangle_idx);
+            }
+        }
+    }
+}
+
+// Nearest filtering with the coordinates clamped to the edge, matching the OpenGL texture parameters.
+static uint32_t sample_texture(raster_texture_level_t* texture, float u, float v) {
+    if(texture == NULL) {
+        // Sampling a texture that doesn't exist gives opaque black in OpenGL.
+        uint32_t black = 0;
+        ((byte*)&black)[3] = 255;
+        return black;
+    }
+    int x = min_int(max_int((int)floorf(u * texture->width), 0), texture->width - 1);
+    int y = min_int(max_int((int)floorf(v * texture->height), 0), texture->height - 1);
+    return texture->pixels[y * texture->width + x];
+}
+
+static void rasterize_triangle(
+        raster_t* raster, raster_triangle_t* triangle, int tile_min_x, int tile_min_y, int tile_max_x, int tile_max_y
+) {
+    int min_x = max_int(triangle->min_x, tile_min_x);
+    int min_y = max_int(triangle->min_y, tile_min_y);
+    int max_x = min_int(triangle->max_x, tile_max_x);
+    int max_y = min_int(triangle->max_y, tile_max_y);
+
+    for(int y = min_y; y <= max_y; y++) {
+        int64_t pixel_y = (int64_t)y * RASTER_SUBPIXELS + RASTER_SUBPIXELS / 2;
+        int64_t pixel_x = (int64_t)min_x * RASTER_SUBPIXELS + RASTER_SUBPIXELS / 2;
+        int64_t edges[3];
+        for(int edge = 0; edge < 3; edge++) {
+            edges[edge] = triangle->edge_a[edge] * pixel_x + triangle->edge_b[edge] * pixel_y + triangle->edge_c[edge];
+        }
+
+        for(int x = min_x; x <= max_x; x++) {
+            // The pixel is inside if none of the edges are negative, which is when none of them have the sign bit set.
+            if((edges[0] | edges[1] | edges[2]) >= 0) {
+                float weights[3] = {
+                    edges[0] * triangle->inv_area, edges[1] * triangle->inv_area, edges[2] * triangle->inv_area
+                };
+                float z = weights[0] * triangle->z[0] + weights[1] * triangle->z[1] + weights[2] * triangle->z[2];
+                float depth = z * 0.5f + 0.5f;
+                int pixel_idx = y * raster->width + x;
+
+                // Anything outside the depth range would have been clipped by OpenGL.
+                if(depth >= 0 && depth <= 1 && depth < raster->depth_buffer[pixel_idx]) {
+                    float inv_w = weights[0] * triangle->inv_w[0] + weights[1] * triangle->inv_w[1] +
+                                  weights[2] * triangle->inv_w[2];
+                    float u = weights[0] * triangle->u_over_w[0] + weights[1] * triangle->u_over_w[1] +
+                              weights[2] * triangle->u_over_w[2];
+                    float v = weights[0] * triangle->v_over_w[0] + weights[1] * triangle->v_over_w[1] +
+                              weights[2] * triangle->v_over_w[2];
+
+                    raster->depth_buffer[pixel_idx] = depth;
+                    raster->color_buffer[pixel_idx] = sample_texture(triangle->texture_level, u / inv_w, v / inv_w);
+                }
+            }
+
+            for(int edge = 0; edge < 3; edge++) {
+                edges[edge] += triangle->edge_a[edge] * RASTER_SUBPIXELS;
+            }
+        }
+    }
+}
+
+// Clear a tile and draw every triangle binned to it, in the order they were submitted.
+static void draw_tile_job(void* data) {
+    raster_job_t* job = data;
+    raster_t* raster = job->raster;
+    int tile_idx = job->first;
+    int num_tiles = raster->num_tiles_x * raster->num_tiles_y;
+
+    int min_x = (tile_idx % raster->num_tiles_x) * RASTER_TILE_SIZE;
+    int min_y = (tile_idx / raster->num_tiles_x) * RASTER_TILE_SIZE;
+    int max_x = min_int(min_x + RASTER_TILE_SIZE, raster->width) - 1;
+    int max_y = min_int(min_y + RASTER_TILE_SIZE, raster->height) - 1;
+
+    for(int y = min_y; y <= max_y; y++) {
+        for(int x = min_x; x <= max_x; x++) {
+            raster->color_buffer[y * raster->width + x] = 0;
+            raster->depth_buffer[y * raster->width + x] = 1.0f;
+        }
+    }
+
+    for(int setup_job_idx = 0; setup_job_idx < raster->num_setup_jobs; setup_job_idx++) {
+        raster_bin_t* bin = &raster->bins[setup_job_idx * num_tiles + tile_idx];
+        for(int i = 0; i < bin->num_triangles; i++) {
+            rasterize_triangle(raster, &raster->triangles[bin->triangles[i]], min_x, min_y, max_x, max_y);
+        }
+    }
+}
+
+static GLuint raster_create_texture(render_backend_t* backend, byte* mip_chain, int width, int height) {
+    raster_t* raster = backend->data;
+
+    raster->textures = realloc(raster->textures, (raster->num_textures + 1) * sizeof(raster_texture_t));
+    raster_texture_t* texture = &raster->textures[raster->num_textures++];
+    size_t offsets[MAX_TEXTURE_LEVELS + 1];
+    texture->num_levels = get_mip_chain_offsets(TEXTURE_FORMAT_RGBA8, width, height, offsets);
+    texture->mip_chain = malloc(offsets[texture->num_levels]);
+    memcpy(texture->mip_chain, mip_chain, offsets[texture->num_levels]);
+    for(int level = 0; level < texture->num_levels; level++) {
+        texture->levels[level].width = get_mip_level_size(width, level);
+        texture->levels[level].height = get_mip_level_size(height, level);
+        texture->levels[level].pixels = &texture->mip_chain[offsets[level] / sizeof(uint32_t)];
+    }
+
+    // Like OpenGL, 0 means no texture so ids start at 1.
+    return raster->num_textures;
+}
+
+static void raster_destroy_texture(render_backend_t* backend, GLuint texture_id) {
+    raster_t* raster = backend->data;
+
+    // Ids are positions in the array so the slot stays, with no levels it samples the same as no texture.
+    raster_texture_t* texture = &raster->textures[texture_id - 1];
+    free(texture->mip_chain);
+    texture->mip_chain = NULL;
+    texture->num_levels = 0;
+}
+
+static void free_scene(raster_t* raster) {
+    int num_bins = raster->num_setup_jobs * raster->num_tiles_x * raster->num_tiles_y;
+    for(int i = 0; i < num_bins; i++) {
+        free(raster->bins[i].triangles);
+    }
+    free(raster->bins);
+    free(raster->objects);
+    free(raster->first_vertex);
+    free(raster->first_triangle);
+    free(raster->vertices);
+    free(raster->triangles);
+    free(raster->transform_jobs);
+    free(raster->setup_jobs);
+    free(raster->instance_lods);
+    free_bvh(&raster->bvh);
+
+    raster->bins = NULL;
+    raster->objects = NULL;
+    raster->first_vertex = NULL;
+    raster->first_triangle = NULL;
+    raster->vertices = NULL;
+    raster->triangles = NULL;
+    raster->transform_jobs = NULL;
+    raster->setup_jobs = NULL;
+    raster->instance_lods = NULL;
+    raster->num_objects = 0;
+    raster->num_transform_jobs = 0;
+    raster->num_setup_jobs = 0;
+}
+
+/**
+ * The scene only changes here, so work out every job the frames will need up front and allocate room for all the
+ * transformed vertices and triangles. Frames then only need to fill them in.
+ */
+static void raster_set_scene(render_backend_t* backend, object_t** objects, int num_objects) {
+    raster_t* raster = backend->data;
+    free_scene(raster);
+
+    raster->num_objects = num_objects;
+    raster->objects = malloc(num_objects * sizeof(object_t*));
+    memcpy(raster->objects, objects, num_objects * sizeof(object_t*));
+    // Every instance is transformed and set up on its own, so the jobs and shared arrays are per instance.
+    build_bvh(&raster->bvh, raster->objects, num_objects);
+    int num_instances = raster->bvh.num_instances;
+    raster->first_vertex = malloc(num_instances * sizeof(int));
+    raster->first_triangle = malloc(num_instances * sizeof(int));
+
+    int total_vertices = 0;
+    int total_triangles = 0;
+    for(int instance_idx = 0; instance_idx < num_instances; instance_idx++) {
+        object_t* object = objects[raster->bvh.instance_objects[instance_idx]];
+        raster->first_vertex[instance_idx] = total_vertices;
+        raster->first_triangle[instance_idx] = total_triangles;
+        total_vertices += object->num_vertices;
+        total_triangles += object->num_indices;
+
+        raster->num_transform_jobs += (object->num_vertices + RASTER_VERTEX_CHUNK_SIZE - 1) / RASTER_VERTEX_CHUNK_SIZE;
+        raster->num_setup_jobs += (object->num_indices + RASTER_TRIANGLE_CHUNK_SIZE - 1) / RASTER_TRIANGLE_CHUNK_SIZE;
+    }
+    raster->vertices = malloc(total_vertices * sizeof(raster_vertex_t));
+    raster->triangles = malloc(total_triangles * sizeof(raster_triangle_t));
+
+    raster->transform_jobs = malloc(raster->num_transform_jobs * sizeof(raster_job_t));
+    raster->setup_jobs = malloc(raster->num_setup_jobs * sizeof(raster_job_t));
+    int transform_job_idx = 0;
+    int setup_job_idx = 0;
+    for(int instance_idx = 0; instance_idx < num_instances; instance_idx++) {
+        object_t* object = objects[raster->bvh.instance_objects[instance_idx]];
+        for(int first = 0; first < object->num_vertices; first += RASTER_VERTEX_CHUNK_SIZE) {
+            raster_job_t* job = &raster->transform_jobs[transform_job_idx++];
+            job->raster = raster;
+            job->instance_idx = instance_idx;
+            job->first = first;
+            job->count = min_int(RASTER_VERTEX_CHUNK_SIZE, object->num_vertices - first);
+        }
+        for(int first = 0; first < object->num_indices; first += RASTER_TRIANGLE_CHUNK_SIZE) {
+            raster_job_t* job = &raster->setup_jobs[setup_job_idx++];
+            job->raster = raster;
+            job->instance_idx = instance_idx;
+            job->first = first;
+            job->count = min_int(RASTER_TRIANGLE_CHUNK_SIZE, object->num_indices - first);
+        }
+    }
+
+    raster->bins = calloc(raster->num_setup_jobs * raster->num_tiles_x * raster->num_tiles_y, sizeof(raster_bin_t));
+    raster->instance_lods = calloc(num_instances, 1);
+
+    printf(
+            "Rasterizing %d objects (%d instances, %d vertices, %d triangles) in %dx%d tiles with %d threads.\n",
+            num_objects, num_instances, total_vertices, total_triangles, raster->num_tiles_x, raster->num_tiles_y,
+            raster->pool->num_threads
+    );
+}
+
+static void raster_draw_frame(render_backend_t* backend) {
+    raster_t* raster = backend->data;
+    job_group_t group;
+
+    refit_bvh(&raster->bvh);
+    backend->num_drawn_objects = cull_bvh(&raster->bvh, &raster->frustum);
+    backend->num_culled_objects = raster->bvh.num_instances - backend->num_drawn_objects;
+    byte* is_visible = raster->bvh.is_visible;
+    backend->num_drawn_triangles = select_lods(&raster->bvh, raster->height, raster->instance_lods);
+
+    // Each stage needs all of the previous one to have finished, so wait in between.
+    {
+        PROFILE_SCOPE("raster_transform_vertices");
+        init_job_group(&group);
+        for(int i = 0; i < raster->num_transform_jobs; i++) {
+            if(is_visible[raster->transform_jobs[i].instance_idx]) {
+                submit_job(raster->pool, &group, transform_vertices_job, &raster->transform_jobs[i]);
+            }
+        }
+        wait_for_job_group(raster->pool, &group);
+    }
+
+    {
+        PROFILE_SCOPE("raster_setup_triangles");
+        init_job_group(&group);
+        int num_tiles = raster->num_tiles_x * raster->num_tiles_y;
+        for(int i = 0; i < raster->num_setup_jobs; i++) {
+            raster_job_t* job = &raster->setup_jobs[i];
+            object_t* object = raster->objects[raster->bvh.instance_objects[job->instance_idx]];
+            // Simpler levels of detail have fewer triangles, so jobs for the end of the full mesh have nothing to do.
+            int num_triangles = get_object_lod(object, raster->instance_lods[job->instance_idx]).num_indices;
+            if(is_visible[job->instance_idx] && job->first < num_triangles) {
+                submit_job(raster->pool, &group, setup_triangles_job, job);
+                continue;
+            }
+            // Skipped jobs still have bins from the last frame they had triangles to set up, which tiles would draw.
+            for(int tile_idx = 0; tile_idx < num_tiles; tile_idx++) {
+                raster->bins[i * num_tiles + tile_idx].num_triangles = 0;
+            }
+        }
+        wait_for_job_group(raster->pool, &group);
+    }
+
+    {
+        PROFILE_SCOPE("raster_draw_tiles");
+        init_job_group(&group);
+        for(int i = 0; i < raster->num_tiles_x * raster->num_tiles_y; i++) {
+            submit_job(raster->pool, &group, draw_tile_job, &raster->tile_jobs[i]);
+        }
+        wait_for_job_group(raster->pool, &group);
+    }
+}
+
+static void raster_read_pixels(render_backend_t* backend, byte* pixels_out) {
+    raster_t* raster = backend->data;
+    memcpy(pixels_out, raster->color_buffer, raster->width * raster->height * sizeof(uint32_t));
+}
+
+static void raster_destroy(render_backend_t* backend) {
+    raster_t* raster = backend->data;
+
+    free_scene(raster);
+    for(int i = 0; i < raster->num_textures; i++) {
+        free(raster->textures[i].mip_chain);
+    }
+    free(raster->textures);
+    free(raster->tile_jobs);
+    free(raster->color_buffer);
+    free(raster->depth_buffer);
+
+    free(raster);
+    backend->data = NULL;
+}
+
+void create_raster_backend(render_backend_t* backend, int width, int height, thread_pool_t* pool) {
+    raster_t* raster = calloc(1, sizeof(raster_t));
+    raster->pool = pool;
+    raster->width = width;
+    raster->height = height;
+    raster->num_tiles_x = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    raster->num_tiles_y = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    raster->color_buffer = malloc(width * height * sizeof(uint32_t));
+    raster->depth_buffer = malloc(width * height * sizeof(float));
+
+    int num_tiles = raster->num_tiles_x * raster->num_tiles_y;
+    raster->tile_jobs = malloc(num_tiles * sizeof(raster_job_t));
+    for(int i = 0; i < num_tiles; i++) {
+        raster->tile_jobs[i].raster = raster;
+        raster->tile_jobs[i].instance_idx = -1;
+        raster->tile_jobs[i].first = i;
+        raster->tile_jobs[i].count = 1;
+    }
+
+    backend->name = "cpu";
+    backend->width = width;
+    backend->height = height;
+    backend->data = raster;
+    backend->create_texture = raster_create_texture;
+    backend->destroy_texture = raster_destroy_texture;
+    backend->set_scene = raster_set_scene;
+    backend->draw_frame = raster_draw_frame;
+    backend->read_pixels = raster_read_pixels;
+    backend->destroy = raster_destroy;
+
+    // Model matrices take vertices straight to clip space, so the frustum is the clip volume itself.
+    float view_projection[4][4];
+    get_identity_matrix(view_projection);
+    get_frustum(view_projection, &raster->frustum);
+}
@@ -0,0 +1,155 @@
+#ifndef INC_3D_RASTER_H
+#define INC_3D_RASTER_H
+
+#include <stdint.h>
+
+#include "../bvh/bvh.h"
+#include "../render/render.h"
+#include "../texture/texture.h"
+#include "../thread_pool/thread_pool.h"
+
+/**
+ * The frame is split into square tiles which are each drawn by one job, so no two threads ever touch the same
+ * pixel. 64x64 tiles keep a tiles colour and depth(32KB) inside a cores L1/L2 while it's being drawn.
+ */
+#define RASTER_TILE_SIZE 64
+
+/**
+ * Screen positions are fixed point with 8 bits of subpixel precision, the same as Mesa and most GPUs. Edge tests are
+ * then exact integer maths, so shared edges never leave gaps or draw pixels twice.
+ */
+#define RASTER_SUBPIXEL_BITS 8
+#define RASTER_SUBPIXELS (1 << RASTER_SUBPIXEL_BITS)
+
+// How many vertices or triangles each transform or setup job works through.
+#define RASTER_VERTEX_CHUNK_SIZE 4096
+#define RASTER_TRIANGLE_CHUNK_SIZE 2048
+
+typedef struct {
+    int width;
+    int height;
+    uint32_t* pixels;
+} raster_texture_level_t;
+
+typedef struct {
+    // The whole mip chain, which each level points into.
+    uint32_t* mip_chain;
+    raster_texture_level_t levels[MAX_TEXTURE_LEVELS];
+    int num_levels;
+} raster_texture_t;
+
+/**
+ * A vertex after it has been moved into its objects place and onto the screen. UVs are divided by w so they can be
+ * interpolated linearly in screen space and corrected per pixel, the same as OpenGL does.
+ */
+typedef struct {
+    // In subpixels from the top left of the frame.
+    int32_t x;
+    int32_t y;
+
+    float z;
+    float inv_w;
+    float u_over_w;
+    float v_over_w;
+} raster_vertex_t;
+
+/**
+ * A triangle ready to be filled in. Each edge equation a*x + b*y + c, evaluated at a pixel centre in subpixels, is
+ * positive inside the triangle and gives the weight of the opposite vertex once divided by the triangles area.
+ */
+typedef struct {
+    int64_t edge_a[3];
+    int64_t edge_b[3];
+    int64_t edge_c[3];
+    float inv_area;
+
+    float z[3];
+    float inv_w[3];
+    float u_over_w[3];
+    float v_over_w[3];
+
+    // Inclusive pixel bounds, already clamped to the frame.
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+
+    // The mip level the whole triangle samples from, or NULL for no texture.
+    raster_texture_level_t* texture_level;
+} raster_triangle_t;
+
+// The triangles one setup job found touching one tile, in the order they were drawn.
+typedef struct {
+    int* triangles;
+    int num_triangles;
+    int capacity;
+} raster_bin_t;
+
+struct raster;
+
+/**
+ * One job's share of the work for a frame. Transform jobs cover a run of one instance's vertices, setup jobs a run
+ * of one instance's triangles, and tile jobs a single tile.
+ */
+typedef struct {
+    struct raster* raster;
+    int instance_idx;
+    int first;
+    int count;
+} raster_job_t;
+
+typedef struct raster {
+    thread_pool_t* pool;
+    int width;
+    int height;
+    int num_tiles_x;
+    int num_tiles_y;
+
+    uint32_t* color_buffer;
+    float* depth_buffer;
+
+    raster_texture_t* textures;
+    int num_textures;
+
+    object_t** objects;
+    int num_objects;
+    // Where each instance's vertices and triangles start in the shared arrays below, numbered as in the bvh.
+    int* first_vertex;
+    int* first_triangle;
+
+    raster_vertex_t* vertices;
+    raster_triangle_t* triangles;
+
+    raster_job_t* transform_jobs;
+    int num_transform_jobs;
+    raster_job_t* setup_jobs;
+    int num_setup_jobs;
+    raster_job_t* tile_jobs;
+
+    /**
+     * Each setup job bins its triangles into its own row of num_tiles bins, so setup jobs never need to lock. Tiles
+     * walk the rows in order, which keeps triangles in the order they were submitted.
+     */
+    raster_bin_t* bins;
+
+    // Instances outside the view have their transform and setup jobs skipped.
+    bvh_t bvh;
+    frustum_t frustum;
+    // The level of detail each visible instance is drawn at, which setup jobs read their triangles from.
+    byte* instance_lods;
+} raster_t;
+
+/**
+ * Draw on the CPU, spreading the work over the pool's threads. Culling and texture sampling match the OpenGL
+ * backend: counter clockwise triangles face forward, back faces are culled, and textures use nearest filtering
+ * from the nearest mip level, clamped to the edge.
+ *
+ * Unlike OpenGL, triangles aren't clipped. Any triangle with a vertex at or behind w = 0 is dropped whole rather than
+ * cut at the near plane, and vertices more than 2^20 pixels off the frame are clamped there, which bends the
+ * triangles they're part of. Each triangle also samples a single mip level picked for the whole triangle rather than
+ * per pixel. Model matrices only take vertices straight to clip space with w = 1 for now, so none of these come up
+ * until there's a perspective camera.
+ */
+void create_raster_backend(render_backend_t* backend, int width, int height, thread_pool_t* pool);
+
+#endif //INC_3D_RASTER_H
@@ -0,0 +1,52 @@
+#ifndef INC_3D_RENDER_H
+#define INC_3D_RENDER_H
+
+#include "../object/object.h"
+
+/**
+ * Something that can turn the scene into pixels. Everything outside the backends only talks to them through these
+ * functions, so the OpenGL renderer and the CPU rasterizer can be swapped for each other.
+ */
+typedef struct render_backend {
+    const char* name;
+    int width;
+    int height;
+
+    // Whatever state the backend needs.
+    void* data;
+
+    /**
+     * How many objects the last frame drew, and how many it skipped for being entirely outside the view. Each
+     * instance of an instanced object counts as an object of its own.
+     */
+    int num_drawn_objects;
+    int num_culled_objects;
+    // How many triangles the drawn objects had at the levels of detail they were drawn at.
+    int num_drawn_triangles;
+
+    /**
+     * Make a texture from an RGBA8 mip chain from generate_mip_chain(), with each level starting with the top row,
+     * and return the id objects should use as their texture_id. The chain only needs to last for the call. Textures
+     * are clamped at their edges and sampled with nearest filtering from the nearest level.
+     */
+    GLuint (*create_texture)(struct render_backend* backend, byte* mip_chain, int width, int height);
+
+    // Free a texture once no objects use it any more.
+    void (*destroy_texture)(struct render_backend* backend, GLuint texture_id);
+
+    /**
+     * Set the objects to draw. The backend holds on to the object pointers and reads their model matrices every
+     * frame, so objects can keep moving without the scene being set again.
+     */
+    void (*set_scene)(struct render_backend* backend, object_t** objects, int num_objects);
+
+    // Clear the frame and draw every object in the scene that's in view.
+    void (*draw_frame)(struct render_backend* backend);
+
+    // Copy the last frame drawn into width * height RGBA8 pixels, starting with the top row.
+    void (*read_pixels)(struct render_backend* backend, byte* pixels_out);
+
+    void (*destroy)(struct render_backend* backend);
+} render_backend_t;
+
+#endif //INC_3D_RENDER_H
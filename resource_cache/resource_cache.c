@@ -0,0 +1,234 @@
+#include "resource_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "../transform/transform.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t continue_hash(uint64_t hash, const void* data, size_t size) {
+    const byte* bytes = data;
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t hash_resource(const void* data, size_t size) {
+    return continue_hash(FNV_OFFSET_BASIS, data, size);
+}
+
+void init_resource_cache(resource_cache_t* cache, arena_t* mesh_arena, render_backend_t* backend) {
+    memset(cache, 0, sizeof(resource_cache_t));
+    cache->mesh_arena = mesh_arena;
+    cache->backend = backend;
+}
+
+void free_resource_cache(resource_cache_t* cache) {
+    for(int i = 0; i < cache->num_files; i++) {
+        free(cache->files[i].path);
+    }
+    free(cache->files);
+    free(cache->meshes);
+    free(cache->textures);
+    memset(cache, 0, sizeof(resource_cache_t));
+}
+
+static cached_mesh_t* find_mesh_by_vertices(resource_cache_t* cache, GLfloat* vertices) {
+    for(int i = 0; i < cache->num_meshes; i++) {
+        if(cache->meshes[i].vertices == vertices) {
+            return &cache->meshes[i];
+        }
+    }
+    return NULL;
+}
+
+static cached_texture_t* find_texture_by_id(resource_cache_t* cache, GLuint texture_id) {
+    for(int i = 0; i < cache->num_textures; i++) {
+        if(cache->textures[i].texture_id == texture_id) {
+            return &cache->textures[i];
+        }
+    }
+    return NULL;
+}
+
+static void use_cached_mesh(cached_mesh_t* mesh, object_t* object) {
+    mesh->ref_count++;
+    object->vertex_format = mesh->vertex_format;
+    object->vertex_stride = mesh->vertex_stride;
+    object->vertices = mesh->vertices;
+    object->index_type = mesh->index_type;
+    object->indices = mesh->indices;
+    object->num_vertices = mesh->num_vertices;
+    object->num_indices = mesh->num_indices;
+    memcpy(object->lods, mesh->lods, sizeof(object->lods));
+    object->num_lods = mesh->num_lods;
+    object->bounds = mesh->bounds;
+}
+
+int acquire_cached_file(
+        resource_cache_t* cache, const char* file_path, vertex_format_t vertex_format, object_t* object_out
+) {
+    struct stat file_stat;
+    if(stat(file_path, &file_stat) != 0) {
+        return 0;
+    }
+    for(int i = 0; i < cache->num_files; i++) {
+        cached_file_t* file = &cache->files[i];
+        if(strcmp(file->path, file_path) != 0 || file->vertex_format != vertex_format) {
+            continue;
+        }
+        if(file->modified_time != file_stat.st_mtime || file->size != file_stat.st_size) {
+            return 0;
+        }
+
+        // Start at the origin, the same as an object that has just been loaded.
+        memset(object_out, 0, sizeof(object_t));
+        get_identity_matrix(object_out->model_matrix);
+
+        // Files are dropped along with their mesh or texture, so both are still here.
+        use_cached_mesh(find_mesh_by_vertices(cache, file->vertices), object_out);
+        find_texture_by_id(cache, file->texture_id)->ref_count++;
+        object_out->texture_id = file->texture_id;
+        cache->num_file_hits++;
+        return 1;
+    }
+    return 0;
+}
+
+void add_cached_file(resource_cache_t* cache, const char* file_path, object_t* object) {
+    struct stat file_stat;
+    if(stat(file_path, &file_stat) != 0) {
+        return;
+    }
+
+    // A file that has changed since it was last loaded replaces what it loaded to before.
+    cached_file_t* file = NULL;
+    for(int i = 0; i < cache->num_files; i++) {
+        if(strcmp(cache->files[i].path, file_path) == 0 && cache->files[i].vertex_format == object->vertex_format) {
+            file = &cache->files[i];
+            break;
+        }
+    }
+    if(file == NULL) {
+        cache->files = realloc(cache->files, (cache->num_files + 1) * sizeof(cached_file_t));
+        file = &cache->files[cache->num_files++];
+        file->path = strdup(file_path);
+        file->vertex_format = object->vertex_format;
+    }
+    file->modified_time = file_stat.st_mtime;
+    file->size = file_stat.st_size;
+    file->vertices = object->vertices;
+    file->texture_id = object->texture_id;
+}
+
+uint64_t hash_mesh(object_t* object) {
+    uint64_t hash = hash_resource(
+            object->vertices, (size_t)object->num_vertices * object->vertex_stride * sizeof(GLfloat)
+    );
+    return continue_hash(hash, object->indices, get_object_indices_size(object));
+}
+
+void share_cached_mesh(resource_cache_t* cache, object_t* object, uint64_t hash) {
+    size_t vertices_size = (size_t)object->num_vertices * object->vertex_stride * sizeof(GLfloat);
+    size_t indices_size = get_object_indices_size(object);
+
+    for(int i = 0; i < cache->num_meshes; i++) {
+        cached_mesh_t* mesh = &cache->meshes[i];
+        if(mesh->hash == hash && mesh->vertex_format == object->vertex_format &&
+           mesh->index_type == object->index_type && mesh->num_vertices == object->num_vertices &&
+           mesh->num_indices == object->num_indices && mesh->num_lods == object->num_lods) {
+            use_cached_mesh(mesh, object);
+            cache->num_mesh_hits++;
+            return;
+        }
+    }
+
+    cache->meshes = realloc(cache->meshes, (cache->num_meshes + 1) * sizeof(cached_mesh_t));
+    cached_mesh_t* mesh = &cache->meshes[cache->num_meshes++];
+    mesh->hash = hash;
+    mesh->vertex_format = object->vertex_format;
+    mesh->vertex_stride = object->vertex_stride;
+    mesh->vertices = arena_alloc(cache->mesh_arena, vertices_size);
+    memcpy(mesh->vertices, object->vertices, vertices_size);
+    mesh->index_type = object->index_type;
+    mesh->indices = arena_alloc(cache->mesh_arena, indices_size);
+    memcpy(mesh->indices, object->indices, indices_size);
+    mesh->num_vertices = object->num_vertices;
+    mesh->num_indices = object->num_indices;
+    memcpy(mesh->lods, object->lods, sizeof(mesh->lods));
+    mesh->num_lods = object->num_lods;
+    mesh->bounds = object->bounds;
+    mesh->ref_count = 0;
+    use_cached_mesh(mesh, object);
+}
+
+int acquire_cached_texture(resource_cache_t* cache, uint64_t hash, size_t size, GLuint* texture_id_out) {
+    for(int i = 0; i < cache->num_textures; i++) {
+        cached_texture_t* texture = &cache->textures[i];
+        if(texture->hash == hash && texture->size == size) {
+            texture->ref_count++;
+            *texture_id_out = texture->texture_id;
+            cache->num_texture_hits++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void add_cached_texture(resource_cache_t* cache, uint64_t hash, size_t size, GLuint texture_id) {
+    cache->textures = realloc(cache->textures, (cache->num_textures + 1) * sizeof(cached_texture_t));
+    cached_texture_t* texture = &cache->textures[cache->num_textures++];
+    texture->hash = hash;
+    texture->size = size;
+    texture->texture_id = texture_id;
+    texture->ref_count = 1;
+}
+
+// Forget any files that loaded to a mesh or texture that's gone, so they get loaded again next time.
+static void remove_cached_files(resource_cache_t* cache, GLfloat* vertices, GLuint texture_id) {
+    for(int i = 0; i < cache->num_files;) {
+        cached_file_t* file = &cache->files[i];
+        if((vertices != NULL && file->vertices == vertices) || (texture_id != 0 && file->texture_id == texture_id)) {
+            free(file->path);
+            *file = cache->files[--cache->num_files];
+        } else {
+            i++;
+        }
+    }
+}
+
+void release_object_resources(resource_cache_t* cache, object_t* object) {
+    cached_mesh_t* mesh = find_mesh_by_vertices(cache, object->vertices);
+    if(mesh != NULL && --mesh->ref_count == 0) {
+        remove_cached_files(cache, mesh->vertices, 0);
+        *mesh = cache->meshes[--cache->num_meshes];
+    }
+
+    cached_texture_t* texture = find_texture_by_id(cache, object->texture_id);
+    if(texture != NULL && --texture->ref_count == 0) {
+        remove_cached_files(cache, NULL, texture->texture_id);
+        cache->backend->destroy_texture(cache->backend, texture->texture_id);
+        *texture = cache->textures[--cache->num_textures];
+    }
+
+    object->vertices = NULL;
+    object->indices = NULL;
+    object->num_vertices = 0;
+    object->num_indices = 0;
+    object->num_lods = 0;
+    object->bounds = (bounds_t){ 0 };
+    object->texture_id = 0;
+}
+
+void print_resource_cache_stats(resource_cache_t* cache) {
+    printf(
+            "Resource cache: %d meshes, %d textures and %d files loaded, %d meshes, %d textures and %d files shared.\n",
+            cache->num_meshes, cache->num_textures, cache->num_files, cache->num_mesh_hits, cache->num_texture_hits,
+            cache->num_file_hits
+    );
+}
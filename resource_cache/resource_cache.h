@@ -0,0 +1,118 @@
+#ifndef INC_3D_RESOURCE_CACHE_H
+#define INC_3D_RESOURCE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "../arena/arena.h"
+#include "../object/object.h"
+#include "../render/render.h"
+
+/**
+ * Scenes use the same models and textures over and over, so everything that's loaded is kept here and shared
+ * between objects rather than being decoded and uploaded again for each one. Textures are keyed by a hash of their
+ * encoded image and meshes by a hash of their vertices and indices, so identical ones are shared even when they
+ * come from different files. Files are also keyed by their path, size and modification time, so loading a file
+ * that hasn't changed since it was last loaded doesn't even need to open it.
+ *
+ * Everything is reference counted, each object that uses a mesh or texture holds a reference to it until it's
+ * released. Textures are destroyed as soon as their last reference is released. Meshes live in the mesh arena, so
+ * their memory only comes back when the arena is reset, but they stop being shared once nothing uses them.
+ */
+typedef struct {
+    uint64_t hash;
+    // The size of the encoded image, checked along with the hash.
+    size_t size;
+    GLuint texture_id;
+    int ref_count;
+} cached_texture_t;
+
+typedef struct {
+    uint64_t hash;
+    vertex_format_t vertex_format;
+    int vertex_stride;
+    GLfloat* vertices;
+    index_type_t index_type;
+    void* indices;
+    int num_vertices;
+    int num_indices;
+    object_lod_t lods[MAX_OBJECT_LODS];
+    int num_lods;
+    bounds_t bounds;
+    int ref_count;
+} cached_mesh_t;
+
+// What a file loaded to last time, which is only reused while the file's size and modification time still match.
+typedef struct {
+    char* path;
+    vertex_format_t vertex_format;
+    time_t modified_time;
+    off_t size;
+    GLfloat* vertices;
+    GLuint texture_id;
+} cached_file_t;
+
+typedef struct {
+    // Where shared meshes are copied to, and the backend that owns the textures.
+    arena_t* mesh_arena;
+    render_backend_t* backend;
+
+    cached_texture_t* textures;
+    int num_textures;
+    cached_mesh_t* meshes;
+    int num_meshes;
+    cached_file_t* files;
+    int num_files;
+
+    // How many loads were saved by sharing, for the stats.
+    int num_texture_hits;
+    int num_mesh_hits;
+    int num_file_hits;
+} resource_cache_t;
+
+void init_resource_cache(resource_cache_t* cache, arena_t* mesh_arena, render_backend_t* backend);
+
+// Free the cache's own memory. Textures and meshes still in use are left to their backend and arena.
+void free_resource_cache(resource_cache_t* cache);
+
+// FNV-1a over some bytes, which is what everything in the cache is keyed by.
+uint64_t hash_resource(const void* data, size_t size);
+
+/**
+ * Fill in an objects mesh and texture from what the file at file_path loaded to last time, if it hasn't changed
+ * since then. Returns 0 if the file needs loading, otherwise the object holds a reference to both.
+ */
+int acquire_cached_file(
+        resource_cache_t* cache, const char* file_path, vertex_format_t vertex_format, object_t* object_out
+);
+
+// Remember what a file loaded to, once the object has been filled in with its shared mesh and texture.
+void add_cached_file(resource_cache_t* cache, const char* file_path, object_t* object);
+
+// Hash an objects vertices and indices, for sharing its mesh.
+uint64_t hash_mesh(object_t* object);
+
+/**
+ * Point an object at an identical mesh, going by the hash from hash_mesh(), if one has been loaded before, otherwise copy its vertices and indices into
+ * the mesh arena to share from now on. Either way the object holds a reference to the mesh afterwards, and its old
+ * vertices and indices, which can be in temporary memory, aren't used any more.
+ */
+void share_cached_mesh(resource_cache_t* cache, object_t* object, uint64_t hash);
+
+/**
+ * Get the texture made from an identical encoded image, adding a reference to it. Returns 0 if there isn't one, in
+ * which case the texture should be created and added with add_cached_texture().
+ */
+int acquire_cached_texture(resource_cache_t* cache, uint64_t hash, size_t size, GLuint* texture_id_out);
+
+// Add a texture that was just created, with one reference for the object it was created for.
+void add_cached_texture(resource_cache_t* cache, uint64_t hash, size_t size, GLuint texture_id);
+
+// Give up an objects references to its mesh and texture, destroying the texture if nothing else uses it.
+void release_object_resources(resource_cache_t* cache, object_t* object);
+
+void print_resource_cache_stats(resource_cache_t* cache);
+
+#endif //INC_3D_RESOURCE_CACHE_H
@@ -5,17 +5,54 @@
 #ifndef INC_3D_SHADERS_H
 #define INC_3D_SHADERS_H
 
+#include "batch/batch.h"
+
+#define SHADER_STRINGIFY(value) #value
+#define SHADER_INT(value) SHADER_STRINGIFY(value)
+
 /**
- * Convert the vertex position into clip space so that it can be UV mapped later.
+ * Move the vertex from model space to where its object currently is using the objects model matrix, and convert
+ * it into clip space so that it can be UV mapped later. Several objects are drawn at once so each vertex says
+ * which of the model matrices belongs to it.
+ *
+ * Quantized vertices come in as 16 bit integers, with UVs already normalized to 0 to 1 by OpenGL. Positions are
+ * decoded back into model space by the dequantize matrix the batch multiplies onto each model matrix, so the same
+ * multiply does both and there's no need for more uniforms. Only xyz are uploaded for them, so w is 1.
  */
 const char* vertexShaderSource =
         "#version 120\n"
         "attribute vec4 aPos;\n"
         "attribute vec2 aTexCoord;\n"
+        "attribute float aObjectIndex;\n"
+        "uniform mat4 modelMatrices[" SHADER_INT(MAX_BATCH_OBJECTS) "];\n"
+        "varying vec2 TexCoord;\n"
+        "void main()\n"
+        "{\n"
+        "    gl_Position = modelMatrices[int(aObjectIndex)] * vec4(aPos.xyz, 1.0);\n"
+        "    TexCoord = aTexCoord;\n"
+        "}\0";
+
+/**
+ * The same as the vertex shader above for instanced objects, where every vertex of an instance shares a model
+ * matrix that comes in as four attributes, one for each row. The rows are row major so each one gives a single
+ * coordinate of the clip space position.
+ */
+const char* instancedVertexShaderSource =
+        "#version 120\n"
+        "attribute vec4 aPos;\n"
+        "attribute vec2 aTexCoord;\n"
+        "attribute vec4 aModelRow0;\n"
+        "attribute vec4 aModelRow1;\n"
+        "attribute vec4 aModelRow2;\n"
+        "attribute vec4 aModelRow3;\n"
         "varying vec2 TexCoord;\n"
         "void main()\n"
         "{\n"
-        "    gl_Position = vec4(aPos.xyz, 1.0);\n"
+        "    vec4 position = vec4(aPos.xyz, 1.0);\n"
+        "    gl_Position = vec4(\n"
+        "            dot(aModelRow0, position), dot(aModelRow1, position), dot(aModelRow2, position),\n"
+        "            dot(aModelRow3, position)\n"
+        "    );\n"
         "    TexCoord = aTexCoord;\n"
         "}\0";
 
@@ -0,0 +1,308 @@
+#include "texture.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+size_t get_bc1_size(int width, int height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BC1_BLOCK_SIZE;
+}
+
+static uint16_t pack_rgb565(const int rgb[3]) {
+    return (uint16_t)(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+}
+
+// Expand back to 8 bits the same way the GPU does, by repeating the top bits in the bottom ones.
+static void unpack_rgb565(uint16_t color, int rgb_out[3]) {
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    rgb_out[0] = (r << 3) | (r >> 2);
+    rgb_out[1] = (g << 2) | (g >> 4);
+    rgb_out[2] = (b << 3) | (b >> 2);
+}
+
+static int get_color_distance(const int a[3], const byte* b) {
+    int dr = a[0] - b[0];
+    int dg = a[1] - b[1];
+    int db = a[2] - b[2];
+    return dr * dr + dg * dg + db * db;
+}
+
+/**
+ * Encode a block with the two given end points, giving each pixel whichever of the four colours is closest. Blocks
+ * with any transparent pixels use the mode with three colours and transparent. Returns the total squared error.
+ */
+static int encode_block_bc1(
+        byte block[16][4], const int min_rgb[3], const int max_rgb[3], int has_transparent_pixels, byte* output
+) {
+    uint16_t color0 = pack_rgb565(max_rgb);
+    uint16_t color1 = pack_rgb565(min_rgb);
+
+    // The order of the two colours picks the mode, four colours when the first is bigger and three otherwise.
+    if(has_transparent_pixels ? color0 > color1 : color0 < color1) {
+        uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    int palette[4][3];
+    unpack_rgb565(color0, palette[0]);
+    unpack_rgb565(color1, palette[1]);
+    int num_colors = 4;
+    if(has_transparent_pixels) {
+        num_colors = 3;
+        for(int channel = 0; channel < 3; channel++) {
+            palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+        }
+    } else if(color0 == color1) {
+        // Every pixel is the same colour, anything else would pick the three colour mode.
+        num_colors = 1;
+    } else {
+        for(int channel = 0; channel < 3; channel++) {
+            palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+            palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+        }
+    }
+
+    uint32_t indices = 0;
+    int error = 0;
+    for(int i = 0; i < 16; i++) {
+        int best_index = 3;
+        if(block[i][3] >= 128 || !has_transparent_pixels) {
+            int best_distance = get_color_distance(palette[0], block[i]);
+            best_index = 0;
+            for(int index = 1; index < num_colors; index++) {
+                int distance = get_color_distance(palette[index], block[i]);
+                if(distance < best_distance) {
+                    best_distance = distance;
+                    best_index = index;
+                }
+            }
+            error += best_distance;
+        }
+        indices |= (uint32_t)best_index << (i * 2);
+    }
+
+    // Everything is little endian.
+    output[0] = color0 & 0xff;
+    output[1] = color0 >> 8;
+    output[2] = color1 & 0xff;
+    output[3] = color1 >> 8;
+    output[4] = indices & 0xff;
+    output[5] = (indices >> 8) & 0xff;
+    output[6] = (indices >> 16) & 0xff;
+    output[7] = indices >> 24;
+    return error;
+}
+
+/**
+ * Use the corners of the box around the blocks colours as the two end points. Pulling them in slightly usually does
+ * better, as the colours at the very edges of the box are rarer than the ones in between, but not for blocks with
+ * only a couple of distinct colours, so both are tried and the better one kept.
+ */
+static void compress_block_bc1(byte block[16][4], byte* output) {
+    int min_rgb[3] = { 255, 255, 255 };
+    int max_rgb[3] = { 0, 0, 0 };
+    int has_transparent_pixels = 0;
+    int has_opaque_pixels = 0;
+    for(int i = 0; i < 16; i++) {
+        if(block[i][3] < 128) {
+            has_transparent_pixels = 1;
+            continue;
+        }
+        has_opaque_pixels = 1;
+        for(int channel = 0; channel < 3; channel++) {
+            if(block[i][channel] < min_rgb[channel]) {
+                min_rgb[channel] = block[i][channel];
+            }
+            if(block[i][channel] > max_rgb[channel]) {
+                max_rgb[channel] = block[i][channel];
+            }
+        }
+    }
+    if(!has_opaque_pixels) {
+        memset(output, 0, 4);
+        memset(output + 4, 0xff, 4);
+        return;
+    }
+
+    int error = encode_block_bc1(block, min_rgb, max_rgb, has_transparent_pixels, output);
+    if(error == 0) {
+        return;
+    }
+
+    int inset_min_rgb[3];
+    int inset_max_rgb[3];
+    for(int channel = 0; channel < 3; channel++) {
+        int inset = (max_rgb[channel] - min_rgb[channel]) / 16;
+        inset_min_rgb[channel] = min_rgb[channel] + inset;
+        inset_max_rgb[channel] = max_rgb[channel] - inset;
+    }
+    byte inset_output[BC1_BLOCK_SIZE];
+    if(encode_block_bc1(block, inset_min_rgb, inset_max_rgb, has_transparent_pixels, inset_output) < error) {
+        memcpy(output, inset_output, BC1_BLOCK_SIZE);
+    }
+}
+
+void compress_texture_bc1(byte* pixels, int width, int height, byte* output) {
+    byte block[16][4];
+    for(int block_y = 0; block_y < height; block_y += 4) {
+        for(int block_x = 0; block_x < width; block_x += 4) {
+            // Blocks hanging off the edge repeat the last row or column, which won't be sampled anyway.
+            for(int y = 0; y < 4; y++) {
+                int pixel_y = block_y + y < height ? block_y + y : height - 1;
+                for(int x = 0; x < 4; x++) {
+                    int pixel_x = block_x + x < width ? block_x + x : width - 1;
+                    memcpy(block[y * 4 + x], &pixels[(pixel_y * width + pixel_x) * 4], 4);
+                }
+            }
+            compress_block_bc1(block, output);
+            output += BC1_BLOCK_SIZE;
+        }
+    }
+}
+
+int get_mip_level_size(int size, int level) {
+    return size >> level > 0 ? size >> level : 1;
+}
+
+int get_mip_chain_offsets(texture_format_t format, int width, int height, size_t offsets_out[MAX_TEXTURE_LEVELS + 1]) {
+    int num_levels = 0;
+    size_t offset = 0;
+    while(num_levels < MAX_TEXTURE_LEVELS) {
+        int level_width = get_mip_level_size(width, num_levels);
+        int level_height = get_mip_level_size(height, num_levels);
+        offsets_out[num_levels++] = offset;
+        offset += format == TEXTURE_FORMAT_BC1 ? get_bc1_size(level_width, level_height)
+                                               : (size_t)level_width * level_height * 4;
+        if(level_width == 1 && level_height == 1) {
+            break;
+        }
+    }
+    offsets_out[num_levels] = offset;
+    return num_levels;
+}
+
+// Average each 2x2 square of pixels, for odd sizes the last row or column is averaged with itself.
+static void downsample_texture(byte* pixels, int width, int height, byte* output) {
+    int output_width = get_mip_level_size(width, 1);
+    int output_height = get_mip_level_size(height, 1);
+    for(int y = 0; y < output_height; y++) {
+        int y0 = y * 2 < height ? y * 2 : height - 1;
+        int y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+        for(int x = 0; x < output_width; x++) {
+            int x0 = x * 2 < width ? x * 2 : width - 1;
+            int x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+            for(int channel = 0; channel < 4; channel++) {
+                int sum = pixels[(y0 * width + x0) * 4 + channel] + pixels[(y0 * width + x1) * 4 + channel] +
+                          pixels[(y1 * width + x0) * 4 + channel] + pixels[(y1 * width + x1) * 4 + channel];
+                output[(y * output_width + x) * 4 + channel] = (byte)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+byte* generate_mip_chain(byte* pixels, int width, int height) {
+    size_t offsets[MAX_TEXTURE_LEVELS + 1];
+    int num_levels = get_mip_chain_offsets(TEXTURE_FORMAT_RGBA8, width, height, offsets);
+    byte* chain = malloc(offsets[num_levels]);
+    memcpy(chain, pixels, offsets[1]);
+    for(int level = 1; level < num_levels; level++) {
+        downsample_texture(
+                &chain[offsets[level - 1]], get_mip_level_size(width, level - 1), get_mip_level_size(height, level - 1),
+                &chain[offsets[level]]
+        );
+    }
+    return chain;
+}
+
+void compress_mip_chain_bc1(byte* rgba_chain, int width, int height, byte* output) {
+    size_t rgba_offsets[MAX_TEXTURE_LEVELS + 1];
+    size_t bc1_offsets[MAX_TEXTURE_LEVELS + 1];
+    int num_levels = get_mip_chain_offsets(TEXTURE_FORMAT_RGBA8, width, height, rgba_offsets);
+    get_mip_chain_offsets(TEXTURE_FORMAT_BC1, width, height, bc1_offsets);
+    for(int level = 0; level < num_levels; level++) {
+        compress_texture_bc1(
+                &rgba_chain[rgba_offsets[level]], get_mip_level_size(width, level), get_mip_level_size(height, level),
+                &output[bc1_offsets[level]]
+        );
+    }
+}
+
+// FNV-1a, with the size mixed in so textures with the same pixels in a different shape don't collide.
+uint64_t hash_texture(byte* pixels, int width, int height) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = (hash ^ (uint64_t)width) * 1099511628211ull;
+    hash = (hash ^ (uint64_t)height) * 1099511628211ull;
+    size_t num_bytes = (size_t)width * height * 4;
+    for(size_t i = 0; i < num_bytes; i++) {
+        hash = (hash ^ pixels[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static void get_cache_path(const char* cache_directory, uint64_t hash, char* path_out, size_t path_size) {
+    snprintf(path_out, path_size, "%s/%016llx.bc1", cache_directory, (unsigned long long)hash);
+}
+
+byte* load_cached_texture(const char* cache_directory, uint64_t hash, int width, int height, mapped_file_t* file_out) {
+    char path[4096];
+    get_cache_path(cache_directory, hash, path, sizeof(path));
+    memset(file_out, 0, sizeof(mapped_file_t));
+    if(!map_file(path, file_out)) {
+        return NULL;
+    }
+
+    size_t offsets[MAX_TEXTURE_LEVELS + 1];
+    int num_levels = get_mip_chain_offsets(TEXTURE_FORMAT_BC1, width, height, offsets);
+    texture_cache_header_t* header = (texture_cache_header_t*)file_out->data;
+    int is_valid = file_out->size == sizeof(texture_cache_header_t) + offsets[num_levels] &&
+                   header->magic == TEXTURE_CACHE_MAGIC && header->version == TEXTURE_CACHE_VERSION &&
+                   header->width == (uint32_t)width && header->height == (uint32_t)height &&
+                   header->num_levels == (uint32_t)num_levels && header->hash == hash;
+    if(!is_valid) {
+        printf("Ignoring texture cache file %s as it doesn't match the texture.\n", path);
+        unmap_file(file_out);
+        memset(file_out, 0, sizeof(mapped_file_t));
+        return NULL;
+    }
+    return file_out->data + sizeof(texture_cache_header_t);
+}
+
+void save_cached_texture(const char* cache_directory, uint64_t hash, int width, int height, byte* chain) {
+    if(mkdir(cache_directory, 0755) != 0 && errno != EEXIST) {
+        printf("Failed to create the texture cache directory %s.\n", cache_directory);
+        return;
+    }
+
+    char path[4096];
+    get_cache_path(cache_directory, hash, path, sizeof(path));
+    FILE* file = fopen(path, "wb");
+    if(file == NULL) {
+        printf("Failed to write texture cache file %s.\n", path);
+        return;
+    }
+
+    size_t offsets[MAX_TEXTURE_LEVELS + 1];
+    int num_levels = get_mip_chain_offsets(TEXTURE_FORMAT_BC1, width, height, offsets);
+    texture_cache_header_t header = {
+        .magic = TEXTURE_CACHE_MAGIC,
+        .version = TEXTURE_CACHE_VERSION,
+        .width = width,
+        .height = height,
+        .num_levels = num_levels,
+        .hash = hash,
+    };
+    size_t size = offsets[num_levels];
+    int is_written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(chain, 1, size, file) == size;
+    fclose(file);
+
+    // Don't leave half a file behind to be found next time, the size check would catch it but it's wasted space.
+    if(!is_written) {
+        printf("Failed to write texture cache file %s.\n", path);
+        remove(path);
+    }
+}
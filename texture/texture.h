@@ -0,0 +1,78 @@
+#ifndef INC_3D_TEXTURE_H
+#define INC_3D_TEXTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../mapped_file/mapped_file.h"
+#include "../object/object.h"
+
+/**
+ * BC1(also called DXT1) stores each 4x4 block of pixels as two RGB565 colours and a 2 bit index per pixel choosing
+ * between them and two colours blended from them, 8 bytes for what's 64 bytes as RGBA8. Alpha is either fully opaque
+ * or fully transparent. Edge blocks of textures that aren't a multiple of 4 in size are still whole blocks.
+ */
+#define BC1_BLOCK_SIZE 8
+
+size_t get_bc1_size(int width, int height);
+
+// Compress RGBA8 pixels, starting with the top row, into get_bc1_size() bytes of blocks in the same order.
+void compress_texture_bc1(byte* pixels, int width, int height, byte* output);
+
+/**
+ * Mip chains hold every level of a texture one after another, starting with the full size level 0. Each level is
+ * half the size of the one before, rounded down but never less than 1, down to 1x1.
+ */
+#define MAX_TEXTURE_LEVELS 16
+
+typedef enum {
+    TEXTURE_FORMAT_RGBA8,
+    TEXTURE_FORMAT_BC1,
+} texture_format_t;
+
+int get_mip_level_size(int size, int level);
+
+/**
+ * Fill in where each level starts in a mip chain, with one more offset at the end for the size of the whole chain.
+ * Returns the number of levels.
+ */
+int get_mip_chain_offsets(texture_format_t format, int width, int height, size_t offsets_out[MAX_TEXTURE_LEVELS + 1]);
+
+/**
+ * Make an RGBA8 mip chain, with each level a 2x2 box filter of the one before. The first level is a copy of the
+ * pixels. The chain is malloced and needs to be freed by the caller.
+ */
+byte* generate_mip_chain(byte* pixels, int width, int height);
+
+// Compress every level of an RGBA8 mip chain into a BC1 one.
+void compress_mip_chain_bc1(byte* rgba_chain, int width, int height, byte* output);
+
+/**
+ * Compressed textures are kept on disk keyed by a hash of their pixels, so each one is only ever compressed once.
+ * Each file starts with this header, followed by the BC1 mip chain.
+ */
+#define TEXTURE_CACHE_MAGIC 0x31434254 // "TBC1"
+#define TEXTURE_CACHE_VERSION 2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t num_levels;
+    uint32_t padding;
+    uint64_t hash;
+} texture_cache_header_t;
+
+uint64_t hash_texture(byte* pixels, int width, int height);
+
+/**
+ * Map the cached BC1 mip chain for a texture and return a pointer to it, or NULL if it isn't in the cache or the
+ * cache file doesn't match. The chain stays valid until the file is unmapped.
+ */
+byte* load_cached_texture(const char* cache_directory, uint64_t hash, int width, int height, mapped_file_t* file_out);
+
+// Save a BC1 mip chain to the cache, creating the directory if needed. Failing to save only prints a warning.
+void save_cached_texture(const char* cache_directory, uint64_t hash, int width, int height, byte* chain);
+
+#endif //INC_3D_TEXTURE_H
@@ -0,0 +1,137 @@
+#include "thread_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int get_num_cpu_cores() {
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return num_cores > 0 ? (int)num_cores : 1;
+}
+
+// Must be called with the pool mutex held.
+static job_t* pop_job(thread_pool_t* pool) {
+    job_t* job = pool->queue_head;
+    if(job != NULL) {
+        pool->queue_head = job->next;
+        if(pool->queue_head == NULL) {
+            pool->queue_tail = NULL;
+        }
+    }
+    return job;
+}
+
+// Must be called with the pool mutex held, the mutex is released while the job runs.
+static void run_job(thread_pool_t* pool, job_t* job) {
+    pthread_mutex_unlock(&pool->mutex);
+    job->function(job->data);
+    pthread_mutex_lock(&pool->mutex);
+
+    job->group->num_pending_jobs--;
+    if(job->group->num_pending_jobs == 0) {
+        pthread_cond_broadcast(&pool->job_finished);
+    }
+    free(job);
+}
+
+static void* worker_thread(void* data) {
+    thread_pool_t* pool = data;
+
+    pthread_mutex_lock(&pool->mutex);
+    while(1) {
+        job_t* job = pop_job(pool);
+        if(job != NULL) {
+            run_job(pool, job);
+            continue;
+        }
+        if(pool->is_shutting_down) {
+            break;
+        }
+        pthread_cond_wait(&pool->job_available, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+thread_pool_t* create_thread_pool(int num_threads) {
+    if(num_threads <= 0) {
+        num_threads = get_num_cpu_cores();
+    }
+
+    thread_pool_t* pool = calloc(1, sizeof(thread_pool_t));
+    pool->num_threads = num_threads;
+    pool->threads = malloc(num_threads * sizeof(pthread_t));
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->job_available, NULL);
+    pthread_cond_init(&pool->job_finished, NULL);
+
+    for(int i = 0; i < num_threads; i++) {
+        if(pthread_create(&pool->threads[i], NULL, worker_thread, pool) != 0) {
+            printf("Failed to create worker thread %d.\n", i);
+            exit(-1);
+        }
+    }
+    return pool;
+}
+
+void destroy_thread_pool(thread_pool_t* pool) {
+    // Workers finish everything left in the queue before exiting.
+    pthread_mutex_lock(&pool->mutex);
+    pool->is_shutting_down = 1;
+    pthread_cond_broadcast(&pool->job_available);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for(int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->job_available);
+    pthread_cond_destroy(&pool->job_finished);
+    free(pool->threads);
+    free(pool);
+}
+
+void init_job_group(job_group_t* group) {
+    group->num_pending_jobs = 0;
+}
+
+void submit_job(thread_pool_t* pool, job_group_t* group, job_function_t function, void* data) {
+    job_t* job = malloc(sizeof(job_t));
+    job->function = function;
+    job->data = data;
+    job->group = group;
+    job->next = NULL;
+
+    pthread_mutex_lock(&pool->mutex);
+    group->num_pending_jobs++;
+    if(pool->queue_tail != NULL) {
+        pool->queue_tail->next = job;
+    } else {
+        pool->queue_head = job;
+    }
+    pool->queue_tail = job;
+    pthread_cond_signal(&pool->job_available);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void wait_for_job_group(thread_pool_t* pool, job_group_t* group) {
+    pthread_mutex_lock(&pool->mutex);
+    while(group->num_pending_jobs > 0) {
+        job_t* job = pop_job(pool);
+        if(job != NULL) {
+            run_job(pool, job);
+        } else {
+            pthread_cond_wait(&pool->job_finished, &pool->mutex);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int is_job_group_finished(thread_pool_t* pool, job_group_t* group) {
+    pthread_mutex_lock(&pool->mutex);
+    int is_finished = group->num_pending_jobs == 0;
+    pthread_mutex_unlock(&pool->mutex);
+    return is_finished;
+}
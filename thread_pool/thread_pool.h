@@ -0,0 +1,59 @@
+#ifndef INC_3D_THREAD_POOL_H
+#define INC_3D_THREAD_POOL_H
+
+#include <pthread.h>
+
+typedef void (*job_function_t)(void* data);
+
+typedef struct job {
+    job_function_t function;
+    void* data;
+    struct job_group* group;
+    struct job* next;
+} job_t;
+
+/**
+ * Tracks a set of jobs so that the caller can wait for just the work it submitted, even when other systems are
+ * sharing the same pool.
+ */
+typedef struct job_group {
+    int num_pending_jobs;
+} job_group_t;
+
+/**
+ * A fixed set of worker threads pulling jobs off a shared FIFO queue.
+ */
+typedef struct {
+    pthread_t* threads;
+    int num_threads;
+
+    job_t* queue_head;
+    job_t* queue_tail;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t job_available;
+    pthread_cond_t job_finished;
+    int is_shutting_down;
+} thread_pool_t;
+
+int get_num_cpu_cores();
+
+/**
+ * Start a pool with the given number of worker threads, or one per CPU core if num_threads is 0.
+ */
+thread_pool_t* create_thread_pool(int num_threads);
+void destroy_thread_pool(thread_pool_t* pool);
+
+void init_job_group(job_group_t* group);
+void submit_job(thread_pool_t* pool, job_group_t* group, job_function_t function, void* data);
+
+/**
+ * Block until every job in the group has finished. The calling thread runs queued jobs while it waits rather than
+ * sitting idle.
+ */
+void wait_for_job_group(thread_pool_t* pool, job_group_t* group);
+
+// Check whether every job in the group has finished, without waiting or running any jobs.
+int is_job_group_finished(thread_pool_t* pool, job_group_t* group);
+
+#endif //INC_3D_THREAD_POOL_H
@@ -0,0 +1,410 @@
+#include "transform.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TRANSFORM_HAS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define TRANSFORM_HAS_NEON 1
+#include <arm_neon.h>
+#endif
+
+void get_identity_matrix(float output[4][4]) {
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 4; j++) {
+            output[i][j] = i == j ? 1.0f : 0.0f;
+        }
+    }
+}
+
+void get_x_rotation_matrix(float output[4][4], float theta) {
+    output[0][0] = 1; output[0][1] = 0;          output[0][2] = 0;           output[0][3] = 0;
+    output[1][0] = 0; output[1][1] = cos(theta); output[1][2] = -sin(theta); output[1][3] = 0;
+    output[2][0] = 0; output[2][1] = sin(theta); output[2][2] = cos(theta);  output[2][3] = 0;
+    output[3][0] = 0; output[3][1] = 0;          output[3][2] = 0;           output[3][3] = 1;
+}
+
+void get_y_rotation_matrix(float output[4][4], float theta) {
+    output[0][0] = cos(theta);  output[0][1] = 0; output[0][2] = sin(theta); output[0][3] = 0;
+    output[1][0] = 0;           output[1][1] = 1; output[1][2] = 0;          output[1][3] = 0;
+    output[2][0] = -sin(theta); output[2][1] = 0; output[2][2] = cos(theta); output[2][3] = 0;
+    // NOTE: We need to set w to 1 here to ensure we don't zero it for future operations.
+    output[3][0] = 0;           output[3][1] = 0; output[3][2] = 0;          output[3][3] = 1;
+}
+
+void get_z_rotation_matrix(float output[4][4], float theta) {
+    output[0][0] = cos(theta); output[0][1] = -sin(theta); output[0][2] = 0; output[0][3] = 0;
+    output[1][0] = sin(theta); output[1][1] = cos(theta);  output[1][2] = 0; output[1][3] = 0;
+    output[2][0] = 0;          output[2][1] = 0;           output[2][2] = 1; output[2][3] = 0;
+    output[3][0] = 0;          output[3][1] = 0;           output[3][2] = 0; output[3][3] = 1;
+}
+
+void get_translate_matrix(float output[4][4], float x_distance, float y_distance, float z_distance) {
+    output[0][0] = 1; output[0][1] = 0; output[0][2] = 0; output[0][3] = x_distance;
+    output[1][0] = 0; output[1][1] = 1; output[1][2] = 0; output[1][3] = y_distance;
+    output[2][0] = 0; output[2][1] = 0; output[2][2] = 1; output[2][3] = z_distance;
+    output[3][0] = 0; output[3][1] = 0; output[3][2] = 0; output[3][3] = 1;
+}
+
+void get_scale_matrix(float output[4][4], float x_scale, float y_scale, float z_scale) {
+    output[0][0] = x_scale; output[0][1] = 0;       output[0][2] = 0;       output[0][3] = 0;
+    output[1][0] = 0;       output[1][1] = y_scale; output[1][2] = 0;       output[1][3] = 0;
+    output[2][0] = 0;       output[2][1] = 0;       output[2][2] = z_scale; output[2][3] = 0;
+    output[3][0] = 0;       output[3][1] = 0;       output[3][2] = 0;       output[3][3] = 1;
+}
+
+void multiply_matrices(float output[4][4], float left[4][4], float right[4][4]) {
+    float result[4][4];
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 4; j++) {
+            result[i][j] = 0;
+            for(int k = 0; k < 4; k++) {
+                result[i][j] += left[i][k] * right[k][j];
+            }
+        }
+    }
+    memcpy(output, result, sizeof(result));
+}
+
+static void apply_matrix_transform_scalar(
+        float* vertex_pointer, int num_vertices, int vertex_stride, float matrix[4][4]
+) {
+    /**
+     * Copy the matrix into locals up front. Otherwise the compiler has to assume every store to a vertex could
+     * have changed the matrix and reload all 16 values for each vertex.
+     */
+    float m00 = matrix[0][0], m01 = matrix[0][1], m02 = matrix[0][2], m03 = matrix[0][3];
+    float m10 = matrix[1][0], m11 = matrix[1][1], m12 = matrix[1][2], m13 = matrix[1][3];
+    float m20 = matrix[2][0], m21 = matrix[2][1], m22 = matrix[2][2], m23 = matrix[2][3];
+    float m30 = matrix[3][0], m31 = matrix[3][1], m32 = matrix[3][2], m33 = matrix[3][3];
+
+    for(int vertex_idx = 0; vertex_idx < num_vertices; vertex_idx++) {
+        float* vertex = &vertex_pointer[vertex_idx * vertex_stride];
+        float x = vertex[0];
+        float y = vertex[1];
+        float z = vertex[2];
+        float w = vertex[3];
+
+        vertex[0] = m00 * x + m01 * y + m02 * z + m03 * w;
+        vertex[1] = m10 * x + m11 * y + m12 * z + m13 * w;
+        vertex[2] = m20 * x + m21 * y + m22 * z + m23 * w;
+        vertex[3] = m30 * x + m31 * y + m32 * z + m33 * w;
+    }
+}
+
+#ifdef TRANSFORM_HAS_X86
+/**
+ * Each output vertex is the matrix columns scaled by the vertex components and summed, so we keep the columns in
+ * registers and broadcast x, y, z and w across a register for each vertex.
+ */
+static void apply_matrix_transform_sse(
+        float* vertex_pointer, int num_vertices, int vertex_stride, float matrix[4][4]
+) {
+    __m128 column0 = _mm_setr_ps(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+    __m128 column1 = _mm_setr_ps(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+    __m128 column2 = _mm_setr_ps(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+    __m128 column3 = _mm_setr_ps(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+
+    for(int vertex_idx = 0; vertex_idx < num_vertices; vertex_idx++) {
+        float* vertex = &vertex_pointer[vertex_idx * vertex_stride];
+        __m128 v = _mm_loadu_ps(vertex);
+
+        __m128 result = _mm_mul_ps(column0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+        result = _mm_add_ps(result, _mm_mul_ps(column1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+        result = _mm_add_ps(result, _mm_mul_ps(column2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+        result = _mm_add_ps(result, _mm_mul_ps(column3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+
+        _mm_storeu_ps(vertex, result);
+    }
+}
+
+/**
+ * Same as the SSE kernel but with a vertex in each 128 bit lane, so one instruction works on two vertices. The
+ * loop is unrolled to four vertices to give the FMAs independent work to overlap.
+ */
+__attribute__((target("avx2,fma")))
+static void apply_matrix_transform_avx2(
+        float* vertex_pointer, int num_vertices, int vertex_stride, float matrix[4][4]
+) {
+    float columns[4][4];
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 4; j++) {
+            columns[j][i] = matrix[i][j];
+        }
+    }
+    __m256 column0 = _mm256_broadcast_ps((const __m128*)columns[0]);
+    __m256 column1 = _mm256_broadcast_ps((const __m128*)columns[1]);
+    __m256 column2 = _mm256_broadcast_ps((const __m128*)columns[2]);
+    __m256 column3 = _mm256_broadcast_ps((const __m128*)columns[3]);
+
+    int vertex_idx = 0;
+    for(; vertex_idx + 4 <= num_vertices; vertex_idx += 4) {
+        float* vertex0 = &vertex_pointer[vertex_idx * vertex_stride];
+        float* vertex1 = vertex0 + vertex_stride;
+        float* vertex2 = vertex1 + vertex_stride;
+        float* vertex3 = vertex2 + vertex_stride;
+        __m256 v0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(vertex0)), _mm_loadu_ps(vertex1), 1);
+        __m256 v1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(vertex2)), _mm_loadu_ps(vertex3), 1);
+
+        __m256 result0 = _mm256_mul_ps(column0, _mm256_permute_ps(v0, _MM_SHUFFLE(0, 0, 0, 0)));
+        __m256 result1 = _mm256_mul_ps(column0, _mm256_permute_ps(v1, _MM_SHUFFLE(0, 0, 0, 0)));
+        result0 = _mm256_fmadd_ps(column1, _mm256_permute_ps(v0, _MM_SHUFFLE(1, 1, 1, 1)), result0);
+        result1 = _mm256_fmadd_ps(column1, _mm256_permute_ps(v1, _MM_SHUFFLE(1, 1, 1, 1)), result1);
+        result0 = _mm256_fmadd_ps(column2, _mm256_permute_ps(v0, _MM_SHUFFLE(2, 2, 2, 2)), result0);
+        result1 = _mm256_fmadd_ps(column2, _mm256_permute_ps(v1, _MM_SHUFFLE(2, 2, 2, 2)), result1);
+        result0 = _mm256_fmadd_ps(column3, _mm256_permute_ps(v0, _MM_SHUFFLE(3, 3, 3, 3)), result0);
+        result1 = _mm256_fmadd_ps(column3, _mm256_permute_ps(v1, _MM_SHUFFLE(3, 3, 3, 3)), result1);
+
+        _mm_storeu_ps(vertex0, _mm256_castps256_ps128(result0));
+        _mm_storeu_ps(vertex1, _mm256_extractf128_ps(result0, 1));
+        _mm_storeu_ps(vertex2, _mm256_castps256_ps128(result1));
+        _mm_storeu_ps(vertex3, _mm256_extractf128_ps(result1, 1));
+    }
+
+    // Finish off the last few vertices one at a time.
+    __m128 column0_128 = _mm256_castps256_ps128(column0);
+    __m128 column1_128 = _mm256_castps256_ps128(column1);
+    __m128 column2_128 = _mm256_castps256_ps128(column2);
+    __m128 column3_128 = _mm256_castps256_ps128(column3);
+    for(; vertex_idx < num_vertices; vertex_idx++) {
+        float* vertex = &vertex_pointer[vertex_idx * vertex_stride];
+        __m128 v = _mm_loadu_ps(vertex);
+
+        __m128 result = _mm_mul_ps(column0_128, _mm_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+        result = _mm_fmadd_ps(column1_128, _mm_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), result);
+        result = _mm_fmadd_ps(column2_128, _mm_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), result);
+        result = _mm_fmadd_ps(column3_128, _mm_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3)), result);
+
+        _mm_storeu_ps(vertex, result);
+    }
+}
+#endif
+
+#ifdef TRANSFORM_HAS_NEON
+static void apply_matrix_transform_neon(
+        float* vertex_pointer, int num_vertices, int vertex_stride, float matrix[4][4]
+) {
+    float32x4_t column0 = { matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0] };
+    float32x4_t column1 = { matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1] };
+    float32x4_t column2 = { matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2] };
+    float32x4_t column3 = { matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3] };
+
+    for(int vertex_idx = 0; vertex_idx < num_vertices; vertex_idx++) {
+        float* vertex = &vertex_pointer[vertex_idx * vertex_stride];
+        float32x4_t v = vld1q_f32(vertex);
+
+        float32x4_t result = vmulq_laneq_f32(column0, v, 0);
+        result = vfmaq_laneq_f32(result, column1, v, 1);
+        result = vfmaq_laneq_f32(result, column2, v, 2);
+        result = vfmaq_laneq_f32(result, column3, v, 3);
+
+        vst1q_f32(vertex, result);
+    }
+}
+#endif
+
+int is_transform_kernel_supported(transform_kernel_t kernel) {
+    switch(kernel) {
+        case TRANSFORM_KERNEL_SCALAR:
+            return 1;
+#ifdef TRANSFORM_HAS_X86
+        case TRANSFORM_KERNEL_SSE:
+            return 1;
+        case TRANSFORM_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#ifdef TRANSFORM_HAS_NEON
+        case TRANSFORM_KERNEL_NEON:
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+// Checking the CPU features isn't free, so it's only done once, by whichever thread needs a kernel first.
+static pthread_once_t best_kernel_once = PTHREAD_ONCE_INIT;
+static transform_kernel_t best_kernel = TRANSFORM_KERNEL_SCALAR;
+
+static void find_best_transform_kernel() {
+    transform_kernel_t preferred_kernels[] = {
+        TRANSFORM_KERNEL_AVX2, TRANSFORM_KERNEL_NEON, TRANSFORM_KERNEL_SSE, TRANSFORM_KERNEL_SCALAR
+    };
+    for(size_t i = 0; i < sizeof(preferred_kernels) / sizeof(preferred_kernels[0]); i++) {
+        if(is_transform_kernel_supported(preferred_kernels[i])) {
+            best_kernel = preferred_kernels[i];
+            return;
+        }
+    }
+}
+
+transform_kernel_t get_best_transform_kernel() {
+    pthread_once(&best_kernel_once, find_best_transform_kernel);
+    return best_kernel;
+}
+
+const char* get_transform_kernel_name(transform_kernel_t kernel) {
+    switch(kernel) {
+        case TRANSFORM_KERNEL_SCALAR: return "scalar";
+        case TRANSFORM_KERNEL_SSE:    return "sse";
+        case TRANSFORM_KERNEL_AVX2:   return "avx2";
+        case TRANSFORM_KERNEL_NEON:   return "neon";
+        default:                      return "unknown";
+    }
+}
+
+void apply_matrix_transform_with_kernel(
+        transform_kernel_t kernel, float* vertex_pointer, int num_vertices, int vertex_stride, float matrix[4][4]
+) {
+    if(!is_transform_kernel_supported(kernel)) {
+        printf("The %s transform kernel isn't supported on this CPU.\n", get_transform_kernel_name(kernel));
+        exit(-1);
+    }
+
+    switch(kernel) {
+#ifdef TRANSFORM_HAS_X86
+        case TRANSFORM_KERNEL_SSE:
+            apply_matrix_transform_sse(vertex_pointer, num_vertices, vertex_stride, matrix);
+            break;
+        case TRANSFORM_KERNEL_AVX2:
+            apply_matrix_transform_avx2(vertex_pointer, num_vertices, vertex_stride, matrix);
+            break;
+#endif
+#ifdef TRANSFORM_HAS_NEON
+        case TRANSFORM_KERNEL_NEON:
+            apply_matrix_transform_neon(vertex_pointer, num_vertices, vertex_stride, matrix);
+            break;
+#endif
+        default:
+            apply_matrix_transform_scalar(vertex_pointer, num_vertices, vertex_stride, matrix);
+            break;
+    }
+}
+
+void apply_matrix_transform(float* vertex_pointer, int num_vertices, float matrix[4][4]) {
+    apply_matrix_transform_strided(vertex_pointer, num_vertices, 4, matrix);
+}
+
+void apply_matrix_transform_strided(float* vertex_pointer, int num_vertices, int vertex_stride, float matrix[4][4]) {
+    apply_matrix_transform_with_kernel(
+            get_best_transform_kernel(), vertex_pointer, num_vertices, vertex_stride, matrix
+    );
+}
+
+typedef struct {
+    float* vertex_pointer;
+    int num_vertices;
+    int vertex_stride;
+    float (*matrix)[4];
+    transform_kernel_t kernel;
+} transform_job_t;
+
+static void run_transform_job(void* data) {
+    transform_job_t* job = data;
+    apply_matrix_transform_with_kernel(
+            job->kernel, job->vertex_pointer, job->num_vertices, job->vertex_stride, job->matrix
+    );
+}
+
+void apply_matrix_transform_parallel(
+        thread_pool_t* pool, float* vertex_pointer, int num_vertices, int vertex_stride, float matrix[4][4]
+) {
+    int num_chunks = (num_vertices + TRANSFORM_CHUNK_NUM_VERTICES - 1) / TRANSFORM_CHUNK_NUM_VERTICES;
+    if(pool == NULL || num_chunks <= 1) {
+        apply_matrix_transform_strided(vertex_pointer, num_vertices, vertex_stride, matrix);
+        return;
+    }
+
+    // Pick the kernel up front so the workers don't all race to do the CPU feature detection.
+    transform_kernel_t kernel = get_best_transform_kernel();
+    transform_job_t* jobs = malloc(num_chunks * sizeof(transform_job_t));
+    job_group_t group;
+    init_job_group(&group);
+
+    for(int chunk_idx = 0; chunk_idx < num_chunks; chunk_idx++) {
+        int first_vertex = chunk_idx * TRANSFORM_CHUNK_NUM_VERTICES;
+        int remaining_vertices = num_vertices - first_vertex;
+
+        jobs[chunk_idx].vertex_pointer = &vertex_pointer[first_vertex * vertex_stride];
+        jobs[chunk_idx].vertex_stride = vertex_stride;
+        jobs[chunk_idx].num_vertices =
+                remaining_vertices < TRANSFORM_CHUNK_NUM_VERTICES ? remaining_vertices : TRANSFORM_CHUNK_NUM_VERTICES;
+        jobs[chunk_idx].matrix = matrix;
+        jobs[chunk_idx].kernel = kernel;
+        submit_job(pool, &group, run_transform_job, &jobs[chunk_idx]);
+    }
+    wait_for_job_group(pool, &group);
+
+    free(jobs);
+}
+
+void transform_stack_init(transform_stack_t* stack) {
+    stack->depth = 0;
+    get_identity_matrix(stack->matrices[0]);
+}
+
+void transform_stack_push(transform_stack_t* stack) {
+    if(stack->depth + 1 >= TRANSFORM_STACK_MAX_DEPTH) {
+        printf("Transform stack overflow, the maximum depth is %d.\n", TRANSFORM_STACK_MAX_DEPTH);
+        exit(-1);
+    }
+    memcpy(stack->matrices[stack->depth + 1], stack->matrices[stack->depth], sizeof(stack->matrices[0]));
+    stack->depth++;
+}
+
+void transform_stack_pop(transform_stack_t* stack) {
+    if(stack->depth == 0) {
+        printf("Transform stack underflow, popped more times than pushed.\n");
+        exit(-1);
+    }
+    stack->depth--;
+}
+
+void transform_stack_multiply(transform_stack_t* stack, float matrix[4][4]) {
+    multiply_matrices(stack->matrices[stack->depth], matrix, stack->matrices[stack->depth]);
+}
+
+void transform_stack_translate(transform_stack_t* stack, float x_distance, float y_distance, float z_distance) {
+    float matrix[4][4];
+    get_translate_matrix(matrix, x_distance, y_distance, z_distance);
+    transform_stack_multiply(stack, matrix);
+}
+
+void transform_stack_rotate_x(transform_stack_t* stack, float theta) {
+    float matrix[4][4];
+    get_x_rotation_matrix(matrix, theta);
+    transform_stack_multiply(stack, matrix);
+}
+
+void transform_stack_rotate_y(transform_stack_t* stack, float theta) {
+    float matrix[4][4];
+    get_y_rotation_matrix(matrix, theta);
+    transform_stack_multiply(stack, matrix);
+}
+
+void transform_stack_rotate_z(transform_stack_t* stack, float theta) {
+    float matrix[4][4];
+    get_z_rotation_matrix(matrix, theta);
+    transform_stack_multiply(stack, matrix);
+}
+
+void transform_stack_scale(transform_stack_t* stack, float x_scale, float y_scale, float z_scale) {
+    float matrix[4][4];
+    get_scale_matrix(matrix, x_scale, y_scale, z_scale);
+    transform_stack_multiply(stack, matrix);
+}
+
+float (*transform_stack_top(transform_stack_t* stack))[4] {
+    return stack->matrices[stack->depth];
+}
+
+void transform_stack_apply(transform_stack_t* stack, float* vertex_pointer, int num_vertices) {
+    apply_matrix_transform(vertex_pointer, num_vertices, transform_stack_top(stack));
+}
@@ -0,0 +1,92 @@
+#ifndef INC_3D_TRANSFORM_H
+#define INC_3D_TRANSFORM_H
+
+#include "../thread_pool/thread_pool.h"
+
+/**
+ * Matrices are row major 4x4 float arrays. Vertices start with an xyzw position, with w set to 1 so that
+ * translations can be expressed as a matrix, and are either packed 4 floats apart or interleaved with other
+ * attributes every vertex_stride floats.
+ */
+
+void get_identity_matrix(float output[4][4]);
+void get_x_rotation_matrix(float output[4][4], float theta);
+void get_y_rotation_matrix(float output[4][4], float theta);
+void get_z_rotation_matrix(float output[4][4], float theta);
+void get_translate_matrix(float output[4][4], float x_distance, float y_distance, float z_distance);
+void get_scale_matrix(float output[4][4], float x_scale, float y_scale, float z_scale);
+
+/**
+ * Compose two transforms into one so that applying the output is the same as applying right and then left.
+ * The output can safely be the same matrix as either of the inputs.
+ */
+void multiply_matrices(float output[4][4], float left[4][4], float right[4][4]);
+
+/**
+ * Transform every vertex by the matrix in place. This is a single pass over the vertices, so several transforms
+ * should be composed with multiply_matrices() or a transform stack first instead of calling this once for each.
+ * Uses the fastest kernel the CPU supports.
+ */
+void apply_matrix_transform(float* vertex_pointer, int num_vertices, float matrix[4][4]);
+void apply_matrix_transform_strided(float* vertex_pointer, int num_vertices, int vertex_stride, float matrix[4][4]);
+
+/**
+ * The different implementations apply_matrix_transform() can pick between. Each xyzw vertex fills a 128 bit
+ * register, so SSE and NEON transform one vertex per instruction and AVX2 transforms two.
+ */
+typedef enum {
+    TRANSFORM_KERNEL_SCALAR,
+    TRANSFORM_KERNEL_SSE,
+    TRANSFORM_KERNEL_AVX2,
+    TRANSFORM_KERNEL_NEON,
+    NUM_TRANSFORM_KERNELS,
+} transform_kernel_t;
+
+int is_transform_kernel_supported(transform_kernel_t kernel);
+transform_kernel_t get_best_transform_kernel();
+const char* get_transform_kernel_name(transform_kernel_t kernel);
+void apply_matrix_transform_with_kernel(
+        transform_kernel_t kernel, float* vertex_pointer, int num_vertices, int vertex_stride, float matrix[4][4]
+);
+
+// Vertices per job for parallel transforms. 16k xyzw vertices is 256KB, which fits in a cores L2 cache.
+#define TRANSFORM_CHUNK_NUM_VERTICES 16384
+
+/**
+ * Same as apply_matrix_transform() but the vertices are split into chunks that are transformed across the pools
+ * threads. Small meshes that fit in a single chunk are transformed on the calling thread.
+ */
+void apply_matrix_transform_parallel(
+        thread_pool_t* pool, float* vertex_pointer, int num_vertices, int vertex_stride, float matrix[4][4]
+);
+
+#define TRANSFORM_STACK_MAX_DEPTH 16
+
+/**
+ * Builds up a single matrix out of a series of translations, rotations and scales. Each call applies its
+ * transform after everything already on the top of the stack, so the calls read in the same order that the
+ * transforms happen to the vertices. push/pop save and restore the top so shared parent transforms only need
+ * to be built once.
+ */
+typedef struct {
+    float matrices[TRANSFORM_STACK_MAX_DEPTH][4][4];
+    int depth;
+} transform_stack_t;
+
+void transform_stack_init(transform_stack_t* stack);
+void transform_stack_push(transform_stack_t* stack);
+void transform_stack_pop(transform_stack_t* stack);
+
+void transform_stack_multiply(transform_stack_t* stack, float matrix[4][4]);
+void transform_stack_translate(transform_stack_t* stack, float x_distance, float y_distance, float z_distance);
+void transform_stack_rotate_x(transform_stack_t* stack, float theta);
+void transform_stack_rotate_y(transform_stack_t* stack, float theta);
+void transform_stack_rotate_z(transform_stack_t* stack, float theta);
+void transform_stack_scale(transform_stack_t* stack, float x_scale, float y_scale, float z_scale);
+
+float (*transform_stack_top(transform_stack_t* stack))[4];
+
+// Apply everything on the top of the stack to the vertices in one pass.
+void transform_stack_apply(transform_stack_t* stack, float* vertex_pointer, int num_vertices);
+
+#endif //INC_3D_TRANSFORM_H